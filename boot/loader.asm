@@ -119,31 +119,36 @@ start:
     ; Load & Copy All Blocks (Loop)
     ; -----------------------------------------------
     
+    ; mkfs stores the kernel in CONTIGUOUS blocks, i.e. a single extent
+    ; (start, length): we only need extents[0].start and the size.
+    ; Offset Math:
+    ; 1 byte (used) + 32 bytes (filename) = 33 -> size
+    ; + 4 bytes (size)                    = 37 -> extents[0].start
+    mov si, [inode_ptr]
+    mov eax, [si + 33]  ; Kernel size in bytes
+    mov [kernel_size], eax
+    add eax, 511
+    shr eax, 9          ; Sectors to read = (size + 511) / 512
+    mov [kernel_sectors], ax
+
     ; Setup Loop
-    xor cx, cx          ; CX = Block Index (0 to 11)
+    xor cx, cx          ; CX = Block Index
     mov edi, 0x100000   ; Destination Address (Starting at 1MB)
 
 .block_loop:
-    cmp cx, 64          ; Max 64 blocks
-    jge .copy_finished
+    cmp cx, [kernel_sectors]
+    jae .copy_finished
 
     mov si, [inode_ptr] ; Load address of the Kernel Inode
-    
-    mov bx, cx          ; Move Loop Counter (Block Index) to BX
-    shl bx, 2           ; Multiply by 4 (Since each block ID is 4 bytes: uint32_t)
-    add bx, 37          ; Add Offset to `blocks` array
-                        ; Offset Math:
-                        ; 1 byte (used)
-                        ; + 32 bytes (filename)
-                        ; + 4 bytes (size)
-                        ; = 37 bytes.
-    add si, bx          ; SI = Address of inode.blocks[cx]
-    mov eax, [si]       ; Read the Sector Number (LBA) from memory
+    mov eax, [si + 37]  ; First Sector (LBA) = extents[0].start
     
     ; Check for End of File (Block 0 means unused/end)
     cmp eax, 0
     je .copy_finished
 
+    movzx ebx, cx
+    add eax, ebx        ; LBA of block CX
+
     ; Read Block to Temp Buffer (0x8000)
     push cx             ; Save Loop Counter (CX) - BIOS destroys registers
     push edi            ; Save Dest Address (EDI)
@@ -411,6 +416,7 @@ msg_mem_err        db 'Memory Detection Failed!', 0x0d, 0x0a, 0
 BOOT_DRIVE db 0
 inode_table_lba dd 0
 kernel_size dd 0
+kernel_sectors dw 0
 filename_target db 'kernel.bin', 0
 inode_ptr dw 0
 
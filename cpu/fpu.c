@@ -0,0 +1,158 @@
+#include "fpu.h"
+#include "../kernel/process.h"
+
+extern void print_string(char *str);
+extern void memory_copy(char *source, char *dest, int nbytes);
+
+int fpu_enabled = 0;
+
+// Per CPU: thread whose state is currently live in that CPU's FPU registers
+// (NULL = nobody). It may differ from current_process: the registers stay
+// loaded until someone else actually needs them. Tasks never change CPUs,
+// so a thread's live state can only ever be on its own CPU.
+static process_t *fpu_owner[MAX_CPUS];
+
+// CR0 bits
+#define CR0_MP (1 << 1)  // Monitor Coprocessor: WAIT/FWAIT also honour TS
+#define CR0_EM (1 << 2)  // Emulation: every FPU instruction traps (must be 0)
+#define CR0_TS (1 << 3)  // Task Switched: next FPU/SSE instruction raises #NM
+#define CR0_NE (1 << 5)  // Native x87 error reporting (#MF instead of IRQ13)
+
+// CR4 bits
+#define CR4_OSFXSR     (1 << 9)  // OS uses FXSAVE/FXRSTOR -> SSE instructions allowed
+#define CR4_OSXMMEXCPT (1 << 10) // OS handles unmasked SIMD exceptions (#XM)
+
+// Default MXCSR: all SIMD exceptions masked, round to nearest
+#define MXCSR_DEFAULT 0x1F80
+
+static inline uint32_t read_cr0() {
+    uint32_t v;
+    __asm__ volatile("mov %%cr0, %0" : "=r"(v));
+    return v;
+}
+
+static inline void write_cr0(uint32_t v) {
+    __asm__ volatile("mov %0, %%cr0" ::"r"(v));
+}
+
+static inline void clts() {
+    __asm__ volatile("clts");
+}
+
+static inline void stts() {
+    write_cr0(read_cr0() | CR0_TS);
+}
+
+// 16-byte aligned FXSAVE area inside the PCB
+static inline uint8_t *fpu_area(process_t *p) {
+    return (uint8_t *)(((uint32_t)p->fpu_state + FPU_STATE_ALIGN - 1) & ~(FPU_STATE_ALIGN - 1));
+}
+
+// CPUID.1:EDX bit 24 = FXSR, bit 25 = SSE, bit 26 = SSE2
+static int cpu_has_fxsr_sse() {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return ((edx >> 24) & 1) && ((edx >> 25) & 1);
+}
+
+// Enable the FPU and SSE for user space (call on every CPU at boot, BSP first).
+void init_fpu() {
+    int bsp = (cpu_id() == 0);
+
+    if (!bsp && !fpu_enabled) return;
+    if (!cpu_has_fxsr_sse()) {
+        print_string("FPU: FXSR/SSE not supported by CPU, FPU disabled.\n");
+        return;
+    }
+
+    // 1. CR0: real FPU (EM=0), trap WAIT too (MP=1), native errors (NE=1).
+    //    TS=1 so the very first FPU instruction goes through the #NM handler.
+    uint32_t cr0 = read_cr0();
+    cr0 &= ~CR0_EM;
+    cr0 |= CR0_MP | CR0_NE | CR0_TS;
+    write_cr0(cr0);
+
+    // 2. CR4: tell the CPU we save SSE state with FXSAVE.
+    uint32_t cr4;
+    __asm__ volatile("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= CR4_OSFXSR | CR4_OSXMMEXCPT;
+    __asm__ volatile("mov %0, %%cr4" ::"r"(cr4));
+
+    if (bsp) {
+        fpu_enabled = 1;
+        print_string("FPU: x87/SSE enabled (lazy context switch).\n");
+    }
+}
+
+// Interrupt 7 (#NM, Device Not Available): current_process touched the FPU
+// while CR0.TS was set. Hand the registers over to it.
+void fpu_nm_handler() {
+    if (!fpu_enabled) {
+        print_string("\n[!] EXCEPTION: FPU instruction without FPU support!\n");
+        sys_exit(-1);
+    }
+
+    // 1. Allow FPU access again (also for our own FXSAVE/FXRSTOR below)
+    clts();
+
+    process_t **owner = &fpu_owner[cpu_id()];
+    if (*owner == current_process) {
+        return; // Registers are already ours (TS was set needlessly)
+    }
+
+    // 2. Save the previous owner's registers into its PCB
+    if (*owner) {
+        __asm__ volatile("fxsave (%0)" ::"r"(fpu_area(*owner)) : "memory");
+    }
+
+    // 3. Load ours, or start from a clean state on first use
+    if (current_process->fpu_used) {
+        __asm__ volatile("fxrstor (%0)" ::"r"(fpu_area(current_process)) : "memory");
+    } else {
+        uint32_t mxcsr = MXCSR_DEFAULT;
+        __asm__ volatile("fninit");
+        __asm__ volatile("ldmxcsr %0" ::"m"(mxcsr));
+        current_process->fpu_used = 1;
+    }
+
+    *owner = current_process;
+}
+
+// Called by schedule() right before switching to 'next'.
+// Only the owner may run with TS clear; everybody else traps on first use.
+void fpu_switch(process_t *next) {
+    if (!fpu_enabled) return;
+
+    if (next == fpu_owner[cpu_id()]) {
+        clts();
+    } else {
+        stts();
+    }
+}
+
+// Give a new thread/process a copy of the caller's FPU state (fork/clone).
+void fpu_fork(process_t *child) {
+    child->fpu_used = 0;
+    if (!fpu_enabled || !current_process->fpu_used) return;
+
+    // Live registers are newer than the PCB copy: flush them first.
+    // We remain the owner, so the registers stay valid (TS stays clear).
+    if (fpu_owner[cpu_id()] == current_process) {
+        clts();
+        __asm__ volatile("fxsave (%0)" ::"r"(fpu_area(current_process)) : "memory");
+    }
+
+    memory_copy((char *)fpu_area(current_process), (char *)fpu_area(child), FPU_STATE_SIZE);
+    child->fpu_used = 1;
+}
+
+// Forget a thread's FPU state (exec'd into a new image, or exiting).
+// Its next FPU instruction (if any) starts from a clean state.
+// Call on the thread's own CPU (it is the only one that can hold its registers).
+void fpu_release(process_t *p) {
+    p->fpu_used = 0;
+    if (fpu_owner[cpu_id()] == p) {
+        fpu_owner[cpu_id()] = 0;
+        if (p == current_process) stts();
+    }
+}
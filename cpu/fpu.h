@@ -0,0 +1,35 @@
+#ifndef FPU_H
+#define FPU_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Lazy FPU/SSE Context Switching
+// ---------------------------------------------------------
+// The x87/MMX/SSE register file is NOT saved by switch_task.
+// Instead, the scheduler sets CR0.TS on every switch to a thread that does not
+// own the registers. The first FPU/SSE instruction that thread executes raises
+// #NM (Interrupt 7), and only then is the previous owner's state saved (FXSAVE)
+// and the new thread's state loaded (FXRSTOR).
+// Threads that never touch the FPU never pay for it.
+//
+// NOTE: The kernel itself is built with -mno-sse -mno-mmx and must never use the FPU.
+
+// FXSAVE/FXRSTOR image size. The instructions need a 16-byte aligned buffer,
+// but kmalloc() only aligns to 4 bytes, so process_t reserves 16 spare bytes
+// and fpu_area() rounds the pointer up.
+#define FPU_STATE_SIZE  512
+#define FPU_STATE_ALIGN 16
+
+// 1 if CR0/CR4 were set up for FXSAVE + SSE (CPU has FXSR and SSE)
+extern int fpu_enabled;
+
+struct process;
+
+void init_fpu();
+void fpu_nm_handler();
+void fpu_switch(struct process *next);
+void fpu_fork(struct process *child);
+void fpu_release(struct process *p);
+
+#endif
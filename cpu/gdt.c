@@ -1,52 +1,81 @@
 #include "gdt.h"
 
-// Define 6 GDT entries:
+// Define 8 GDT entries per CPU:
 // 0: Null
 // 1: Kernel Code
 // 2: Kernel Data
 // 3: User Code
 // 4: User Data
-// 5: TSS
-gdt_entry_t gdt[6];
-gdt_ptr_t gp;
+// 5: TSS (each CPU has its own TSS -> its own GDT)
+// 6: CPU Number (limit = CPU index, see cpu_id())
+// 7: TLS of the task running on this CPU (see gdt_set_tls())
+gdt_entry_t gdt[MAX_CPUS][GDT_ENTRIES];
+gdt_ptr_t gp[MAX_CPUS];
 
 extern void gdt_flush(uint32_t); // External assembly function to reload GDT
 
 // Helper to set a GDT gate
-void gdt_set_gate(int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity) {
-    gdt[num].base_low    = (base & 0xFFFF);
-    gdt[num].base_middle = (base >> 16) & 0xFF;
-    gdt[num].base_high   = (base >> 24) & 0xFF;
+void gdt_set_gate(uint32_t cpu, int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity) {
+    gdt_entry_t *e = &gdt[cpu][num];
 
-    gdt[num].limit_low   = (limit & 0xFFFF);
-    gdt[num].granularity = (limit >> 16) & 0x0F;
+    e->base_low    = (base & 0xFFFF);
+    e->base_middle = (base >> 16) & 0xFF;
+    e->base_high   = (base >> 24) & 0xFF;
 
-    gdt[num].granularity |= (granularity & 0xF0);
-    gdt[num].access      = access;
+    e->limit_low   = (limit & 0xFFFF);
+    e->granularity = (limit >> 16) & 0x0F;
+
+    e->granularity |= (granularity & 0xF0);
+    e->access      = access;
 }
 
-void init_gdt() {
-    gp.limit = (sizeof(gdt_entry_t) * 6) - 1;
-    gp.base  = (uint32_t)&gdt;
+void init_gdt(uint32_t cpu) {
+    gp[cpu].limit = (sizeof(gdt_entry_t) * GDT_ENTRIES) - 1;
+    gp[cpu].base  = (uint32_t)&gdt[cpu];
 
     // 0: Null Descriptor
-    gdt_set_gate(0, 0, 0, 0, 0);
+    gdt_set_gate(cpu, 0, 0, 0, 0, 0);
 
     // 1: Kernel Code (Base=0, Limit=4GB, Access=0x9A, Gran=0xCF)
-    gdt_set_gate(1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
+    gdt_set_gate(cpu, 1, 0, 0xFFFFFFFF, 0x9A, 0xCF);
 
     // 2: Kernel Data (Base=0, Limit=4GB, Access=0x92, Gran=0xCF)
-    gdt_set_gate(2, 0, 0xFFFFFFFF, 0x92, 0xCF);
+    gdt_set_gate(cpu, 2, 0, 0xFFFFFFFF, 0x92, 0xCF);
 
     // 3: User Code (Access=0xFA)
-    gdt_set_gate(3, 0, 0xFFFFFFFF, 0xFA, 0xCF);
+    gdt_set_gate(cpu, 3, 0, 0xFFFFFFFF, 0xFA, 0xCF);
 
     // 4: User Data (Access=0xF2)
-    gdt_set_gate(4, 0, 0xFFFFFFFF, 0xF2, 0xCF);
+    gdt_set_gate(cpu, 4, 0, 0xFFFFFFFF, 0xF2, 0xCF);
 
     // 5: TSS (Initialized later in tss.c, but reserved here)
-    gdt_set_gate(5, 0, 0, 0, 0);
+    gdt_set_gate(cpu, 5, 0, 0, 0, 0);
+
+    // 6: CPU Number (Base=0, Limit=cpu, Byte Granularity, Access=0xF0)
+    //    Access 0xF0 = Present, DPL=3, Data, Read-Only. Never loaded into a
+    //    segment register, only inspected with 'lsl'.
+    gdt_set_gate(cpu, 6, 0, cpu, 0xF0, 0x40);
+
+    // 7: TLS (flat until a task installs its own, see gdt_set_tls())
+    gdt_set_tls(cpu, 0, 0);
 
     // Reload GDT
-    gdt_flush((uint32_t)&gp);
+    gdt_flush((uint32_t)&gp[cpu]);
+}
+
+// Point the TLS descriptor of 'cpu' at [base, base + size).
+// Called by the scheduler on every task switch. The new descriptor is used
+// the next time %gs is loaded with GDT_TLS_SEL, which every return to user
+// mode does (the interrupt and SYSENTER paths both pop the saved %gs).
+void gdt_set_tls(uint32_t cpu, uint32_t base, uint32_t size) {
+    if (size == 0) {
+        // Flat 4GB, same as User Data: loading the selector never faults
+        gdt_set_gate(cpu, 7, 0, 0xFFFFFFFF, 0xF2, 0xCF);
+    } else if (size <= 0x100000) {
+        // Byte granularity (limit = last valid offset)
+        gdt_set_gate(cpu, 7, base, size - 1, 0xF2, 0x40);
+    } else {
+        // 4KB granularity
+        gdt_set_gate(cpu, 7, base, (size - 1) >> 12, 0xF2, 0xC0);
+    }
 }
@@ -23,8 +23,32 @@ struct gdt_ptr_struct {
 
 typedef struct gdt_ptr_struct gdt_ptr_t;
 
-// Initialization function
-void init_gdt();
-void gdt_set_gate(int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity);
+// Every CPU has its own GDT (same layout, different TSS + CPU number entries)
+#define MAX_CPUS    8
+#define GDT_ENTRIES 8
+
+// Entry 6: CPU number descriptor (DPL 3). Its LIMIT is the CPU index, so
+// 'lsl' on this selector tells the caller which CPU it runs on — from the
+// kernel and from user space alike, without touching memory.
+#define GDT_CPUNUM_SEL 0x33 // Index 6 * 8 | RPL 3
+
+// Entry 7: Thread-Local Storage (DPL 3 data). Rewritten by the scheduler for
+// every task it switches to (see sys_set_thread_area), so user code that
+// loads this selector into %gs reaches its own thread's TLS block.
+#define GDT_TLS_SEL 0x3B // Index 7 * 8 | RPL 3
+#define GDT_USER_DATA_SEL 0x23
+
+// Index of the CPU we are running on (0 = BSP).
+// If the descriptor is not set up yet (early boot), 'lsl' fails and we report 0.
+static inline uint32_t cpu_id() {
+    uint32_t id;
+    __asm__ volatile("lsl %1, %0" : "=r"(id) : "r"((uint32_t)GDT_CPUNUM_SEL), "0"(0));
+    return id;
+}
+
+// Initialization function (once per CPU, on that CPU)
+void init_gdt(uint32_t cpu);
+void gdt_set_gate(uint32_t cpu, int32_t num, uint32_t base, uint32_t limit, uint8_t access, uint8_t granularity);
+void gdt_set_tls(uint32_t cpu, uint32_t base, uint32_t size); // size 0 = flat (like User Data)
 
 #endif
@@ -1,11 +1,19 @@
 // idt.c
 #include "idt.h"
+#include "lapic.h"
 
 extern void isr0();
+extern void isr7();  // Device Not Available (Lazy FPU)
 extern void isr14(); // Page Fault
 extern void irq0();
 extern void irq1(); // Keyboard IRQ Wrapper
+extern void irq14(); // Primary IDE IRQ Wrapper
+extern void irq5(), irq9(), irq10(), irq11(); // PCI IRQ lines
 extern void isr128(); // System Call Handler
+extern void lapic_timer_irq(); // Local APIC vectors (SMP)
+extern void ipi_tlb();
+extern void ipi_resched();
+extern void lapic_spurious();
 
 // 1. Define the actual variables here (Allocates memory)
 idt_gate_t idt[IDT_ENTRIES];
@@ -41,6 +49,9 @@ void set_idt()
   // Register the handler for Interrupt 0 (Division By Zero)
   set_idt_gate(0, (uint32_t)isr0);
   
+  // Register the handler for Interrupt 7 (Device Not Available -> Lazy FPU switch)
+  set_idt_gate(7, (uint32_t)isr7);
+
   // Register the handler for Interrupt 14 (Page Fault)
   set_idt_gate(14, (uint32_t)isr14);
   
@@ -48,6 +59,19 @@ void set_idt()
   set_idt_gate(32, (uint32_t)irq0);
   // IRQ 1 (Keyboard) -> INT 33
   set_idt_gate(33, (uint32_t)irq1);
+  // IRQ 14 (Primary IDE) -> INT 46
+  set_idt_gate(46, (uint32_t)irq14);
+  // PCI IRQ lines (unmasked by pic_irq_register) -> INT 37, 41, 42, 43
+  set_idt_gate(37, (uint32_t)irq5);
+  set_idt_gate(41, (uint32_t)irq9);
+  set_idt_gate(42, (uint32_t)irq10);
+  set_idt_gate(43, (uint32_t)irq11);
+
+  // Local APIC timer and Inter-Processor Interrupts (see kernel/smp.c)
+  set_idt_gate(LAPIC_TIMER_VECTOR, (uint32_t)lapic_timer_irq);
+  set_idt_gate(IPI_TLB_VECTOR, (uint32_t)ipi_tlb);
+  set_idt_gate(IPI_RESCHED_VECTOR, (uint32_t)ipi_resched);
+  set_idt_gate(LAPIC_SPURIOUS_VECTOR, (uint32_t)lapic_spurious);
 
   // Register System Call Handler (INT 0x80 = 128)
   set_idt_gate(128, (uint32_t)isr128);
@@ -55,8 +79,14 @@ void set_idt()
   // 0xEF = 1110 1110 (P=1, DPL=11, Type=1111)
   idt[128].flags = 0xEF; 
 
-  // Execute "lidt" instruction (Load IDT)
-  // Using inline assembly to execute assembly instructions within C code.
-  // We pass the address of 'idt_reg' to the CPU to tell it where the IDT is located.
+  idt_load();
+}
+
+// Execute "lidt" instruction (Load IDT)
+// Using inline assembly to execute assembly instructions within C code.
+// We pass the address of 'idt_reg' to the CPU to tell it where the IDT is located.
+// The APs share the BSP's table and only call this part (see kernel/smp.c).
+void idt_load()
+{
   __asm__ volatile("lidt (%0)" : : "r"(&idt_reg));
 }
\ No newline at end of file
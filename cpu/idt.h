@@ -43,6 +43,7 @@ extern idt_register_t idt_reg;
 // Function prototypes
 void set_idt_gate(int n, uint32_t handler);
 void set_idt();
+void idt_load(); // lidt only (APs share the BSP's table)
 
 void pic_remap();
 
@@ -3,14 +3,27 @@
 [bits 32]
 
 global isr0             ; Make 'isr0' accessible from C code
+global isr7             ; Make 'isr7' accessible (Device Not Available)
 global isr14            ; Make 'isr14' accessible (Page Fault)
 global irq0             ; Make 'irq0' accessible (Timer IRQ)
 global irq1             ; Make 'irq1' accessible (Keyboard IRQ)
+global irq14            ; Make 'irq14' accessible (Primary IDE IRQ)
+global irq5, irq9, irq10, irq11 ; PCI interrupt lines (shared, see pic_irq_dispatch)
+global lapic_timer_irq  ; Local APIC timer (AP time slice)
+global ipi_tlb          ; TLB shootdown IPI
+global ipi_resched      ; Reschedule IPI
+global lapic_spurious   ; Local APIC spurious interrupt
 
 extern isr0_handler     ; C Handler for Int 0
+extern fpu_nm_handler   ; C Handler for Int 7 (Lazy FPU switch)
 extern page_fault_handler ; C Handler for Int 14 (Page Fault)
 extern timer_handler    ; C Handler for IRQ 0 (Timer)
 extern keyboard_handler ; C Handler for IRQ 1 (Keyboard)
+extern ata_irq_handler  ; C Handler for IRQ 14 (Primary IDE)
+extern pic_irq_dispatch ; C Dispatcher for the PCI IRQ lines
+extern lapic_timer_handler
+extern smp_tlb_handler
+extern smp_resched_handler
 
 ; ---------------------------------------------
 ; Handler for Interrupt 0 (Division By Zero)
@@ -42,6 +55,35 @@ isr0:
     popa
     iret
 
+; ---------------------------------------------
+; Handler for Interrupt 7 (Device Not Available)
+; ---------------------------------------------
+; Raised by the first FPU/SSE instruction after a task switch (CR0.TS=1).
+; No error code. The C handler swaps FPU state and we retry the instruction.
+isr7:
+    pusha
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    call fpu_nm_handler
+
+    pop gs
+    pop fs
+    pop es
+    pop ds
+
+    popa
+    iret
+
 ; ---------------------------------------------
 ; Handler for Interrupt 14 (Page Fault)
 ; ---------------------------------------------
@@ -126,6 +168,109 @@ irq1:
     popa                ; Restore registers
     iret                ; Return from interrupt
 
+; ---------------------------------------------
+; Handler for IRQ 14 (Primary IDE Interrupt)
+; ---------------------------------------------
+irq14:
+    pusha               ; Save registers
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    call ata_irq_handler
+
+    pop gs
+    pop fs
+    pop es
+    pop ds
+
+    popa                ; Restore registers
+    iret                ; Return from interrupt
+
+; ---------------------------------------------
+; PCI Interrupt Lines (IRQ 5, 9, 10, 11)
+; ---------------------------------------------
+; Same frame as irq0, plus the IRQ number for the C dispatcher, which runs
+; every handler registered on the line and sends the EOI.
+%macro PIC_IRQ_HANDLER 2
+%1:
+    pusha
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    push %2
+    call pic_irq_dispatch
+    add esp, 4
+
+    pop gs
+    pop fs
+    pop es
+    pop ds
+
+    popa
+    iret
+%endmacro
+
+PIC_IRQ_HANDLER irq5, 5
+PIC_IRQ_HANDLER irq9, 9
+PIC_IRQ_HANDLER irq10, 10
+PIC_IRQ_HANDLER irq11, 11
+
+; ---------------------------------------------
+; Local APIC Interrupts (SMP)
+; ---------------------------------------------
+; Same frame as irq0: the C handlers send their own EOI (to the LAPIC, not the PIC).
+%macro LAPIC_HANDLER 2
+%1:
+    pusha
+
+    push ds
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+
+    call %2
+
+    pop gs
+    pop fs
+    pop es
+    pop ds
+
+    popa
+    iret
+%endmacro
+
+LAPIC_HANDLER lapic_timer_irq, lapic_timer_handler
+LAPIC_HANDLER ipi_tlb, smp_tlb_handler
+LAPIC_HANDLER ipi_resched, smp_resched_handler
+
+; Spurious interrupts must NOT be acknowledged with an EOI
+lapic_spurious:
+    iret
+
 
 ; ---------------------------------------------
 ; GDT Flush (Called from gdt.c)
@@ -217,6 +362,7 @@ user_entry:
 ; System Call Handler (INT 0x80)
 ; ---------------------------------------------
 extern syscall_handler ; Defined in cpu/syscall.c
+extern sysenter_handler ; Defined in cpu/syscall.c
 
 global isr128
 isr128:
@@ -252,4 +398,67 @@ isr_exit:
     pop ds
     
     popa            ; Restore registers
-    iret            ; Return to User Mode
\ No newline at end of file
+    iret            ; Return to User Mode
+; ---------------------------------------------
+; Fast System Call Entry (SYSENTER)
+; ---------------------------------------------
+; User stub convention (see programs/lib.c):
+;   EAX = Syscall Number, EBX/ECX/EDX/ESI/EDI = Arguments (same as INT 0x80)
+;   EBP = User ESP, pointing at [Return EIP, Saved EBP]
+;
+; SYSENTER saves NOTHING (no EIP, no ESP, no EFLAGS), so we forge the
+; registers_t frame ourselves. That keeps syscall_handler, fork and exec
+; working unchanged — a forked child simply leaves through isr_exit/iret.
+;
+; User mode may have loaded anything into DS/ES (a null selector, the TLS
+; selector 0x3B), so they are saved and reloaded like the INT 0x80 stub does.
+; FS/GS are saved but not reloaded: the kernel never uses them.
+; EBP comes straight from user mode, so the return address is not read here:
+; sysenter_handler fetches it into the frame once it has checked the page.
+; Like the INT 0x80 trap gate, the syscall itself runs with interrupts on.
+global sysenter_entry
+sysenter_entry:
+    mov esp, [esp]          ; MSR_SYSENTER_ESP = &tss_entry.esp0 -> load the task's kernel stack
+
+    ; Hardware part of the frame (what INT 0x80 would have pushed)
+    push 0x23               ; SS (User Data Selector)
+    push ebp                ; ESP (User Stack)
+    add dword [esp], 4      ;   ...minus the return address we pop below
+    pushfd                  ; EFLAGS
+    or dword [esp], 0x200   ;   SYSENTER cleared IF, but user mode always runs with IF=1
+    push 0x1B               ; CS (User Code Selector)
+    push 0                  ; EIP (filled in by sysenter_handler)
+
+    pusha                   ; Save general purpose registers (syscall arguments)
+
+    push ds                 ; Save Segments
+    push es
+    push fs
+    push gs
+
+    mov ax, 0x10            ; Load Kernel Data Segment (EAX is saved above)
+    mov ds, ax
+    mov es, ax
+    sti                     ; The kernel stack is set up: preemptible from here
+
+    push esp                ; Pass register struct (registers_t*)
+    call sysenter_handler
+    add esp, 4
+
+    pop gs
+    pop fs
+    pop es
+    pop ds
+
+    popa                    ; EAX = return value, the rest restored
+
+    ; Stack: [EIP, CS, EFLAGS, ESP, SS]
+    ; SYSEXIT loads EIP from EDX and ESP from ECX (both clobbered for the user).
+    ; Reading them from the frame honors changes made by exec (new entry/stack).
+    mov edx, [esp]          ; User EIP
+    mov ecx, [esp + 12]     ; User ESP
+    add esp, 8              ; Drop EIP, CS
+    and dword [esp], ~0x200 ; Keep IF=0 while still on the kernel stack...
+    popfd
+    sti                     ; ...STI takes effect after the next instruction,
+    sysexit                 ; so interrupts come back exactly in user mode
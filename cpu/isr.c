@@ -42,10 +42,48 @@ void pic_remap()
   port_byte_out(PIC2_DATA, 0x01);
 
   // Set Mask: 
-  // Master PIC: Enable IRQ 0 (Timer) & IRQ 1 (Keyboard) -> 1111 1100 = 0xFC
-  // Slave PIC: Disable all -> 1111 1111 = 0xFF
-  port_byte_out(PIC1_DATA, 0xFC);
-  port_byte_out(PIC2_DATA, 0xFF);
+  // Master PIC: Enable IRQ 0 (Timer), IRQ 1 (Keyboard) & IRQ 2 (Cascade) -> 1111 1000 = 0xF8
+  // Slave PIC: Enable IRQ 14 (Primary IDE, slave line 6) -> 1011 1111 = 0xBF
+  port_byte_out(PIC1_DATA, 0xF8);
+  port_byte_out(PIC2_DATA, 0xBF);
+}
+
+// Handlers on the PCI IRQ lines (see isr.h), and which lines have a stub
+static struct {
+    pic_irq_handler_t handler;
+    void *ctx;
+} pic_irq_handlers[16][PIC_IRQ_MAX_HANDLERS];
+static const uint16_t pic_irq_stubs = (1 << 5) | (1 << 9) | (1 << 10) | (1 << 11);
+
+int pic_irq_register(int irq, pic_irq_handler_t handler, void *ctx)
+{
+  if (irq < 0 || irq > 15 || !(pic_irq_stubs & (1 << irq))) return -1;
+
+  for (int i = 0; i < PIC_IRQ_MAX_HANDLERS; i++) {
+    if (!pic_irq_handlers[irq][i].handler) {
+      pic_irq_handlers[irq][i].ctx = ctx;
+      pic_irq_handlers[irq][i].handler = handler;
+
+      // Unmask the line (the slave's lines arrive through the cascade, IRQ 2)
+      uint16_t port = irq < 8 ? PIC1_DATA : PIC2_DATA;
+      port_byte_out(port, port_byte_in(port) & ~(1 << (irq & 7)));
+      return 0;
+    }
+  }
+  return -1;
+}
+
+void pic_irq_dispatch(uint32_t irq)
+{
+  for (int i = 0; i < PIC_IRQ_MAX_HANDLERS; i++) {
+    if (pic_irq_handlers[irq][i].handler) {
+      pic_irq_handlers[irq][i].handler(pic_irq_handlers[irq][i].ctx);
+    }
+  }
+
+  // EOI: slave first for IRQ 8-15, then master
+  if (irq >= 8) port_byte_out(PIC2_COMMAND, 0x20);
+  port_byte_out(PIC1_COMMAND, 0x20);
 }
 
 // Handler for Interrupt 0 (Division By Zero)
@@ -63,9 +101,17 @@ void isr0_handler()
 #include "../mm/vmm.h"
 #include "../mm/pmm.h"
 
+#include "../kernel/spinlock.h"
+
 // Defined in mm/vmm.c (Global)
 extern void copy_page_physical(uint32_t src, uint32_t dest);
 
+// Defined in kernel/smp.c
+extern void tlb_shootdown(uint32_t pd_phys);
+
+// Threads of one process can hit the same COW page on two CPUs at once
+static volatile uint32_t cow_lock = 0;
+
 // Handler for Interrupt 14 (Page Fault)
 void page_fault_handler(registers_err_t *regs)
 {
@@ -109,6 +155,17 @@ void page_fault_handler(registers_err_t *regs)
             uint32_t pt_phys = pd->m_entries[pd_index] & I86_PTE_FRAME;
             page_table* pt = (page_table*)P2V(pt_phys);
             
+            spin_lock(&cow_lock);
+
+            // Another CPU already resolved this fault (we saw a stale TLB entry)
+            uint32_t pte = pt->m_entries[pt_index];
+            if ((pte & I86_PTE_PRESENT) && (pte & I86_PTE_WRITABLE) &&
+                (!user || (pte & I86_PTE_USER))) {
+                spin_unlock(&cow_lock);
+                __asm__ volatile("invlpg (%0)" ::"r" (faulting_address) : "memory");
+                return;
+            }
+
             if (pt->m_entries[pt_index] & I86_PTE_PRESENT) {
                 // Check if Custom COW Bit is set
                 if (pt->m_entries[pt_index] & I86_PTE_COW) {
@@ -147,10 +204,15 @@ void page_fault_handler(registers_err_t *regs)
                     
                     // 5. Invalidate TLB for this address
                     __asm__ volatile("invlpg (%0)" ::"r" (faulting_address) : "memory");
+                    spin_unlock(&cow_lock);
+
+                    // Sibling threads on other CPUs may still map the old frame
+                    tlb_shootdown(cr3);
                     
                     return; // Resume Execution!
                 }
             }
+            spin_unlock(&cow_lock);
         }
     }
 
@@ -23,4 +23,15 @@ typedef struct {
 void isr0_handler();
 void page_fault_handler(registers_err_t *regs);
 
+// PCI devices raise level-triggered, possibly shared PIC lines (IRQ 5, 9, 10, 11).
+// Every handler on the line runs (each checks its own device); the dispatcher
+// sends the EOI afterwards.
+#define PIC_IRQ_MAX_HANDLERS 4
+typedef void (*pic_irq_handler_t)(void *ctx);
+
+// Register 'handler' for 'irq' and unmask the line. Returns 0, or -1 if the
+// line has no stub or no free handler slot (the caller must then poll).
+int pic_irq_register(int irq, pic_irq_handler_t handler, void *ctx);
+void pic_irq_dispatch(uint32_t irq);
+
 #endif
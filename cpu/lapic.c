@@ -0,0 +1,132 @@
+#include "lapic.h"
+#include "msr.h"
+#include "gdt.h"
+#include "../mm/vmm.h"
+#include "../drivers/timer.h"
+
+extern void print_string(char *str);
+extern void print_dec(int n);
+extern void print_hex(uint32_t n);
+
+// Defined in process.c
+extern void schedule();
+
+static volatile uint32_t *lapic = 0;
+
+// LAPIC timer ticks (divide-by-16) in 10ms, measured once on the BSP
+static uint32_t lapic_ticks_per_10ms = 0;
+
+static inline uint32_t lapic_read(uint32_t reg) {
+    return lapic[reg / 4];
+}
+
+static inline void lapic_write(uint32_t reg, uint32_t value) {
+    lapic[reg / 4] = value;
+    (void)lapic[LAPIC_ID / 4]; // Read back: wait for the write to complete
+}
+
+// CPUID.1:EDX bit 9 = On-chip APIC
+int lapic_present() {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 9) & 1;
+}
+
+// Map the LAPIC registers into kernel space (BSP, once, before any process
+// directory is cloned so everybody inherits the mapping).
+void lapic_map() {
+    uint32_t base = (uint32_t)rdmsr(MSR_APIC_BASE) & 0xFFFFF000;
+    if (!base) base = LAPIC_DEFAULT_BASE;
+
+    // Device memory: never cached. Same virtual address as physical (>= 3GB).
+    vmm_map_page(base, base, I86_PTE_PRESENT | I86_PTE_WRITABLE |
+                             I86_PTE_NOT_CACHEABLE | I86_PTE_WRITETHROUGH);
+    lapic = (volatile uint32_t *)base;
+}
+
+// Enable this CPU's LAPIC
+void lapic_init() {
+    // 1. Software Enable + Spurious Vector
+    lapic_write(LAPIC_SVR, 0x100 | LAPIC_SPURIOUS_VECTOR);
+
+    // 2. Local interrupt pins
+    // BSP: LINT0 = ExtINT (legacy PIC, virtual wire mode), LINT1 = NMI.
+    // APs: masked — device IRQs only go to the BSP.
+    if (cpu_id() == 0) {
+        lapic_write(LAPIC_LVT_LINT0, LVT_EXTINT);
+        lapic_write(LAPIC_LVT_LINT1, LVT_NMI);
+    } else {
+        lapic_write(LAPIC_LVT_LINT0, LVT_MASKED);
+        lapic_write(LAPIC_LVT_LINT1, LVT_MASKED);
+    }
+
+    // 3. No timer until lapic_timer_start(), no error interrupt
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+    lapic_write(LAPIC_LVT_ERROR, LVT_MASKED);
+
+    // 4. Clear errors (back-to-back writes), accept all priorities
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_ESR, 0);
+    lapic_write(LAPIC_TPR, 0);
+
+    // 5. Ack anything left pending
+    lapic_write(LAPIC_EOI, 0);
+}
+
+uint32_t lapic_id() {
+    if (!lapic) return 0;
+    return lapic_read(LAPIC_ID) >> 24;
+}
+
+void lapic_eoi() {
+    lapic_write(LAPIC_EOI, 0);
+}
+
+// Raw ICR write (INIT/SIPI sequences). apic_id is ignored for shorthand destinations.
+void lapic_send_icr(uint32_t apic_id, uint32_t icr_lo) {
+    lapic_write(LAPIC_ICR_HI, apic_id << 24);
+    lapic_write(LAPIC_ICR_LO, icr_lo);
+    while (lapic_read(LAPIC_ICR_LO) & ICR_DELIVS) {
+        __asm__ volatile("pause");
+    }
+}
+
+// Fixed-delivery IPI to one CPU (interrupts must be off: the ICR is per-CPU
+// state we don't want an interrupt handler to clobber halfway)
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector) {
+    lapic_send_icr(apic_id, vector & 0xFF);
+}
+
+// Measure the LAPIC timer against PIT channel 2 (BSP, interrupts off)
+void lapic_timer_calibrate() {
+    lapic_write(LAPIC_TIMER_DIV, 0x3); // Divide by 16
+    lapic_write(LAPIC_LVT_TIMER, LVT_MASKED);
+
+    pit_oneshot_start(10);
+    lapic_write(LAPIC_TIMER_INIT, 0xFFFFFFFF);
+    while (!pit_oneshot_done()) {
+        __asm__ volatile("pause");
+    }
+    uint32_t left = lapic_read(LAPIC_TIMER_CUR);
+    lapic_write(LAPIC_TIMER_INIT, 0); // Stop
+
+    lapic_ticks_per_10ms = 0xFFFFFFFF - left;
+
+    print_string("LAPIC: Timer ");
+    print_dec(lapic_ticks_per_10ms / 10);
+    print_string(" ticks/ms\n");
+}
+
+// Periodic scheduler tick on this CPU (used by the APs; the BSP keeps the PIT)
+void lapic_timer_start(uint32_t hz) {
+    lapic_write(LAPIC_TIMER_DIV, 0x3);
+    lapic_write(LAPIC_LVT_TIMER, LVT_TIMER_PERIODIC | LAPIC_TIMER_VECTOR);
+    lapic_write(LAPIC_TIMER_INIT, lapic_ticks_per_10ms * 100 / hz);
+}
+
+// Vector LAPIC_TIMER_VECTOR: time slice over on this AP
+void lapic_timer_handler() {
+    // EOI first: schedule() may not come back here for a long time
+    lapic_eoi();
+    schedule();
+}
@@ -0,0 +1,63 @@
+#ifndef LAPIC_H
+#define LAPIC_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Local APIC (one per CPU)
+// ---------------------------------------------------------
+// Used for SMP only: starting the APs (INIT-SIPI), inter-processor
+// interrupts, and the per-CPU timer of the APs. Device IRQs still come
+// through the legacy PIC to the BSP (LINT0 in virtual wire mode).
+
+// MMIO window, mapped Uncached at the same virtual address (kernel space)
+#define LAPIC_DEFAULT_BASE 0xFEE00000
+
+// Register offsets
+#define LAPIC_ID        0x020
+#define LAPIC_VERSION   0x030
+#define LAPIC_TPR       0x080 // Task Priority
+#define LAPIC_EOI       0x0B0
+#define LAPIC_SVR       0x0F0 // Spurious Interrupt Vector (bit 8 = APIC Software Enable)
+#define LAPIC_ESR       0x280 // Error Status
+#define LAPIC_ICR_LO    0x300 // Interrupt Command (write triggers the IPI)
+#define LAPIC_ICR_HI    0x310 // Destination APIC ID in bits 24-31
+#define LAPIC_LVT_TIMER 0x320
+#define LAPIC_LVT_LINT0 0x350
+#define LAPIC_LVT_LINT1 0x360
+#define LAPIC_LVT_ERROR 0x370
+#define LAPIC_TIMER_INIT 0x380
+#define LAPIC_TIMER_CUR  0x390
+#define LAPIC_TIMER_DIV  0x3E0
+
+// ICR bits
+#define ICR_INIT          0x00000500
+#define ICR_STARTUP       0x00000600
+#define ICR_LEVEL_ASSERT  0x00004000
+#define ICR_DELIVS        0x00001000 // Delivery Status (1 = still sending)
+#define ICR_ALL_BUT_SELF  0x000C0000 // Destination Shorthand
+
+// LVT bits
+#define LVT_MASKED        0x00010000
+#define LVT_TIMER_PERIODIC 0x00020000
+#define LVT_EXTINT        0x00000700
+#define LVT_NMI           0x00000400
+
+// Interrupt vectors owned by the LAPIC (PIC uses 32-47, syscalls 128)
+#define LAPIC_TIMER_VECTOR    0x40
+#define IPI_TLB_VECTOR        0xF0
+#define IPI_RESCHED_VECTOR    0xF1
+#define LAPIC_SPURIOUS_VECTOR 0xFF
+
+int lapic_present();
+void lapic_map();
+void lapic_init();
+uint32_t lapic_id();
+void lapic_eoi();
+void lapic_send_ipi(uint32_t apic_id, uint32_t vector);
+void lapic_send_icr(uint32_t apic_id, uint32_t icr_lo);
+void lapic_timer_calibrate();
+void lapic_timer_start(uint32_t hz);
+void lapic_timer_handler();
+
+#endif
@@ -0,0 +1,24 @@
+#ifndef MSR_H
+#define MSR_H
+
+#include <stdint.h>
+
+// Model Specific Registers used by the kernel
+#define MSR_SYSENTER_CS   0x174 // Ring 0 CS for SYSENTER (SS = CS + 8, user CS/SS = CS + 16/24)
+#define MSR_SYSENTER_ESP  0x175 // ESP loaded by SYSENTER
+#define MSR_SYSENTER_EIP  0x176 // EIP loaded by SYSENTER
+#define MSR_APIC_BASE     0x1B  // Local APIC physical base (bits 12-31) + Global Enable (bit 11)
+
+// Read a 64-bit MSR (EDX:EAX)
+static inline uint64_t rdmsr(uint32_t msr) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdmsr" : "=a"(lo), "=d"(hi) : "c"(msr));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// Write a 64-bit MSR (EDX:EAX)
+static inline void wrmsr(uint32_t msr, uint64_t value) {
+    __asm__ volatile("wrmsr" : : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32)));
+}
+
+#endif
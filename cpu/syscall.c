@@ -47,71 +47,326 @@ void syscall_read(registers_t *regs) {
 // External sys_execve
 extern int sys_execve(char *filename, char **argv, char **envp, registers_t *regs);
 
-/* 
-// Deprecated: syscall_exec logic moved to helper
-void syscall_exec(registers_t *regs) { ... } 
-*/
-
 // Helper for Exit
 // Removed: syscall_exit implemented in process.c
 extern void sys_exit(int code);
 extern int sys_wait(int *status);
 extern int sys_fork(registers_t *regs);
 extern int sys_clone(registers_t *regs);
-extern int sys_futex_wait(int *addr, int val);
-extern void sys_futex_wake(int *addr);
 extern void fs_list_files(); // For SYS_LS (syscall 13)
+extern int sys_spawn(char *filename);
+extern int sys_setprio(uint32_t tid, int prio);
+extern int sys_set_thread_area(uint32_t base, uint32_t size, registers_t *regs);
 
-void syscall_handler(registers_t *regs) {
-    // Dispatch based on EAX
-    switch (regs->eax) {
-        case 0: // READ
-            syscall_read(regs);
-            break;
-        case 1: // WRITE
-            syscall_write(regs);
-            break;
-        case 2: // EXIT
-            // EAX = sys_exit(code)
-            sys_exit(regs->ebx); 
-            break;
-        case 3: // EXEC
-            // EAX = sys_execve(filename, argv, envp, regs)
-            // Currently ignoring argv/envp (NULL)
-            regs->eax = sys_execve((char*)regs->ebx, 0, 0, regs); 
-            break;
-        case 4: // FORK
-            // EAX = sys_fork(regs)
-            // while(1);
-            regs->eax = sys_fork(regs);
-            //while(1);
-            break;
-        case 5: // WAIT
-            // EAX = sys_wait(status)
-            // status pointer in EBX
-            regs->eax = sys_wait((int*)regs->ebx);
-            break;
-        case 10: // CLONE (Thread Creation)
-            // EAX = sys_clone(regs)
-            // EBX = Stack Pointer (New Stack)
-            regs->eax = sys_clone(regs);
-            break;
-        case 11: // FUTEX_WAIT
-            // EAX = sys_futex_wait(addr, val)
-            // EBX = addr (pointer to lock variable in user space)
-            // ECX = val (expected value to compare against)
-            regs->eax = sys_futex_wait((int*)regs->ebx, (int)regs->ecx);
-            break;
-        case 12: // FUTEX_WAKE
-            // EBX = addr (pointer to lock variable in user space)
-            sys_futex_wake((int*)regs->ebx);
-            break;
-        case 13: // LS — list all files in the filesystem
-            fs_list_files();
-            break;
-        default:
-            print_string("Unknown Syscall: ");
-            print_dec(regs->eax);
+#include "../kernel/ring.h"
+#include "../kernel/futex.h"
+#include "../kernel/shm.h"
+#include "../fs/simplefs.h"
+#include "../kernel/process.h"
+#include "../mm/vmm.h"
+#include "../mm/kheap.h"
+
+extern void memory_copy(char *source, char *dest, int nbytes);
+
+// ---------------------------------------------------------
+// Register Unpacking Helpers (one per table entry)
+// ---------------------------------------------------------
+
+void syscall_exit(registers_t *regs) {
+    // EBX = Exit Code
+    sys_exit(regs->ebx);
+}
+
+void syscall_exec(registers_t *regs) {
+    // EAX = sys_execve(filename, argv, envp, regs)
+    // Currently ignoring argv/envp (NULL)
+    regs->eax = sys_execve((char*)regs->ebx, 0, 0, regs);
+}
+
+void syscall_fork(registers_t *regs) {
+    // EAX = Child PID (Parent) / 0 (Child, set up inside sys_fork)
+    regs->eax = sys_fork(regs);
+}
+
+void syscall_wait(registers_t *regs) {
+    // EBX = status pointer
+    regs->eax = sys_wait((int*)regs->ebx);
+}
+
+void syscall_clone(registers_t *regs) {
+    // EBX = Stack Pointer (New Stack), ECX = Entry Point
+    regs->eax = sys_clone(regs);
+}
+
+void syscall_futex_wait(registers_t *regs) {
+    // EBX = addr (pointer to lock variable in user space)
+    // ECX = val (expected value to compare against)
+    regs->eax = futex_wait((uint32_t*)regs->ebx, regs->ecx, 0, 0);
+}
+
+void syscall_futex_wake(registers_t *regs) {
+    // EBX = addr (pointer to lock variable in user space)
+    regs->eax = futex_wake((uint32_t*)regs->ebx, 1, 0);
+}
+
+void syscall_futex(registers_t *regs) {
+    // EBX = uaddr, ECX = op (FUTEX_*), EDX = val, ESI = val2 (timeout ms / nr_requeue),
+    // EDI = uaddr2, EBP = val3 (FUTEX_CMP_REQUEUE only, INT 0x80 only:
+    // on the SYSENTER path EBP holds the user stack pointer)
+    regs->eax = sys_futex((uint32_t*)regs->ebx, (int)regs->ecx, regs->edx, regs->esi,
+                          (uint32_t*)regs->edi, regs->ebp);
+}
+
+void syscall_ls(registers_t *regs) {
+    // List all files in the filesystem
+    fs_list_files();
+}
+
+void syscall_sysstat(registers_t *regs) {
+    // EBX = 0: Print statistics, 1: Reset them
+    if (regs->ebx == 1) {
+        syscall_reset_stats();
+    } else {
+        syscall_dump_stats();
+    }
+}
+
+void syscall_ring_setup(registers_t *regs) {
+    // EBX = Ring address in user space (NULL = unregister)
+    regs->eax = sys_ring_setup((syscall_ring_t*)regs->ebx);
+}
+
+void syscall_ring_enter(registers_t *regs) {
+    // EBX = Number of queued SQEs to process
+    regs->eax = sys_ring_enter(regs->ebx);
+}
+
+void syscall_spawn(registers_t *regs) {
+    // EBX = Filename
+    char name[FILENAME_MAX_LEN];
+    regs->eax = copy_user_filename(regs->ebx, name) == 0 ? sys_spawn(name) : -1;
+}
+
+void syscall_shm_map(registers_t *regs) {
+    // EBX = Key, ECX = Address, EDX = Size in bytes (0 = whole existing object)
+    regs->eax = sys_shm_map(regs->ebx, regs->ecx, regs->edx);
+}
+
+void syscall_setprio(registers_t *regs) {
+    // EBX = TID (0 = caller), ECX = New priority (-1 = just query)
+    regs->eax = sys_setprio(regs->ebx, (int)regs->ecx);
+}
+
+void syscall_set_thread_area(registers_t *regs) {
+    // EBX = TLS Block Address, ECX = Size in bytes (0 = remove)
+    regs->eax = sys_set_thread_area(regs->ebx, regs->ecx, regs);
+}
+
+// File writes (SimpleFS is flat and has no file descriptors: files are named)
+
+void syscall_creat(registers_t *regs) {
+    // EBX = Filename. Creates an empty file, or empties an existing one.
+    char name[FILENAME_MAX_LEN];
+    if (copy_user_filename(regs->ebx, name) != 0) {
+        regs->eax = -1;
+        return;
+    }
+    regs->eax = fs_open_or_create(name, 1) >= 0 ? 0 : -1;
+}
+
+void syscall_append(registers_t *regs) {
+    // EBX = Filename (created if missing), ECX = Buffer, EDX = Count
+    // EAX = Bytes written or -1
+    char name[FILENAME_MAX_LEN];
+    page_directory *pd = (page_directory*)P2V((uint32_t)current_process->pd);
+    if (copy_user_filename(regs->ebx, name) != 0 ||
+        (regs->edx && !vmm_is_user_range(pd, regs->ecx, regs->edx))) {
+        regs->eax = -1;
+        return;
+    }
+    int ino = fs_open_or_create(name, 0);
+    if (ino < 0) {
+        regs->eax = -1;
+        return;
+    }
+    regs->eax = fs_write(ino, FS_APPEND, regs->edx, (char*)regs->ecx);
+}
+
+void syscall_truncate(registers_t *regs) {
+    // EBX = Filename, ECX = New size in bytes
+    char name[FILENAME_MAX_LEN];
+    int ino = copy_user_filename(regs->ebx, name) == 0 ? fs_lookup(name) : -1;
+    regs->eax = ino < 0 ? -1 : fs_truncate(ino, regs->ecx);
+}
+
+void syscall_unlink(registers_t *regs) {
+    // EBX = Filename
+    char name[FILENAME_MAX_LEN];
+    regs->eax = copy_user_filename(regs->ebx, name) == 0 ? fs_unlink(name) : -1;
+}
+
+void syscall_fsync(registers_t *regs) {
+    // Write every dirty block back before returning
+    regs->eax = fs_sync();
+}
+
+void syscall_readfile(registers_t *regs) {
+    // EBX = Filename, ECX = File offset, EDX = Buffer, ESI = Count
+    // EAX = Bytes read (0 at end of file) or -1
+    char name[FILENAME_MAX_LEN];
+    page_directory *pd = (page_directory*)P2V((uint32_t)current_process->pd);
+    sfs_file_t file;
+    if (copy_user_filename(regs->ebx, name) != 0 ||
+        (regs->esi && !vmm_is_user_range(pd, regs->edx, regs->esi)) ||
+        !fs_open(name, &file)) {
+        regs->eax = -1;
+        return;
+    }
+
+    // Through a kernel buffer, a page at a time: the disk drivers may DMA
+    // whole blocks straight into the destination, and need a kernel address
+    uint32_t count = regs->esi;
+    uint32_t chunk = count < PAGE_SIZE ? count : PAGE_SIZE;
+    char *kbuf = (char*)kmalloc(chunk ? chunk : 1);
+    if (!kbuf) {
+        regs->eax = -1;
+        return;
+    }
+
+    int done = 0;
+    while ((uint32_t)done < count) {
+        uint32_t want = count - done < chunk ? count - done : chunk;
+        int n = fs_read(&file, regs->ecx + done, want, kbuf);
+        if (n < 0) {
+            done = -1;
             break;
+        }
+        memory_copy(kbuf, (char*)regs->edx + done, n);
+        done += n;
+        if ((uint32_t)n < want) break; // End of file
+    }
+    kfree(kbuf);
+    regs->eax = done;
+}
+
+// ---------------------------------------------------------
+// Dispatch Table (indexed by EAX)
+// ---------------------------------------------------------
+static syscall_entry_t syscall_table[NUM_SYSCALLS] = {
+    [SYS_READ]       = { "read",       3, syscall_read },
+    [SYS_WRITE]      = { "write",      3, syscall_write },
+    [SYS_EXIT]       = { "exit",       1, syscall_exit },
+    [SYS_EXEC]       = { "exec",       1, syscall_exec },
+    [SYS_FORK]       = { "fork",       0, syscall_fork },
+    [SYS_WAIT]       = { "wait",       1, syscall_wait },
+    [SYS_CLONE]      = { "clone",      2, syscall_clone },
+    [SYS_FUTEX_WAIT] = { "futex_wait", 2, syscall_futex_wait },
+    [SYS_FUTEX_WAKE] = { "futex_wake", 1, syscall_futex_wake },
+    [SYS_LS]         = { "ls",         0, syscall_ls },
+    [SYS_SYSSTAT]    = { "sysstat",    1, syscall_sysstat },
+    [SYS_RING_SETUP] = { "ring_setup", 1, syscall_ring_setup },
+    [SYS_RING_ENTER] = { "ring_enter", 1, syscall_ring_enter },
+    [SYS_SPAWN]      = { "spawn",      1, syscall_spawn },
+    [SYS_FUTEX]      = { "futex",      6, syscall_futex },
+    [SYS_SHM_MAP]    = { "shm_map",    3, syscall_shm_map },
+    [SYS_SETPRIO]    = { "setprio",    2, syscall_setprio },
+    [SYS_SET_THREAD_AREA] = { "set_thread_area", 2, syscall_set_thread_area },
+    [SYS_CREAT]      = { "creat",      1, syscall_creat },
+    [SYS_APPEND]     = { "append",     3, syscall_append },
+    [SYS_TRUNCATE]   = { "truncate",   2, syscall_truncate },
+    [SYS_UNLINK]     = { "unlink",     1, syscall_unlink },
+    [SYS_FSYNC]      = { "fsync",      0, syscall_fsync },
+    [SYS_READFILE]   = { "readfile",   4, syscall_readfile },
+};
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// floor(log2(cycles)), clamped to the last histogram bucket
+static uint32_t latency_bucket(uint64_t cycles) {
+    uint32_t hi = (uint32_t)(cycles >> 32);
+    uint32_t lo = (uint32_t)cycles;
+
+    if (hi) return SYSCALL_HIST_BUCKETS - 1;
+    if (lo == 0) return 0;
+
+    uint32_t bucket = 31 - __builtin_clz(lo);
+    if (bucket >= SYSCALL_HIST_BUCKETS) bucket = SYSCALL_HIST_BUCKETS - 1;
+    return bucket;
+}
+
+void syscall_handler(registers_t *regs) {
+    uint32_t num = regs->eax;
+
+    if (num >= NUM_SYSCALLS || !syscall_table[num].handler) {
+        print_string("Unknown Syscall: ");
+        print_dec(num);
+        return;
+    }
+
+    syscall_entry_t *entry = &syscall_table[num];
+
+    // Count first: exit() never comes back here
+    __sync_fetch_and_add(&entry->calls, 1);
+
+    uint64_t start = rdtsc();
+    entry->handler(regs);
+    uint64_t cycles = rdtsc() - start;
+
+    // Blocking calls (wait, futex_wait, read) may have slept and been preempted,
+    // so the counter update must be atomic.
+    __sync_fetch_and_add(&entry->hist[latency_bucket(cycles)], 1);
+}
+
+// SYSENTER path (see sysenter_entry): the return address is still on the user
+// stack at EBP. It is fetched here, where the page can be checked first.
+void sysenter_handler(registers_t *regs) {
+    page_directory *pd = (page_directory*)P2V((uint32_t)current_process->pd);
+    if (!vmm_is_user_range(pd, regs->ebp, sizeof(uint32_t))) {
+        sys_exit(-1); // No return address: nothing sane to go back to
+    }
+    regs->eip = *(uint32_t*)regs->ebp;
+    syscall_handler(regs);
+}
+
+// Print invocation counts and the non-empty latency buckets of every used syscall
+void syscall_dump_stats() {
+    print_string("--- Syscall Statistics (latency in TSC cycles, log2 buckets) ---\n");
+    for (int i = 0; i < NUM_SYSCALLS; i++) {
+        syscall_entry_t *entry = &syscall_table[i];
+        if (!entry->handler || entry->calls == 0) continue;
+
+        print_string("  [");
+        print_dec(i);
+        print_string("] ");
+        print_string(entry->name);
+        print_string(" (");
+        print_dec(entry->nargs);
+        print_string(" args): ");
+        print_dec(entry->calls);
+        print_string(" calls\n   ");
+
+        for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+            if (entry->hist[b] == 0) continue;
+            print_string(" 2^");
+            print_dec(b);
+            if (b == SYSCALL_HIST_BUCKETS - 1) print_string("+");
+            print_string(":");
+            print_dec(entry->hist[b]);
+        }
+        print_string("\n");
+    }
+    print_string("----------------------------------------------------------------\n");
+}
+
+void syscall_reset_stats() {
+    for (int i = 0; i < NUM_SYSCALLS; i++) {
+        syscall_table[i].calls = 0;
+        for (int b = 0; b < SYSCALL_HIST_BUCKETS; b++) {
+            syscall_table[i].hist[b] = 0;
+        }
     }
 }
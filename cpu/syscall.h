@@ -3,6 +3,53 @@
 
 #include "isr.h"
 
+// System Call Numbers (EAX)
+// programs/lib.c uses the same numbers.
+#define SYS_READ        0
+#define SYS_WRITE       1
+#define SYS_EXIT        2
+#define SYS_EXEC        3
+#define SYS_FORK        4
+#define SYS_WAIT        5
+#define SYS_CLONE       10
+#define SYS_FUTEX_WAIT  11
+#define SYS_FUTEX_WAKE  12
+#define SYS_LS          13
+#define SYS_SYSSTAT     14
+#define SYS_RING_SETUP  15
+#define SYS_RING_ENTER  16
+#define SYS_SPAWN       17
+#define SYS_FUTEX       18
+#define SYS_SHM_MAP     19
+#define SYS_SETPRIO     20
+#define SYS_SET_THREAD_AREA 21
+#define SYS_CREAT       22
+#define SYS_APPEND      23
+#define SYS_TRUNCATE    24
+#define SYS_UNLINK      25
+#define SYS_FSYNC       26
+#define SYS_READFILE    27
+
+#define NUM_SYSCALLS    32
+
+// Latency histogram: bucket k counts calls that took [2^k, 2^(k+1)) TSC cycles.
+// The last bucket also collects everything slower (e.g. a long wait()).
+#define SYSCALL_HIST_BUCKETS 32
+
+typedef void (*syscall_fn_t)(registers_t *regs);
+
+// One slot of the dispatch table
+typedef struct {
+    char *name;                              // For the statistics dump
+    uint8_t nargs;                           // Number of register arguments (EBX, ECX, EDX, ...)
+    syscall_fn_t handler;                    // NULL = unused number
+    uint32_t calls;                          // Invocation counter
+    uint32_t hist[SYSCALL_HIST_BUCKETS];     // log2 latency histogram (TSC cycles)
+} syscall_entry_t;
+
 void syscall_handler(registers_t *regs);
+void sysenter_handler(registers_t *regs); // Called by sysenter_entry (cpu/interrupt.asm)
+void syscall_dump_stats();
+void syscall_reset_stats();
 
 #endif
@@ -0,0 +1,47 @@
+#include "sysenter.h"
+#include "msr.h"
+#include "tss.h"
+
+extern void print_string(char *str);
+
+extern void sysenter_entry();    // Entry stub in interrupt.asm
+
+int sysenter_enabled = 0;
+
+// CPUID.1:EDX bit 11 = SEP (SYSENTER/SYSEXIT supported)
+static int cpu_has_sep() {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 11) & 1;
+}
+
+// Program the SYSENTER MSRs (call after init_gdt/init_tss, once per CPU:
+// the MSRs are per-CPU, and the BSP decides whether the fast path is used at all).
+// INT 0x80 stays installed, so old binaries keep working either way.
+void init_sysenter() {
+    uint32_t cpu = cpu_id();
+
+    if (cpu != 0 && !sysenter_enabled) return;
+    if (!cpu_has_sep()) {
+        print_string("SYSENTER: Not supported by CPU, using INT 0x80 only.\n");
+        return;
+    }
+
+    // CS = Kernel Code (0x08). The CPU derives the rest from it:
+    //   Kernel SS = 0x10, User CS = 0x18 | 3 = 0x1B, User SS = 0x20 | 3 = 0x23
+    // which matches our GDT layout exactly.
+    wrmsr(MSR_SYSENTER_CS, 0x08);
+
+    // ESP = &tss_entry[cpu].esp0 (NOT a stack!)
+    // SYSENTER does not know the current task, but the scheduler already keeps
+    // this CPU's esp0 up to date. The entry stub does 'mov esp, [esp]' to pick it up,
+    // so a context switch never has to rewrite this MSR.
+    wrmsr(MSR_SYSENTER_ESP, (uint32_t)&tss_entry[cpu].esp0);
+
+    wrmsr(MSR_SYSENTER_EIP, (uint32_t)sysenter_entry);
+
+    if (cpu == 0) {
+        sysenter_enabled = 1;
+        print_string("SYSENTER: Fast System Call Path Enabled.\n");
+    }
+}
@@ -0,0 +1,11 @@
+#ifndef SYSENTER_H
+#define SYSENTER_H
+
+#include <stdint.h>
+
+// 1 if the SYSENTER/SYSEXIT fast path is set up (published to user space via the vDSO page)
+extern int sysenter_enabled;
+
+void init_sysenter();
+
+#endif
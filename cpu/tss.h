@@ -33,7 +33,12 @@ typedef struct {
     uint16_t iomap_base;
 } __attribute__((packed)) tss_entry_t;
 
-void init_tss();
+#include "gdt.h"
+
+// One TSS per CPU (indexed by cpu_id())
+extern tss_entry_t tss_entry[MAX_CPUS];
+
+void init_tss(uint32_t cpu);
 void tss_set_stack(uint32_t kernel_esp);
 
 #endif
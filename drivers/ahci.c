@@ -0,0 +1,420 @@
+#include "ahci.h"
+#include "pci.h"
+#include "blockdev.h"
+#include "../cpu/isr.h"
+#include "../kernel/sync.h"
+#include "../mm/pmm.h"
+#include "../mm/vmm.h"
+
+// External for debugging (kernel.c)
+extern void print_string(char* str);
+extern void print_hex(uint32_t n);
+extern void print_dec(uint32_t n);
+extern void memset(void *dest, int val, int len);
+
+// Per-port DMA memory (AHCI_PORT_PAGES contiguous PMM blocks):
+//   block 0: command list (1KB) + FIS receive area (256B) + IDENTIFY buffer
+//   block 1+: one command table per slot (AHCI_TABLE_SIZE, 128 byte aligned)
+#define AHCI_FIS_OFFSET      1024
+#define AHCI_IDENTIFY_OFFSET 2048
+#define AHCI_TABLE_SIZE      ((sizeof(ahci_cmd_table_t) + 127) & ~127)
+#define AHCI_PORT_PAGES      (1 + (AHCI_MAX_SLOTS * AHCI_TABLE_SIZE + PAGE_SIZE - 1) / PAGE_SIZE)
+#define AHCI_SPIN_LIMIT      1000000 // Register polling loops (HBA state changes)
+
+typedef struct {
+    int hba_port;              // Port number on the HBA
+    volatile uint32_t *regs;   // Port registers
+    uint32_t mem_phys;
+    uint8_t *mem;
+    ahci_cmd_header_t *cl;     // Command list
+    int ncq;                   // Commands are queued (FPDMA), else one at a time
+    uint32_t nslots;           // Slots we use (NCQ depth, or 1)
+    uint32_t busy;             // Slots owned by a request
+    uint32_t issued;           // Slots handed to the HBA and not yet reaped
+    uint32_t done;             // Reaped slots...
+    uint32_t failed;           // ...that ended in an error
+    process_t *waiter[AHCI_MAX_SLOTS]; // Task sleeping on each slot
+    process_t *slot_waiters;   // Tasks waiting for a free slot (wait_next list)
+    irq_lock_t lock;           // All of the above (taken from the IRQ handler)
+    blockdev_t bd;
+} ahci_port_t;
+
+static struct {
+    volatile uint32_t *hba;    // Generic host control registers
+    uint32_t slots;            // Command slots per port (CAP.NCS + 1)
+    int ncq;                   // CAP.SNCQ
+    int irq_line;              // The PCI IRQ line has our handler
+    int irq;                   // Completion by IRQ (else callers poll)
+} ahci;
+
+static ahci_port_t ahci_ports[AHCI_MAX_PORTS];
+static int ahci_nports = 0;
+
+#define HBA_REG(r)      ahci.hba[(r) / 4]
+#define PORT_REG(p, r)  (p)->regs[(r) / 4]
+
+static ahci_cmd_table_t *ahci_table(ahci_port_t *p, uint32_t slot) {
+    return (ahci_cmd_table_t *)(p->mem + PAGE_SIZE + slot * AHCI_TABLE_SIZE);
+}
+
+static uint32_t ahci_table_phys(ahci_port_t *p, uint32_t slot) {
+    return p->mem_phys + PAGE_SIZE + slot * AHCI_TABLE_SIZE;
+}
+
+// Spin until (reg & mask) == value. Returns 0, or -1 after AHCI_SPIN_LIMIT reads.
+static int ahci_spin(volatile uint32_t *reg, uint32_t mask, uint32_t value) {
+    for (int i = 0; i < AHCI_SPIN_LIMIT; i++) {
+        if ((*reg & mask) == value) return 0;
+    }
+    return -1;
+}
+
+// Stop command processing and FIS reception (required before touching CLB/FB)
+static int ahci_port_stop(ahci_port_t *p) {
+    PORT_REG(p, AHCI_PxCMD) &= ~AHCI_PxCMD_ST;
+    if (ahci_spin(&PORT_REG(p, AHCI_PxCMD), AHCI_PxCMD_CR, 0) != 0) return -1;
+    PORT_REG(p, AHCI_PxCMD) &= ~AHCI_PxCMD_FRE;
+    return ahci_spin(&PORT_REG(p, AHCI_PxCMD), AHCI_PxCMD_FR, 0);
+}
+
+static void ahci_port_start(ahci_port_t *p) {
+    PORT_REG(p, AHCI_PxCMD) |= AHCI_PxCMD_FRE;
+    ahci_spin(&PORT_REG(p, AHCI_PxTFD), 0x88, 0); // Drive not BSY / DRQ
+    PORT_REG(p, AHCI_PxCMD) |= AHCI_PxCMD_ST;
+}
+
+// Collect finished slots (p->lock held). A slot is finished when the HBA has
+// cleared its CI bit and, for NCQ, the drive has cleared its SACT bit too.
+static void ahci_reap(ahci_port_t *p) {
+    uint32_t is = PORT_REG(p, AHCI_PxIS);
+    PORT_REG(p, AHCI_PxIS) = is;
+
+    uint32_t finished;
+    if (is & AHCI_PxIS_ERRORS) {
+        // An NCQ error aborts every outstanding command. No per-command
+        // recovery (READ LOG EXT 10h): fail them all and restart the port.
+        p->failed |= p->issued;
+        finished = p->issued;
+        ahci_port_stop(p);
+        PORT_REG(p, AHCI_PxSERR) = 0xFFFFFFFF;
+        PORT_REG(p, AHCI_PxIS) = 0xFFFFFFFF;
+        ahci_port_start(p);
+    } else {
+        finished = p->issued & ~(PORT_REG(p, AHCI_PxCI) | PORT_REG(p, AHCI_PxSACT));
+    }
+
+    p->issued &= ~finished;
+    p->done |= finished;
+    for (uint32_t slot = 0; finished; slot++, finished >>= 1) {
+        if ((finished & 1) && p->waiter[slot]) unblock_process(p->waiter[slot]);
+    }
+}
+
+// PCI IRQ (possibly shared): HBA IS says which ports want attention
+static void ahci_irq_handler(void *ctx) {
+    uint32_t is = HBA_REG(AHCI_IS);
+    if (!is) return;
+
+    for (int i = 0; i < ahci_nports; i++) {
+        ahci_port_t *p = &ahci_ports[i];
+        if (is & (1u << p->hba_port)) {
+            irq_lock(&p->lock);
+            ahci_reap(p);
+            irq_unlock(&p->lock);
+        }
+    }
+    HBA_REG(AHCI_IS) = is; // After the port bits, or the HBA raises it again
+}
+
+// Build the command in 'slot' and issue it.
+//   NCQ (FPDMA QUEUED): sector count in FEATURES, tag in COUNT bits 7:3,
+//   FUA on writes so a completed write is on stable media.
+//   Others: count in COUNT (0 for IDENTIFY and FLUSH).
+// The data buffer can be any mapped memory of the current address space.
+static void ahci_issue(ahci_port_t *p, uint32_t slot, uint8_t cmd, uint32_t lba, uint32_t count,
+                       uint8_t *buffer, uint32_t bytes, int write) {
+    ahci_cmd_table_t *t = ahci_table(p, slot);
+    memset(t->cfis, 0, sizeof(t->cfis));
+
+    uint8_t *fis = t->cfis;
+    int queued = cmd == AHCI_CMD_READ_FPDMA_QUEUED || cmd == AHCI_CMD_WRITE_FPDMA_QUEUED;
+    fis[0] = AHCI_FIS_H2D;
+    fis[1] = 0x80;           // C: this is a command
+    fis[2] = cmd;
+    fis[4] = (uint8_t)lba;
+    fis[5] = (uint8_t)(lba >> 8);
+    fis[6] = (uint8_t)(lba >> 16);
+    fis[8] = (uint8_t)(lba >> 24);
+    if (cmd != AHCI_CMD_IDENTIFY) fis[7] = 0x40; // LBA mode
+    if (queued) {
+        fis[3] = (uint8_t)count;
+        fis[11] = (uint8_t)(count >> 8);
+        fis[12] = slot << 3;
+        if (write) fis[7] |= 0x80; // FUA
+    } else {
+        fis[12] = (uint8_t)count;
+        fis[13] = (uint8_t)(count >> 8);
+    }
+
+    // PRDT: one entry per physically contiguous piece of the buffer
+    uint32_t n = 0;
+    uint32_t va = (uint32_t)buffer;
+    uint32_t end = va + bytes;
+    while (va < end) {
+        uint32_t len = PAGE_SIZE - (va & (PAGE_SIZE - 1));
+        if (len > end - va) len = end - va;
+
+        // The HBA writes behind the MMU's back: break COW with a CPU write first
+        if (!write) *(volatile uint8_t *)va = *(volatile uint8_t *)va;
+        uint32_t phys = vmm_virt_to_phys(va);
+
+        if (n > 0 && t->prdt[n - 1].dba + (t->prdt[n - 1].dbc & 0x3FFFFF) + 1 == phys) {
+            t->prdt[n - 1].dbc += len; // Physically adjacent: grow the last entry
+        } else {
+            t->prdt[n].dba = phys;
+            t->prdt[n].dbau = 0;
+            t->prdt[n].reserved = 0;
+            t->prdt[n].dbc = len - 1;
+            n++;
+        }
+        va += len;
+    }
+
+    ahci_cmd_header_t *h = &p->cl[slot];
+    h->flags = 5 | (write ? AHCI_CMDH_WRITE : 0); // H2D register FIS = 5 dwords
+    h->prdtl = n;
+    h->prdbc = 0;
+    h->ctba = ahci_table_phys(p, slot);
+    h->ctbau = 0;
+
+    irq_lock(&p->lock);
+    p->issued |= 1u << slot;
+    p->done &= ~(1u << slot);
+    p->failed &= ~(1u << slot);
+    p->waiter[slot] = 0;
+    __sync_synchronize(); // Table and header before the doorbell
+    if (queued) PORT_REG(p, AHCI_PxSACT) = 1u << slot;
+    PORT_REG(p, AHCI_PxCI) = 1u << slot;
+    irq_unlock(&p->lock);
+}
+
+// Wait for the command in 'slot'. Returns 0, or -1 if it failed.
+static int ahci_wait(ahci_port_t *p, uint32_t slot) {
+    irq_lock(&p->lock);
+    while (!(p->done & (1u << slot))) {
+        if (ahci.irq) {
+            p->waiter[slot] = current_process;
+            irq_lock_sleep(&p->lock);
+        } else {
+            ahci_reap(p);
+        }
+    }
+    p->waiter[slot] = 0;
+    int failed = (p->failed & (1u << slot)) != 0;
+    irq_unlock(&p->lock);
+    return failed ? -1 : 0;
+}
+
+// Own a free slot (sleeping until one is free)
+static uint32_t ahci_alloc_slot(ahci_port_t *p) {
+    uint32_t all = p->nslots == 32 ? 0xFFFFFFFF : (1u << p->nslots) - 1;
+
+    irq_lock(&p->lock);
+    while ((p->busy & all) == all) {
+        current_process->wait_next = p->slot_waiters;
+        p->slot_waiters = current_process;
+        irq_lock_sleep(&p->lock);
+    }
+    uint32_t slot = __builtin_ctz(~p->busy & all);
+    p->busy |= 1u << slot;
+    irq_unlock(&p->lock);
+    return slot;
+}
+
+static void ahci_free_slot(ahci_port_t *p, uint32_t slot) {
+    irq_lock(&p->lock);
+    p->busy &= ~(1u << slot);
+    process_t *w = p->slot_waiters;
+    p->slot_waiters = 0;
+    while (w) {
+        process_t *next = w->wait_next;
+        unblock_process(w);
+        w = next;
+    }
+    irq_unlock(&p->lock);
+}
+
+// One request = one command. Concurrent callers each hold a slot, so with
+// NCQ up to nslots commands are queued in the drive at once.
+static int ahci_transfer(ahci_port_t *p, uint32_t lba, uint32_t count, uint8_t *buffer, int write) {
+    uint32_t slot = ahci_alloc_slot(p);
+    uint8_t cmd;
+    if (p->ncq) cmd = write ? AHCI_CMD_WRITE_FPDMA_QUEUED : AHCI_CMD_READ_FPDMA_QUEUED;
+    else        cmd = write ? AHCI_CMD_WRITE_DMA_EXT : AHCI_CMD_READ_DMA_EXT;
+
+    ahci_issue(p, slot, cmd, lba, count, buffer, count * 512, write);
+    int result = ahci_wait(p, slot);
+
+    // Without FUA (non-queued), push writes out of the drive cache
+    if (write && !p->ncq && result == 0) {
+        ahci_issue(p, slot, AHCI_CMD_FLUSH_EXT, 0, 0, 0, 0, 0);
+        result = ahci_wait(p, slot);
+    }
+
+    ahci_free_slot(p, slot);
+
+    if (result != 0) {
+        print_string("AHCI: I/O error at LBA 0x");
+        print_hex(lba);
+        print_string("\n");
+    }
+    return result;
+}
+
+static int ahci_bd_read(blockdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    return ahci_transfer((ahci_port_t *)dev->priv, lba, count, (uint8_t *)buffer, 0);
+}
+
+static int ahci_bd_write(blockdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    return ahci_transfer((ahci_port_t *)dev->priv, lba, count, (uint8_t *)buffer, 1);
+}
+
+// Shared by every port: the IRQ line belongs to the controller
+static void ahci_bd_enable_irq(blockdev_t *dev) {
+    ahci.irq = ahci.irq_line;
+}
+
+// Bring up one port with a SATA disk on it and register it as a block device
+static void ahci_port_init(int hba_port) {
+    if (ahci_nports == AHCI_MAX_PORTS) return;
+    ahci_port_t *p = &ahci_ports[ahci_nports];
+    p->hba_port = hba_port;
+    p->regs = (volatile uint32_t *)((uint8_t *)ahci.hba + AHCI_PORT_BASE + hba_port * AHCI_PORT_SIZE);
+
+    // 1. Something that talks, and is a disk (not ATAPI / port multiplier)
+    uint32_t ssts = PORT_REG(p, AHCI_PxSSTS);
+    if ((ssts & 0x0F) != AHCI_DET_PRESENT || ((ssts >> 8) & 0x0F) != 1) return;
+    if (PORT_REG(p, AHCI_PxSIG) != AHCI_SIG_ATA) return;
+
+    // 2. Our command list, FIS area and command tables
+    p->mem_phys = pmm_alloc_blocks(AHCI_PORT_PAGES, 1);
+    if (!p->mem_phys) return;
+    p->mem = (uint8_t *)P2V(p->mem_phys);
+    memset(p->mem, 0, AHCI_PORT_PAGES * PAGE_SIZE);
+    p->cl = (ahci_cmd_header_t *)p->mem;
+
+    if (ahci_port_stop(p) != 0) {
+        print_string("AHCI: Port did not stop.\n");
+        pmm_free_blocks(p->mem_phys, AHCI_PORT_PAGES);
+        return;
+    }
+    PORT_REG(p, AHCI_PxCLB) = p->mem_phys;
+    PORT_REG(p, AHCI_PxCLBU) = 0;
+    PORT_REG(p, AHCI_PxFB) = p->mem_phys + AHCI_FIS_OFFSET;
+    PORT_REG(p, AHCI_PxFBU) = 0;
+    PORT_REG(p, AHCI_PxSERR) = 0xFFFFFFFF;
+    PORT_REG(p, AHCI_PxIS) = 0xFFFFFFFF;
+    irq_lock_init(&p->lock);
+    ahci_port_start(p);
+
+    // 3. IDENTIFY (polled: ahci.irq is still 0)
+    p->nslots = 1;
+    uint16_t *id = (uint16_t *)(p->mem + AHCI_IDENTIFY_OFFSET);
+    ahci_issue(p, 0, AHCI_CMD_IDENTIFY, 0, 0, (uint8_t *)id, 512, 0);
+    if (ahci_wait(p, 0) != 0 || !(id[83] & (1 << 10))) {
+        print_string("AHCI: IDENTIFY failed (or no LBA48).\n");
+        ahci_port_stop(p);
+        pmm_free_blocks(p->mem_phys, AHCI_PORT_PAGES);
+        return;
+    }
+
+    // 4. NCQ if both sides have it. Word 76 bit 8: NCQ, word 75: queue depth - 1
+    uint32_t sectors = id[100] | ((uint32_t)id[101] << 16);
+    if (id[102] || id[103]) sectors = 0xFFFFFFFF;
+    if (ahci.ncq && (id[76] & (1 << 8))) {
+        uint32_t depth = (id[75] & 0x1F) + 1;
+        p->ncq = 1;
+        p->nslots = depth < ahci.slots ? depth : ahci.slots;
+    }
+
+    // 5. Interrupts for command completion and errors
+    PORT_REG(p, AHCI_PxIE) = AHCI_PxIS_DHRS | AHCI_PxIS_PSS | AHCI_PxIS_DSS |
+                             AHCI_PxIS_SDBS | AHCI_PxIS_ERRORS;
+
+    // 6. Block device "sdN"
+    p->bd.name[0] = 's';
+    p->bd.name[1] = 'd';
+    p->bd.name[2] = '0' + ahci_nports;
+    p->bd.name[3] = 0;
+    p->bd.sectors = sectors;
+    p->bd.max_sectors = AHCI_MAX_SECTORS;
+    p->bd.read = ahci_bd_read;
+    p->bd.write = ahci_bd_write;
+    p->bd.enable_irq = ahci_bd_enable_irq;
+    p->bd.priv = p;
+    ahci_nports++;
+
+    print_string("AHCI: Port ");
+    print_dec(hba_port);
+    print_string(": ");
+    if (p->ncq) {
+        print_string("NCQ, queue depth ");
+        print_dec(p->nslots);
+    } else {
+        print_string("no NCQ");
+    }
+    print_string("\n");
+    blockdev_register(&p->bd);
+}
+
+void ahci_init() {
+    pci_device_t *dev = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_SATA, 0);
+    if (!dev || dev->prog_if != 0x01) return; // 0x01 = AHCI programming interface
+
+    // 1. Map ABAR (uncached). Like the LAPIC: virtual = physical, which must
+    //    lie above the kernel's direct map.
+    uint32_t abar = pci_bar(dev, 5);
+    uint32_t abar_size = AHCI_PORT_BASE + 32 * AHCI_PORT_SIZE;
+    if (abar < KERNEL_VIRT_BASE + KERNEL_DIRECT_MAP_SIZE) {
+        print_string("AHCI: ABAR 0x");
+        print_hex(abar);
+        print_string(" overlaps kernel memory, skipped.\n");
+        return;
+    }
+    for (uint32_t off = 0; off < abar_size; off += PAGE_SIZE) {
+        vmm_map_page((abar & ~(PAGE_SIZE - 1)) + off, (abar & ~(PAGE_SIZE - 1)) + off,
+                     I86_PTE_PRESENT | I86_PTE_WRITABLE | I86_PTE_NOT_CACHEABLE | I86_PTE_WRITETHROUGH);
+    }
+    ahci.hba = (volatile uint32_t *)abar;
+
+    pci_enable(dev, PCI_CMD_MEMORY | PCI_CMD_BUS_MASTER);
+
+    // 2. AHCI mode, capabilities
+    HBA_REG(AHCI_GHC) |= AHCI_GHC_AE;
+    uint32_t cap = HBA_REG(AHCI_CAP);
+    ahci.slots = ((cap >> 8) & 0x1F) + 1;
+    ahci.ncq = (cap & AHCI_CAP_SNCQ) != 0;
+
+    print_string("AHCI: Version 0x");
+    print_hex(HBA_REG(AHCI_VS));
+    print_string(", ");
+    print_dec(ahci.slots);
+    print_string(" slots");
+    if (ahci.ncq) print_string(", NCQ");
+    print_string("\n");
+
+    // 3. Every implemented port with a disk
+    uint32_t pi = HBA_REG(AHCI_PI);
+    for (int i = 0; i < 32; i++) {
+        if (pi & (1u << i)) ahci_port_init(i);
+    }
+
+    // 4. Completion IRQ (legacy INTx through the PIC)
+    HBA_REG(AHCI_IS) = 0xFFFFFFFF;
+    if (ahci_nports && pic_irq_register(dev->irq, ahci_irq_handler, 0) == 0) {
+        ahci.irq_line = 1;
+        HBA_REG(AHCI_GHC) |= AHCI_GHC_IE;
+    } else if (ahci_nports) {
+        print_string("AHCI: IRQ line not supported, polling.\n");
+    }
+}
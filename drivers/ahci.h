@@ -0,0 +1,108 @@
+#ifndef AHCI_H
+#define AHCI_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// AHCI (Serial ATA Host Controller, e.g. ICH9 on QEMU's q35 machine)
+// ---------------------------------------------------------
+// The HBA is driven through memory mapped registers (ABAR = PCI BAR5).
+// Each port has a command list of up to 32 slots; with NCQ every slot can
+// hold an outstanding READ/WRITE FPDMA QUEUED command and the drive finishes
+// them in whatever order suits it.
+
+// Generic Host Control registers
+#define AHCI_CAP        0x00    // Bit 30 = NCQ, bits 12:8 = command slots - 1
+#define AHCI_GHC        0x04    // Bit 31 = AHCI enable, bit 1 = interrupt enable
+#define AHCI_IS         0x08    // One bit per port with a pending interrupt (write 1 to clear)
+#define AHCI_PI         0x0C    // Ports implemented
+#define AHCI_VS         0x10
+
+#define AHCI_CAP_SNCQ   (1u << 30)
+#define AHCI_GHC_AE     (1u << 31)
+#define AHCI_GHC_IE     (1u << 1)
+
+// Port registers (at 0x100 + port * 0x80)
+#define AHCI_PORT_BASE  0x100
+#define AHCI_PORT_SIZE  0x80
+#define AHCI_PxCLB      0x00    // Command list base (1KB aligned)
+#define AHCI_PxCLBU     0x04
+#define AHCI_PxFB       0x08    // FIS receive area (256 byte aligned)
+#define AHCI_PxFBU      0x0C
+#define AHCI_PxIS       0x10    // Interrupt status (write 1 to clear)
+#define AHCI_PxIE       0x14
+#define AHCI_PxCMD      0x18
+#define AHCI_PxTFD      0x20    // Task file data: status (7:0), error (15:8)
+#define AHCI_PxSIG      0x24
+#define AHCI_PxSSTS     0x28    // SATA status: DET (3:0), IPM (11:8)
+#define AHCI_PxSERR     0x30
+#define AHCI_PxSACT     0x34    // NCQ tags still outstanding
+#define AHCI_PxCI       0x38    // Command slots issued and not finished
+
+#define AHCI_PxCMD_ST   0x0001  // Start processing the command list
+#define AHCI_PxCMD_FRE  0x0010  // FIS receive enable
+#define AHCI_PxCMD_FR   0x4000  // FIS receive running
+#define AHCI_PxCMD_CR   0x8000  // Command list running
+
+#define AHCI_PxIS_DHRS  (1u << 0)  // D2H register FIS (non-queued command done)
+#define AHCI_PxIS_PSS   (1u << 1)  // PIO setup FIS
+#define AHCI_PxIS_DSS   (1u << 2)  // DMA setup FIS
+#define AHCI_PxIS_SDBS  (1u << 3)  // Set device bits FIS (NCQ commands done)
+#define AHCI_PxIS_IFS   (1u << 27) // Interface fatal error
+#define AHCI_PxIS_HBDS  (1u << 28) // Host bus data error
+#define AHCI_PxIS_HBFS  (1u << 29) // Host bus fatal error
+#define AHCI_PxIS_TFES  (1u << 30) // Task file error
+#define AHCI_PxIS_ERRORS (AHCI_PxIS_IFS | AHCI_PxIS_HBDS | AHCI_PxIS_HBFS | AHCI_PxIS_TFES)
+
+#define AHCI_SIG_ATA    0x00000101 // Plain SATA disk (ATAPI = 0xEB140101)
+#define AHCI_DET_PRESENT 3         // Device present, PHY communication up
+
+// FIS types and commands
+#define AHCI_FIS_H2D        0x27
+#define AHCI_CMD_IDENTIFY   0xEC
+#define AHCI_CMD_READ_DMA_EXT  0x25
+#define AHCI_CMD_WRITE_DMA_EXT 0x35
+#define AHCI_CMD_FLUSH_EXT  0xEA
+#define AHCI_CMD_READ_FPDMA_QUEUED  0x60 // NCQ: count in FEATURES, tag in COUNT 7:3
+#define AHCI_CMD_WRITE_FPDMA_QUEUED 0x61
+
+// Command header (32 bytes, one per slot in the 1KB command list)
+typedef struct {
+    uint16_t flags;      // Bits 4:0 = FIS length in dwords, bit 6 = write
+    uint16_t prdtl;      // PRDT entries
+    volatile uint32_t prdbc; // Bytes transferred (written by the HBA)
+    uint32_t ctba;       // Command table base (128 byte aligned)
+    uint32_t ctbau;
+    uint32_t reserved[4];
+} __attribute__((packed)) ahci_cmd_header_t;
+
+#define AHCI_CMDH_WRITE 0x40
+
+// PRDT entry: one physically contiguous region (at most 4MB, even length)
+typedef struct {
+    uint32_t dba;
+    uint32_t dbau;
+    uint32_t reserved;
+    uint32_t dbc;        // Bits 21:0 = byte count - 1, bit 31 = interrupt on completion
+} __attribute__((packed)) ahci_prd_t;
+
+#define AHCI_MAX_SECTORS 256 // Per request
+#define AHCI_MAX_PRDS    (AHCI_MAX_SECTORS * 512 / 4096 + 1)
+
+// Command table: command FIS, ATAPI command, then the PRDT
+typedef struct {
+    uint8_t cfis[64];
+    uint8_t acmd[16];
+    uint8_t reserved[48];
+    ahci_prd_t prdt[AHCI_MAX_PRDS];
+} __attribute__((packed)) ahci_cmd_table_t;
+
+#define AHCI_MAX_PORTS   4   // Disks we drive (the first ones found)
+#define AHCI_MAX_SLOTS   32
+
+// Find the AHCI controller (pci_init first), map its registers and register
+// every SATA disk as a block device ("sd0", "sd1", ...). Must run before any
+// process directory is cloned (the mapping is in the kernel directory).
+void ahci_init();
+
+#endif
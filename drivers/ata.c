@@ -1,9 +1,38 @@
 #include "ata.h"
 #include "ports.h"
+#include "pci.h"
+#include "blockdev.h"
+#include "../kernel/sync.h"
+#include "../mm/pmm.h"
+#include "../mm/vmm.h"
 
 // External for debugging (kernel.c)
 extern void print_string(char* str);
 extern void print_hex(uint32_t n);
+extern void print_dec(uint32_t n);
+extern void memory_copy(char *source, char *dest, int nbytes);
+
+// What IDENTIFY told us about the primary master
+static struct {
+    int present;
+    int lba48;          // 48-bit addressing supported
+    uint32_t sectors;   // Addressable sectors (low 32 bits for LBA48 disks)
+    uint32_t multiple;  // Sectors per DRQ block for READ/WRITE MULTIPLE (0 = not enabled)
+    int dma;            // Drive supports (multiword/Ultra) DMA
+} ata_dev;
+
+// Bus-master DMA state (bm = 0: no usable controller, PIO only).
+// The drive can only reach physical memory, and callers hand us arbitrary
+// (heap, stack, user) buffers: data goes through one physically contiguous
+// bounce buffer big enough for ATA_MAX_SECTORS, owned by the request in flight.
+#define ATA_DMA_BOUNCE_BLOCKS (ATA_MAX_SECTORS * ATA_SECTOR_SIZE / PMM_BLOCK_SIZE)
+static struct {
+    uint16_t bm;          // Bus-master I/O base (primary channel)
+    uint32_t prdt_phys;   // PRD table: one PMM block (never crosses 64KB)
+    ata_prd_t *prdt;
+    uint32_t bounce_phys; // ATA_DMA_BOUNCE_BLOCKS contiguous blocks, 64KB aligned
+    uint8_t *bounce;
+} ata_dma;
 
 void ata_wait_bsy() {
     while(port_byte_in(ATA_STATUS) & ATA_SR_BSY);
@@ -13,43 +42,395 @@ void ata_wait_drq() {
     while(!(port_byte_in(ATA_STATUS) & ATA_SR_DRQ));
 }
 
-// 400ns delay function (Status port read 4 times)
+// 400ns delay function (Alternate Status port read 4 times)
 void ata_wait_400ns() {
     for(int i = 0; i < 4; i++) {
-        port_byte_in(ATA_STATUS);
+        port_byte_in(ATA_ALT_STATUS);
     }
 }
 
-// Read One Sector (512 Bytes) using LBA28
-void ata_read_sector(uint32_t lba, uint8_t *buffer) {
+// Wait until the drive is done with the current step.
+// need_drq: it must be ready to transfer a data block.
+// Returns 0, or -1 on an error / drive fault.
+static int ata_poll(int need_drq) {
+    ata_wait_400ns();
     ata_wait_bsy();
-    
-    // Select Drive (Master) + LBA High 4 bits
-    // 0xE0 = 11100000 (Mode=LBA, Drive=0)
-    port_byte_out(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
-    
+
+    uint8_t status = port_byte_in(ATA_STATUS);
+    if (status & (ATA_SR_ERR | ATA_SR_DF)) return -1;
+    if (need_drq && !(status & ATA_SR_DRQ)) return -1;
+    return 0;
+}
+
+// One command at a time: the task file registers are shared by all CPUs.
+// A sleeping (PI) mutex, so callers queue up without spinning while the disk works.
+static mutex_t ata_mutex;
+
+// IRQ14 completion. The mutex admits one request at a time, so one waiter
+// slot is enough: the task that owns the bus sleeps here until the drive
+// raises INTRQ (data block ready, or command done).
+static struct {
+    int enabled;              // Set by ata_enable_irq(); until then we poll
+    volatile int pending;     // An IRQ arrived since the last ata_irq_arm()
+    volatile uint8_t status;  // Status register as read by the IRQ handler
+    process_t *waiter;        // Task sleeping in ata_wait_irq (NULL = none)
+} ata_irq;
+static irq_lock_t ata_irq_lock; // Protects ata_irq (taken from the IRQ handler)
+
+// IRQ14: reading STATUS deasserts the drive's INTRQ; then wake the waiter
+void ata_irq_handler() {
+    uint8_t status = port_byte_in(ATA_STATUS);
+
+    // DMA: acknowledge the controller too (keep ERR for the waiter to see)
+    if (ata_dma.bm) {
+        uint8_t bm_status = port_byte_in(ata_dma.bm + ATA_BM_STATUS);
+        port_byte_out(ata_dma.bm + ATA_BM_STATUS, (bm_status & ~ATA_BM_SR_ERR) | ATA_BM_SR_IRQ);
+    }
+
+    irq_lock(&ata_irq_lock);
+    ata_irq.status = status;
+    ata_irq.pending = 1;
+    if (ata_irq.waiter) unblock_process(ata_irq.waiter);
+    irq_unlock(&ata_irq_lock);
+
+    // EOI to both PICs: IRQ14 comes in through the slave
+    port_byte_out(0xA0, 0x20);
+    port_byte_out(0x20, 0x20);
+}
+
+// Forget any earlier IRQ. Called BEFORE the step that makes the drive raise
+// the next one (issuing a command, moving a data block), so it can't be lost.
+static void ata_irq_arm() {
+    irq_lock(&ata_irq_lock);
+    ata_irq.pending = 0;
+    irq_unlock(&ata_irq_lock);
+}
+
+// Sleep until the IRQ armed by ata_irq_arm() arrives, then check the status
+// it reported (same result convention as ata_poll).
+static int ata_wait_irq(int need_drq) {
+    irq_lock(&ata_irq_lock);
+    while (!ata_irq.pending) {
+        ata_irq.waiter = current_process;
+        irq_lock_sleep(&ata_irq_lock);
+    }
+    ata_irq.waiter = 0;
+    uint8_t status = ata_irq.status;
+    irq_unlock(&ata_irq_lock);
+
+    if (status & (ATA_SR_ERR | ATA_SR_DF)) return -1;
+    if (need_drq && !(status & ATA_SR_DRQ)) return -1;
+    return 0;
+}
+
+// Wait for the drive: sleep on IRQ14 once it is enabled, poll before that
+static int ata_wait(int need_drq) {
+    return ata_irq.enabled ? ata_wait_irq(need_drq) : ata_poll(need_drq);
+}
+
+static int ata_bd_read(blockdev_t *dev, uint32_t lba, uint32_t count, void *buffer);
+static int ata_bd_write(blockdev_t *dev, uint32_t lba, uint32_t count, const void *buffer);
+static void ata_bd_enable_irq(blockdev_t *dev);
+
+// The primary master as a block device (sectors filled in by ata_init)
+static blockdev_t ata_blockdev = {
+    "hda", 0, ATA_MAX_SECTORS, ata_bd_read, ata_bd_write, ata_bd_enable_irq, 0
+};
+
+// Find the PCI IDE controller of the primary channel and set up bus-master
+// DMA: enable bus mastering, allocate the PRD table and the bounce buffer.
+static void ata_dma_init() {
+    if (!ata_dev.dma) return;
+
+    pci_device_t *ide = pci_find_class(PCI_CLASS_STORAGE, PCI_SUBCLASS_IDE, 0);
+    if (!ide || !(ide->prog_if & PCI_PROG_IF_BUS_MASTER) || !pci_bar_is_io(ide, 4)) {
+        print_string("ATA: No bus-master IDE controller, using PIO.\n");
+        return;
+    }
+
+    uint32_t prdt = pmm_alloc_block();
+    uint32_t bounce = pmm_alloc_blocks(ATA_DMA_BOUNCE_BLOCKS, 0x10000 / PMM_BLOCK_SIZE);
+    if (!prdt || !bounce) {
+        if (prdt) pmm_free_block(prdt);
+        print_string("ATA: No memory for DMA buffers, using PIO.\n");
+        return;
+    }
+
+    pci_enable(ide, PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+
+    ata_dma.prdt_phys = prdt;
+    ata_dma.prdt = (ata_prd_t *)P2V(prdt);
+    ata_dma.bounce_phys = bounce;
+    ata_dma.bounce = (uint8_t *)P2V(bounce);
+    ata_dma.bm = (uint16_t)pci_bar(ide, 4);
+
+    // Stop the engine and clear stale IRQ/ERR bits
+    port_byte_out(ata_dma.bm + ATA_BM_CMD, 0);
+    port_byte_out(ata_dma.bm + ATA_BM_STATUS, ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+
+    print_string("ATA: Bus-master DMA at I/O 0x");
+    print_hex(ata_dma.bm);
+    print_string("\n");
+}
+
+void ata_init() {
+    // Poll during boot: keep the drive from raising IRQ14 until ata_enable_irq()
+    port_byte_out(ATA_DEV_CTRL, 0x02);
+    mutex_init(&ata_mutex);
+    irq_lock_init(&ata_irq_lock);
+
+    // 1. IDENTIFY the Master
+    port_byte_out(ATA_DRIVE_HEAD, 0xA0);
     ata_wait_400ns();
+    port_byte_out(ATA_SECTOR_CNT, 0);
+    port_byte_out(ATA_LBA_LO, 0);
+    port_byte_out(ATA_LBA_MID, 0);
+    port_byte_out(ATA_LBA_HI, 0);
+    port_byte_out(ATA_COMMAND, ATA_CMD_IDENTIFY);
+
+    uint8_t status = port_byte_in(ATA_STATUS);
+    if (status == 0 || status == 0xFF) {
+        print_string("ATA: No drive on the primary bus.\n");
+        return;
+    }
+    ata_wait_bsy();
+
+    // ATAPI/SATA signatures: not a plain ATA disk
+    if (port_byte_in(ATA_LBA_MID) || port_byte_in(ATA_LBA_HI)) {
+        print_string("ATA: Primary master is not an ATA disk.\n");
+        return;
+    }
+    if (ata_poll(1) != 0) {
+        print_string("ATA: IDENTIFY failed.\n");
+        return;
+    }
+
+    uint16_t id[256];
+    port_words_in(ATA_DATA, id, 256);
+
+    // 2. Capabilities
+    //    Word 83 bit 10: LBA48 feature set. Words 100-103: LBA48 sector count.
+    //    Words 60-61: LBA28 sector count. Word 47 low byte: max sectors per DRQ block.
+    ata_dev.lba48 = (id[83] & (1 << 10)) != 0;
+    if (ata_dev.lba48) {
+        ata_dev.sectors = id[100] | ((uint32_t)id[101] << 16);
+        if (id[102] || id[103]) ata_dev.sectors = 0xFFFFFFFF; // Beyond 2TB: we address 32 bits
+    } else {
+        ata_dev.sectors = id[60] | ((uint32_t)id[61] << 16);
+    }
+    ata_dev.present = 1;
+    ata_blockdev.sectors = ata_dev.sectors;
+    ata_dev.dma = (id[49] & (1 << 8)) != 0; // Word 49 bit 8: DMA supported
+
+    // 3. Enable READ/WRITE MULTIPLE: one DRQ handshake per block instead of per sector
+    uint32_t max_multiple = id[47] & 0xFF;
+    if (max_multiple) {
+        uint32_t multiple = max_multiple < ATA_MULTIPLE_MAX ? max_multiple : ATA_MULTIPLE_MAX;
+        port_byte_out(ATA_DRIVE_HEAD, 0xE0);
+        port_byte_out(ATA_SECTOR_CNT, multiple);
+        port_byte_out(ATA_COMMAND, ATA_CMD_SET_MULTIPLE);
+        if (ata_poll(0) == 0) ata_dev.multiple = multiple;
+    }
+
+    print_string("ATA: ");
+    print_dec(ata_dev.sectors / 2048);
+    print_string(" MB");
+    if (ata_dev.lba48) print_string(", LBA48");
+    print_string(", ");
+    print_dec(ata_dev.multiple ? ata_dev.multiple : 1);
+    print_string(" sector(s) per DRQ block\n");
+
+    ata_dma_init();
+    blockdev_register(&ata_blockdev);
+}
+
+// Switch to interrupt-driven completion: callers sleep instead of spinning.
+// Needs the scheduler (current_process), so kernel_main calls it after
+// init_multitasking(). IRQ14 must be unmasked (pic_remap) and routed (IDT 46).
+void ata_enable_irq() {
+    if (!ata_dev.present) return;
+
+    // Still single-threaded here (before the first 'sti'): no request in flight
+    ata_irq_arm();
+    ata_irq.enabled = 1;
+    port_byte_out(ATA_DEV_CTRL, 0x00); // nIEN = 0
+}
+
+// Load the task file and start 'cmd'. LBA48 writes every register twice
+// (high order bytes first): the drive keeps a two-deep FIFO per register.
+static void ata_issue(uint32_t lba, uint32_t count, int lba48, uint8_t cmd) {
+    if (lba48) {
+        port_byte_out(ATA_DRIVE_HEAD, 0x40);
+        port_byte_out(ATA_SECTOR_CNT, (uint8_t)(count >> 8)); // 256 = 0x0100
+        port_byte_out(ATA_LBA_LO, (uint8_t)(lba >> 24));
+        port_byte_out(ATA_LBA_MID, 0);                        // LBA bits 32-47
+        port_byte_out(ATA_LBA_HI, 0);
+    } else {
+        // Select Drive (Master) + LBA High 4 bits
+        // 0xE0 = 11100000 (Mode=LBA, Drive=0)
+        port_byte_out(ATA_DRIVE_HEAD, 0xE0 | ((lba >> 24) & 0x0F));
+    }
+    ata_wait_400ns();
+
+    // Sector Count (256 is sent as 0 in LBA28)
+    port_byte_out(ATA_SECTOR_CNT, (uint8_t)count);
 
-    // Sector Count = 1
-    port_byte_out(ATA_SECTOR_CNT, 1);
-    
     // Send LBA Address (Low -> Mid -> High)
     port_byte_out(ATA_LBA_LO, (uint8_t)(lba));
     port_byte_out(ATA_LBA_MID, (uint8_t)(lba >> 8));
     port_byte_out(ATA_LBA_HI, (uint8_t)(lba >> 16));
-    
-    // Send Command (Read PIO)
-    port_byte_out(ATA_COMMAND, ATA_CMD_READ_PIO);
 
-    ata_wait_400ns();
-    
+    port_byte_out(ATA_COMMAND, cmd);
+}
+
+// PIO data phase: the CPU moves every word through the data port
+static int ata_transfer_pio(uint32_t lba, uint32_t count, uint8_t *buffer, int write, int lba48) {
+    uint32_t block = ata_dev.multiple ? ata_dev.multiple : 1;
+    uint8_t cmd;
+    if (write) {
+        if (ata_dev.multiple) cmd = lba48 ? ATA_CMD_WRITE_MULTIPLE_EXT : ATA_CMD_WRITE_MULTIPLE;
+        else                  cmd = lba48 ? ATA_CMD_WRITE_PIO_EXT : ATA_CMD_WRITE_PIO;
+    } else {
+        if (ata_dev.multiple) cmd = lba48 ? ATA_CMD_READ_MULTIPLE_EXT : ATA_CMD_READ_MULTIPLE;
+        else                  cmd = lba48 ? ATA_CMD_READ_PIO_EXT : ATA_CMD_READ_PIO;
+    }
+
     ata_wait_bsy();
-    ata_wait_drq();
-    
-    // Read Data (256 Words = 512 Bytes)
-    for (int i = 0; i < 256; i++) {
-        uint16_t data = port_word_in(ATA_DATA);
-        buffer[i * 2] = (uint8_t)(data & 0xFF);
-        buffer[i * 2 + 1] = (uint8_t)((data >> 8) & 0xFF);
+    ata_irq_arm();
+    ata_issue(lba, count, lba48, cmd);
+
+    // One DRQ handshake per block, then the whole block with one 'rep insw/outsw'.
+    // Reads: an IRQ announces every block. Writes: the first block is requested
+    // without one, every later IRQ means "block taken" (the last one: "done").
+    for (uint32_t done = 0; done < count; ) {
+        uint32_t n = count - done < block ? count - done : block;
+        if ((write && done == 0 ? ata_poll(1) : ata_wait(1)) != 0) return -1;
+
+        ata_irq_arm();
+        if (write) {
+            port_words_out(ATA_DATA, buffer + done * ATA_SECTOR_SIZE, n * (ATA_SECTOR_SIZE / 2));
+        } else {
+            port_words_in(ATA_DATA, buffer + done * ATA_SECTOR_SIZE, n * (ATA_SECTOR_SIZE / 2));
+        }
+        done += n;
+    }
+
+    // Writes: wait for the last block to land
+    return write ? ata_wait(0) : 0;
+}
+
+// Fill the PRD table for 'bytes' of the bounce buffer (64KB aligned, so
+// cutting it into 64KB regions keeps every region inside one 64KB window)
+static void ata_dma_build_prdt(uint32_t bytes) {
+    int i = 0;
+    for (uint32_t off = 0; off < bytes; off += 0x10000, i++) {
+        uint32_t len = bytes - off < 0x10000 ? bytes - off : 0x10000;
+        ata_dma.prdt[i].phys = ata_dma.bounce_phys + off;
+        ata_dma.prdt[i].byte_count = (uint16_t)len; // 0x10000 -> 0 = 64KB
+        ata_dma.prdt[i].flags = 0;
+    }
+    ata_dma.prdt[i - 1].flags = ATA_PRD_EOT;
+}
+
+// DMA data phase: the controller moves the data, we sleep until the one
+// completion IRQ. Needs IRQs (ata_irq.enabled) and the bounce buffer.
+static int ata_transfer_dma(uint32_t lba, uint32_t count, uint8_t *buffer, int write, int lba48) {
+    uint16_t bm = ata_dma.bm;
+    uint32_t bytes = count * ATA_SECTOR_SIZE;
+    uint8_t cmd = write ? (lba48 ? ATA_CMD_WRITE_DMA_EXT : ATA_CMD_WRITE_DMA)
+                        : (lba48 ? ATA_CMD_READ_DMA_EXT : ATA_CMD_READ_DMA);
+    uint8_t dir = write ? 0 : ATA_BM_CMD_READ;
+
+    if (write) memory_copy((char *)buffer, (char *)ata_dma.bounce, bytes);
+    ata_dma_build_prdt(bytes);
+
+    // 1. Program the engine (stopped): PRD table, direction, clean status
+    port_byte_out(bm + ATA_BM_CMD, 0);
+    port_dword_out(bm + ATA_BM_PRDT, ata_dma.prdt_phys);
+    port_byte_out(bm + ATA_BM_STATUS, port_byte_in(bm + ATA_BM_STATUS) | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+    port_byte_out(bm + ATA_BM_CMD, dir);
+
+    // 2. Command the drive, then start the engine
+    ata_wait_bsy();
+    ata_irq_arm();
+    ata_issue(lba, count, lba48, cmd);
+    port_byte_out(bm + ATA_BM_CMD, dir | ATA_BM_CMD_START);
+
+    // 3. Sleep until the drive raises IRQ14 at the end of the transfer
+    int result = ata_wait_irq(0);
+
+    // 4. Stop the engine; a bus error shows up in the bus-master status
+    port_byte_out(bm + ATA_BM_CMD, 0);
+    uint8_t bm_status = port_byte_in(bm + ATA_BM_STATUS);
+    if (bm_status & ATA_BM_SR_ERR) result = -1;
+    port_byte_out(bm + ATA_BM_STATUS, bm_status | ATA_BM_SR_IRQ | ATA_BM_SR_ERR);
+
+    if (!write && result == 0) memory_copy((char *)ata_dma.bounce, (char *)buffer, bytes);
+    return result;
+}
+
+// Shared body of ata_read_sectors / ata_write_sectors
+static int ata_transfer(uint32_t lba, uint32_t count, uint8_t *buffer, int write) {
+    if (!ata_dev.present || count == 0 || count > ATA_MAX_SECTORS) return -1;
+    if (lba + count < lba || lba + count > ata_dev.sectors) return -1;
+
+    int lba48 = lba + count > ATA_LBA28_LIMIT;
+    if (lba48 && !ata_dev.lba48) return -1;
+
+    // Boot-time (polled) requests run before there are tasks to serialize
+    if (ata_irq.enabled) mutex_lock(&ata_mutex);
+
+    int result;
+    if (ata_irq.enabled && ata_dma.bm) {
+        result = ata_transfer_dma(lba, count, buffer, write, lba48);
+    } else {
+        result = ata_transfer_pio(lba, count, buffer, write, lba48);
     }
+
+    // Writes: push the data out of the drive cache
+    if (write && result == 0) {
+        ata_irq_arm();
+        port_byte_out(ATA_COMMAND, lba48 ? ATA_CMD_CACHE_FLUSH_EXT : ATA_CMD_CACHE_FLUSH);
+        result = ata_wait(0);
+    }
+
+    if (ata_irq.enabled) mutex_unlock(&ata_mutex);
+
+    if (result != 0) {
+        print_string("ATA: I/O error at LBA 0x");
+        print_hex(lba);
+        print_string("\n");
+    }
+    return result;
+}
+
+int ata_read_sectors(uint32_t lba, uint32_t count, void *buffer) {
+    return ata_transfer(lba, count, (uint8_t *)buffer, 0);
+}
+
+int ata_write_sectors(uint32_t lba, uint32_t count, const void *buffer) {
+    return ata_transfer(lba, count, (uint8_t *)buffer, 1);
+}
+
+// Read One Sector (512 Bytes)
+int ata_read_sector(uint32_t lba, uint8_t *buffer) {
+    return ata_transfer(lba, 1, buffer, 0);
+}
+
+// Write One Sector (512 Bytes)
+int ata_write_sector(uint32_t lba, const uint8_t *buffer) {
+    return ata_transfer(lba, 1, (uint8_t *)buffer, 1);
+}
+
+// blockdev_t entry points
+static int ata_bd_read(blockdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    return ata_transfer(lba, count, (uint8_t *)buffer, 0);
+}
+
+static int ata_bd_write(blockdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    return ata_transfer(lba, count, (uint8_t *)buffer, 1);
+}
+
+static void ata_bd_enable_irq(blockdev_t *dev) {
+    ata_enable_irq();
 }
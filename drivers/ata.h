@@ -13,16 +13,77 @@
 #define ATA_DRIVE_HEAD  0x1F6
 #define ATA_STATUS      0x1F7
 #define ATA_COMMAND     0x1F7
+#define ATA_ALT_STATUS  0x3F6   // Read: Status without clearing a pending IRQ
+#define ATA_DEV_CTRL    0x3F6   // Write: Bit 1 = nIEN (no interrupts), Bit 2 = Soft Reset
 
 // Status Bits
 #define ATA_SR_BSY      0x80    // Busy
 #define ATA_SR_DRDY     0x40    // Drive Ready
+#define ATA_SR_DF       0x20    // Drive Fault
 #define ATA_SR_DRQ      0x08    // Data Request ready
 #define ATA_SR_ERR      0x01    // Error
 
 // Commands
-#define ATA_CMD_READ_PIO 0x20
+#define ATA_CMD_READ_PIO        0x20
+#define ATA_CMD_READ_PIO_EXT    0x24    // LBA48
+#define ATA_CMD_READ_MULTIPLE   0xC4    // One DRQ block per 'multiple' sectors
+#define ATA_CMD_READ_MULTIPLE_EXT 0x29
+#define ATA_CMD_WRITE_PIO       0x30
+#define ATA_CMD_WRITE_PIO_EXT   0x34
+#define ATA_CMD_WRITE_MULTIPLE  0xC5
+#define ATA_CMD_WRITE_MULTIPLE_EXT 0x39
+#define ATA_CMD_SET_MULTIPLE    0xC6
+#define ATA_CMD_CACHE_FLUSH     0xE7
+#define ATA_CMD_CACHE_FLUSH_EXT 0xEA
+#define ATA_CMD_IDENTIFY        0xEC
+#define ATA_CMD_READ_DMA        0xC8    // Bus-master DMA, one IRQ at the end
+#define ATA_CMD_READ_DMA_EXT    0x25
+#define ATA_CMD_WRITE_DMA       0xCA
+#define ATA_CMD_WRITE_DMA_EXT   0x35
 
-void ata_read_sector(uint32_t lba, uint8_t *buffer);
+// Bus-Master IDE registers (PCI BAR4 of the IDE controller, primary channel at +0)
+#define ATA_BM_CMD      0x00    // Bit 0 = Start, Bit 3 = Direction (1 = device -> memory)
+#define ATA_BM_STATUS   0x02    // Write 1 to clear IRQ / ERR
+#define ATA_BM_PRDT     0x04    // Physical address of the PRD table (dword aligned)
+
+#define ATA_BM_CMD_START 0x01
+#define ATA_BM_CMD_READ  0x08
+#define ATA_BM_SR_ACTIVE 0x01
+#define ATA_BM_SR_ERR    0x02
+#define ATA_BM_SR_IRQ    0x04
+
+// Physical Region Descriptor: one physically contiguous piece of the transfer.
+// A region may not cross a 64KB boundary; byte_count 0 means 64KB.
+typedef struct {
+    uint32_t phys;
+    uint16_t byte_count;
+    uint16_t flags;             // Bit 15 = last entry (EOT)
+} __attribute__((packed)) ata_prd_t;
+#define ATA_PRD_EOT     0x8000
+
+#define ATA_SECTOR_SIZE   512
+#define ATA_MAX_SECTORS   256   // Per ata_read_sectors / ata_write_sectors call
+#define ATA_MULTIPLE_MAX  16    // Sectors per DRQ block we ask for (SET MULTIPLE)
+#define ATA_LBA28_LIMIT   0x10000000 // First sector LBA28 can't address (128GB)
+
+// Identify the primary master: LBA48 support, size, READ/WRITE MULTIPLE block
+// size, and bus-master DMA if a PCI IDE controller offers it (pci_init first)
+void ata_init();
+
+// Complete requests on IRQ14 from now on: the caller sleeps while the drive
+// works. Call once the scheduler is up (before that, requests poll).
+void ata_enable_irq();
+void ata_irq_handler();
+
+// Transfer 'count' (1..ATA_MAX_SECTORS) consecutive sectors. LBA48 commands are
+// used automatically past the LBA28 limit. With IRQs enabled and a bus-master
+// controller the data moves by DMA through a bounce buffer, otherwise by PIO.
+// Returns 0 on success, -1 on error.
+int ata_read_sectors(uint32_t lba, uint32_t count, void *buffer);
+int ata_write_sectors(uint32_t lba, uint32_t count, const void *buffer);
+
+// Single sector helpers
+int ata_read_sector(uint32_t lba, uint8_t *buffer);
+int ata_write_sector(uint32_t lba, const uint8_t *buffer);
 
 #endif
@@ -0,0 +1,60 @@
+#include "blockdev.h"
+
+// External for debugging (kernel.c)
+extern void print_string(char* str);
+extern void print_dec(uint32_t n);
+
+// Filled during boot (single-threaded), read-only afterwards
+static blockdev_t *blockdevs[BLOCKDEV_MAX];
+static int nblockdevs = 0;
+
+int blockdev_register(blockdev_t *dev) {
+    if (nblockdevs == BLOCKDEV_MAX) return -1;
+    blockdevs[nblockdevs++] = dev;
+
+    print_string("Block device ");
+    print_string(dev->name);
+    print_string(": ");
+    print_dec(dev->sectors / 2048);
+    print_string(" MB\n");
+    return 0;
+}
+
+int blockdev_count() {
+    return nblockdevs;
+}
+
+blockdev_t *blockdev_get(int index) {
+    if (index < 0 || index >= nblockdevs) return 0;
+    return blockdevs[index];
+}
+
+void blockdev_enable_irq() {
+    for (int i = 0; i < nblockdevs; i++) {
+        if (blockdevs[i]->enable_irq) blockdevs[i]->enable_irq(blockdevs[i]);
+    }
+}
+
+// Shared body of blockdev_read / blockdev_write
+static int blockdev_transfer(blockdev_t *dev, uint32_t lba, uint32_t count, uint8_t *buffer, int write) {
+    if (!dev || lba + count < lba || lba + count > dev->sectors) return -1;
+
+    while (count > 0) {
+        uint32_t n = count < dev->max_sectors ? count : dev->max_sectors;
+        int result = write ? dev->write(dev, lba, n, buffer) : dev->read(dev, lba, n, buffer);
+        if (result != 0) return -1;
+
+        lba += n;
+        count -= n;
+        buffer += n * BLOCKDEV_SECTOR_SIZE;
+    }
+    return 0;
+}
+
+int blockdev_read(blockdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    return blockdev_transfer(dev, lba, count, (uint8_t *)buffer, 0);
+}
+
+int blockdev_write(blockdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    return blockdev_transfer(dev, lba, count, (uint8_t *)buffer, 1);
+}
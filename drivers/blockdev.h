@@ -0,0 +1,40 @@
+#ifndef BLOCKDEV_H
+#define BLOCKDEV_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Block Devices
+// ---------------------------------------------------------
+// Every disk driver (AHCI, virtio-blk, ATA) registers one blockdev_t per disk
+// it finds. Filesystems only talk to this interface, so SimpleFS mounts from
+// whichever disk holds it. Sectors are 512 bytes everywhere.
+#define BLOCKDEV_MAX        8
+#define BLOCKDEV_NAME_LEN   8
+#define BLOCKDEV_SECTOR_SIZE 512
+
+typedef struct blockdev {
+    char name[BLOCKDEV_NAME_LEN];  // "sd0", "vda", "hda", ...
+    uint32_t sectors;              // Capacity
+    uint32_t max_sectors;          // Largest single driver request
+    // Driver entry points: 1 <= count <= max_sectors, range already checked.
+    // Return 0 on success, -1 on error. May sleep once IRQs are enabled.
+    int (*read)(struct blockdev *dev, uint32_t lba, uint32_t count, void *buffer);
+    int (*write)(struct blockdev *dev, uint32_t lba, uint32_t count, const void *buffer);
+    void (*enable_irq)(struct blockdev *dev); // Switch from polling to IRQ completion (optional)
+    void *priv;                    // Driver data (e.g. the AHCI port)
+} blockdev_t;
+
+// Drivers register in probe order; kernel_main probes the fastest first
+int blockdev_register(blockdev_t *dev);
+int blockdev_count();
+blockdev_t *blockdev_get(int index);
+
+// Let every driver complete requests by IRQ (once the scheduler is up)
+void blockdev_enable_irq();
+
+// Any number of sectors: split into driver-sized requests. 0 or -1.
+int blockdev_read(blockdev_t *dev, uint32_t lba, uint32_t count, void *buffer);
+int blockdev_write(blockdev_t *dev, uint32_t lba, uint32_t count, const void *buffer);
+
+#endif
@@ -0,0 +1,151 @@
+#include "pci.h"
+#include "ports.h"
+#include "../kernel/spinlock.h"
+
+// External for debugging (kernel.c)
+extern void print_string(char* str);
+extern void print_hex(uint32_t n);
+extern void print_dec(uint32_t n);
+
+static pci_device_t pci_devices[PCI_MAX_DEVICES];
+static int pci_count = 0;
+
+// CONFIG_ADDRESS + CONFIG_DATA is a two-step access: keep other CPUs out
+static volatile uint32_t pci_lock = 0;
+
+static uint32_t pci_address(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    return 0x80000000 | ((uint32_t)bus << 16) | ((uint32_t)(slot & 0x1F) << 11) |
+           ((uint32_t)(func & 0x07) << 8) | (offset & 0xFC);
+}
+
+uint32_t pci_config_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset) {
+    uint32_t flags = irq_save();
+    spin_lock(&pci_lock);
+    port_dword_out(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    uint32_t value = port_dword_in(PCI_CONFIG_DATA);
+    spin_unlock(&pci_lock);
+    irq_restore(flags);
+    return value;
+}
+
+void pci_config_write(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value) {
+    uint32_t flags = irq_save();
+    spin_lock(&pci_lock);
+    port_dword_out(PCI_CONFIG_ADDRESS, pci_address(bus, slot, func, offset));
+    port_dword_out(PCI_CONFIG_DATA, value);
+    spin_unlock(&pci_lock);
+    irq_restore(flags);
+}
+
+uint32_t pci_read32(pci_device_t *dev, uint8_t offset) {
+    return pci_config_read(dev->bus, dev->slot, dev->func, offset);
+}
+
+void pci_write32(pci_device_t *dev, uint8_t offset, uint32_t value) {
+    pci_config_write(dev->bus, dev->slot, dev->func, offset, value);
+}
+
+// 16-bit fields: read the containing dword and pick the half
+uint16_t pci_read16(pci_device_t *dev, uint8_t offset) {
+    return (uint16_t)(pci_read32(dev, offset) >> ((offset & 2) * 8));
+}
+
+// Read-modify-write of the containing dword. STATUS (next to COMMAND) has
+// write-1-to-clear bits, so it is written back as 0 (no effect).
+void pci_write16(pci_device_t *dev, uint8_t offset, uint16_t value) {
+    uint32_t shift = (offset & 2) * 8;
+    uint32_t dword = pci_read32(dev, offset);
+    if (offset == PCI_COMMAND) dword &= 0x0000FFFF;
+    dword = (dword & ~(0xFFFF << shift)) | ((uint32_t)value << shift);
+    pci_write32(dev, offset, dword);
+}
+
+static void pci_add(uint8_t bus, uint8_t slot, uint8_t func) {
+    uint32_t id = pci_config_read(bus, slot, func, PCI_VENDOR_ID);
+    if ((id & 0xFFFF) == 0xFFFF || pci_count == PCI_MAX_DEVICES) return;
+
+    uint32_t class_reg = pci_config_read(bus, slot, func, 0x08); // Revision, ProgIF, Subclass, Class
+    pci_device_t *dev = &pci_devices[pci_count++];
+    dev->bus = bus;
+    dev->slot = slot;
+    dev->func = func;
+    dev->vendor = id & 0xFFFF;
+    dev->device = id >> 16;
+    dev->prog_if = (class_reg >> 8) & 0xFF;
+    dev->subclass = (class_reg >> 16) & 0xFF;
+    dev->class_code = class_reg >> 24;
+    dev->irq = pci_config_read(bus, slot, func, PCI_INTERRUPT_LINE) & 0xFF;
+
+    print_string("PCI: ");
+    print_dec(bus);
+    print_string(":");
+    print_dec(slot);
+    print_string(".");
+    print_dec(func);
+    print_string(" ");
+    print_hex(dev->vendor);
+    print_string(":");
+    print_hex(dev->device);
+    print_string(" class ");
+    print_hex(dev->class_code);
+    print_string("/");
+    print_hex(dev->subclass);
+    print_string(" IRQ ");
+    print_dec(dev->irq);
+    print_string("\n");
+}
+
+// Brute force scan: 256 buses x 32 slots. Function 0 always exists on a
+// present device; functions 1-7 only on multi-function devices.
+void pci_init() {
+    for (uint32_t bus = 0; bus < 256; bus++) {
+        for (uint32_t slot = 0; slot < 32; slot++) {
+            uint32_t id = pci_config_read(bus, slot, 0, PCI_VENDOR_ID);
+            if ((id & 0xFFFF) == 0xFFFF) continue;
+
+            pci_add(bus, slot, 0);
+
+            uint32_t header = pci_config_read(bus, slot, 0, 0x0C) >> 16; // Header type byte
+            if (header & 0x80) {
+                for (uint32_t func = 1; func < 8; func++) {
+                    pci_add(bus, slot, func);
+                }
+            }
+        }
+    }
+
+    print_string("PCI: ");
+    print_dec(pci_count);
+    print_string(" function(s) found.\n");
+}
+
+pci_device_t *pci_find_class(uint8_t class_code, uint8_t subclass, int n) {
+    for (int i = 0; i < pci_count; i++) {
+        if (pci_devices[i].class_code == class_code && pci_devices[i].subclass == subclass) {
+            if (n-- == 0) return &pci_devices[i];
+        }
+    }
+    return 0;
+}
+
+pci_device_t *pci_find_device(uint16_t vendor, uint16_t device, int n) {
+    for (int i = 0; i < pci_count; i++) {
+        if (pci_devices[i].vendor == vendor && pci_devices[i].device == device) {
+            if (n-- == 0) return &pci_devices[i];
+        }
+    }
+    return 0;
+}
+
+int pci_bar_is_io(pci_device_t *dev, int n) {
+    return pci_read32(dev, PCI_BAR0 + n * 4) & 1;
+}
+
+uint32_t pci_bar(pci_device_t *dev, int n) {
+    uint32_t bar = pci_read32(dev, PCI_BAR0 + n * 4);
+    return (bar & 1) ? (bar & ~0x3) : (bar & ~0xF);
+}
+
+void pci_enable(pci_device_t *dev, uint16_t cmd_bits) {
+    pci_write16(dev, PCI_COMMAND, pci_read16(dev, PCI_COMMAND) | cmd_bits);
+}
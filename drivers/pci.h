@@ -0,0 +1,69 @@
+#ifndef PCI_H
+#define PCI_H
+
+#include <stdint.h>
+
+// PCI Configuration Mechanism #1 (I/O ports)
+#define PCI_CONFIG_ADDRESS 0xCF8   // Write: 0x80000000 | bus << 16 | slot << 11 | func << 8 | offset
+#define PCI_CONFIG_DATA    0xCFC   // Read/Write: the selected dword
+
+// Configuration space offsets (header type 0)
+#define PCI_VENDOR_ID      0x00    // 16 bits, 0xFFFF = no device
+#define PCI_DEVICE_ID      0x02
+#define PCI_COMMAND        0x04
+#define PCI_STATUS         0x06
+#define PCI_PROG_IF        0x09
+#define PCI_SUBCLASS       0x0A
+#define PCI_CLASS          0x0B
+#define PCI_HEADER_TYPE    0x0E    // Bit 7 = multi-function device
+#define PCI_BAR0           0x10    // BAR n at PCI_BAR0 + n * 4
+#define PCI_SUBSYSTEM_ID   0x2E
+#define PCI_CAP_PTR        0x34
+#define PCI_INTERRUPT_LINE 0x3C    // Legacy PIC IRQ assigned by the BIOS
+
+// Command register bits
+#define PCI_CMD_IO         0x0001
+#define PCI_CMD_MEMORY     0x0002
+#define PCI_CMD_BUS_MASTER 0x0004  // Device may DMA
+#define PCI_CMD_INTX_OFF   0x0400
+
+// Class codes we look for
+#define PCI_CLASS_STORAGE  0x01
+#define PCI_SUBCLASS_IDE   0x01
+#define PCI_SUBCLASS_SATA  0x06
+#define PCI_PROG_IF_BUS_MASTER 0x80 // IDE: controller supports bus-master DMA
+
+#define PCI_MAX_DEVICES    32
+
+// One function found by pci_init()
+typedef struct {
+    uint8_t bus, slot, func;
+    uint16_t vendor, device;
+    uint8_t class_code, subclass, prog_if;
+    uint8_t irq;               // PCI_INTERRUPT_LINE
+} pci_device_t;
+
+// Raw configuration space access (offset is dword aligned for the 32-bit calls)
+uint32_t pci_config_read(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset);
+void pci_config_write(uint8_t bus, uint8_t slot, uint8_t func, uint8_t offset, uint32_t value);
+uint16_t pci_read16(pci_device_t *dev, uint8_t offset);
+void pci_write16(pci_device_t *dev, uint8_t offset, uint16_t value);
+uint32_t pci_read32(pci_device_t *dev, uint8_t offset);
+void pci_write32(pci_device_t *dev, uint8_t offset, uint32_t value);
+
+// Scan every bus/slot/function once and remember what is there
+void pci_init();
+
+// n-th device (0 = first) with this class/subclass, or NULL
+pci_device_t *pci_find_class(uint8_t class_code, uint8_t subclass, int n);
+// n-th device with this vendor/device ID, or NULL
+pci_device_t *pci_find_device(uint16_t vendor, uint16_t device, int n);
+
+// BAR n with the type bits masked off (I/O port base or memory address)
+uint32_t pci_bar(pci_device_t *dev, int n);
+int pci_bar_is_io(pci_device_t *dev, int n);
+
+// Set bits in the command register (e.g. PCI_CMD_BUS_MASTER | PCI_CMD_IO)
+void pci_enable(pci_device_t *dev, uint16_t cmd_bits);
+
+#endif
@@ -29,4 +29,30 @@ unsigned short port_word_in(unsigned short port)
 void port_word_out(unsigned short port, unsigned short data)
 {
   __asm__("outw %0, %1" : : "a"(data), "d"(port));
-}
\ No newline at end of file
+}
+
+// Read 4 bytes (Dword) from a specific port
+unsigned int port_dword_in(unsigned short port)
+{
+  unsigned int result;
+  __asm__ volatile("inl %1, %0" : "=a"(result) : "d"(port));
+  return result;
+}
+
+// Write 4 bytes (Dword) to a specific port
+void port_dword_out(unsigned short port, unsigned int data)
+{
+  __asm__ volatile("outl %0, %1" : : "a"(data), "d"(port));
+}
+
+// Read 'count' words from a port into memory with one 'rep insw'
+void port_words_in(unsigned short port, void *buffer, unsigned int count)
+{
+  __asm__ volatile("cld; rep insw" : "+D"(buffer), "+c"(count) : "d"(port) : "memory");
+}
+
+// Write 'count' words from memory to a port with one 'rep outsw'
+void port_words_out(unsigned short port, const void *buffer, unsigned int count)
+{
+  __asm__ volatile("cld; rep outsw" : "+S"(buffer), "+c"(count) : "d"(port) : "memory");
+}
@@ -8,5 +8,9 @@ unsigned char port_byte_in(unsigned short port);
 void port_byte_out(unsigned short port, unsigned char data);
 unsigned short port_word_in(unsigned short port);
 void port_word_out(unsigned short port, unsigned short data);
+unsigned int port_dword_in(unsigned short port);
+void port_dword_out(unsigned short port, unsigned int data);
+void port_words_in(unsigned short port, void *buffer, unsigned int count);        // 'rep insw'
+void port_words_out(unsigned short port, const void *buffer, unsigned int count); // 'rep outsw'
 
 #endif
\ No newline at end of file
@@ -6,6 +6,7 @@
 #define PIT_FREQUENCY 1193182
 
 uint32_t tick = 0;
+uint32_t timer_hz = 0; // Frequency set by init_timer() (exported to the vDSO page)
 
 // Need print functions for debugging
 extern void print_string(char *str);
@@ -14,12 +15,30 @@ extern void print_dec(int n);
 // Defined in process.c
 extern void schedule(); 
 
+// Defined in kernel/vdso.c
+extern void vdso_update_clock();
+
+// Defined in kernel/futex.c
+extern void futex_timer_tick();
+
+// Defined in fs/bcache.c
+extern void bcache_timer_tick();
+
 void timer_handler() {
     tick++;
 
+    // Publish the new tick (and TSC sample) to the user-visible shared page
+    vdso_update_clock();
+
     // Send EOI to Master PIC (Essential, otherwise system hangs)
     // MUST be sent BEFORE schedule() switches tasks!
     port_byte_out(0x20, 0x20);
+
+    // Wake futex waiters whose timeout expired
+    futex_timer_tick();
+
+    // Periodic write-back of dirty disk buffers
+    bcache_timer_tick();
     
     // Call Scheduler to switch tasks if needed
     schedule();
@@ -34,6 +53,7 @@ void init_timer(uint32_t freq) {
     // The PIT uses a divisor to divide its base frequency (1.19MHz)
     // output_freq = base_freq / divisor
     uint32_t divisor = PIT_FREQUENCY / freq;
+    timer_hz = freq;
 
     // 2. Send Command Byte to Port 0x43
     // 0x36 = 00 11 011 0
@@ -51,3 +71,50 @@ void init_timer(uint32_t freq) {
     print_dec(freq);
     print_string("Hz\n");
 }
+
+
+// -------------------------------------------------
+// PIT Channel 2: One-Shot Delays
+// -------------------------------------------------
+// Channel 2 is normally the PC speaker. Its gate is software controlled
+// (port 0x61 bit 0) and its output can be read back (port 0x61 bit 5),
+// so it makes a polled stopwatch that works with interrupts disabled.
+// Used for the SMP bring-up delays and LAPIC timer calibration.
+
+#define PIT_CH2_DATA  0x42
+#define PIT_COMMAND   0x43
+#define PIT_CH2_GATE  0x61
+
+// Arm channel 2 to count down 'ms' milliseconds (16-bit counter: ms <= 54)
+void pit_oneshot_start(uint32_t ms) {
+    uint32_t count = (PIT_FREQUENCY / 1000) * ms;
+
+    // Gate low (stop), speaker data off
+    uint8_t gate = port_byte_in(PIT_CH2_GATE) & ~0x03;
+    port_byte_out(PIT_CH2_GATE, gate);
+
+    // 0xB0 = 10 11 000 0: Channel 2, Lo/Hi Byte, Mode 0 (Interrupt on Terminal Count), Binary
+    port_byte_out(PIT_COMMAND, 0xB0);
+    port_byte_out(PIT_CH2_DATA, (uint8_t)(count & 0xFF));
+    port_byte_out(PIT_CH2_DATA, (uint8_t)((count >> 8) & 0xFF));
+
+    // Gate high: counting starts now
+    port_byte_out(PIT_CH2_GATE, gate | 0x01);
+}
+
+// 1 once the count armed by pit_oneshot_start() has reached 0 (OUT2 goes high)
+int pit_oneshot_done() {
+    return (port_byte_in(PIT_CH2_GATE) & 0x20) != 0;
+}
+
+// Busy-wait (interrupts may be off)
+void timer_delay_ms(uint32_t ms) {
+    while (ms > 0) {
+        uint32_t chunk = (ms > 50) ? 50 : ms;
+        pit_oneshot_start(chunk);
+        while (!pit_oneshot_done()) {
+            __asm__ volatile("pause");
+        }
+        ms -= chunk;
+    }
+}
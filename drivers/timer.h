@@ -6,4 +6,9 @@
 void init_timer(uint32_t freq);
 void timer_handler();
 
+// PIT Channel 2 one-shot (busy-wait delays, independent of IRQ 0 / interrupts)
+void pit_oneshot_start(uint32_t ms); // ms <= 50
+int pit_oneshot_done();
+void timer_delay_ms(uint32_t ms);
+
 #endif
@@ -0,0 +1,65 @@
+#ifndef VIRTIO_H
+#define VIRTIO_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Virtio (legacy PCI interface, virtio 0.9.5 / "transitional" devices)
+// ---------------------------------------------------------
+// Registers live in the I/O BAR (BAR0). Device specific configuration
+// follows the common header (without MSI-X, which we never enable).
+#define VIRTIO_PCI_VENDOR         0x1AF4
+#define VIRTIO_PCI_HOST_FEATURES  0x00  // 32 bits, RO: what the device offers
+#define VIRTIO_PCI_GUEST_FEATURES 0x04  // 32 bits: what we accept
+#define VIRTIO_PCI_QUEUE_PFN      0x08  // 32 bits: physical page number of the selected queue
+#define VIRTIO_PCI_QUEUE_SIZE     0x0C  // 16 bits, RO: entries in the selected queue
+#define VIRTIO_PCI_QUEUE_SEL      0x0E  // 16 bits
+#define VIRTIO_PCI_QUEUE_NOTIFY   0x10  // 16 bits: write a queue index to kick it
+#define VIRTIO_PCI_STATUS         0x12  // 8 bits
+#define VIRTIO_PCI_ISR            0x13  // 8 bits, read clears: bit 0 = queue, bit 1 = config change
+#define VIRTIO_PCI_CONFIG         0x14  // Device specific configuration
+
+// Device status bits (written in this order during initialization)
+#define VIRTIO_STATUS_ACKNOWLEDGE 0x01
+#define VIRTIO_STATUS_DRIVER      0x02
+#define VIRTIO_STATUS_DRIVER_OK   0x04
+#define VIRTIO_STATUS_FAILED      0x80
+
+// Feature bits common to all devices
+#define VIRTIO_RING_F_INDIRECT_DESC (1 << 28)
+
+// ---------------------------------------------------------
+// Split virtqueue
+// ---------------------------------------------------------
+// Legacy layout, in one physically contiguous, page aligned area:
+//   descriptor table (16 * size), available ring (6 + 2 * size),
+//   padding to the next page, used ring (6 + 8 * size).
+#define VIRTQ_DESC_F_NEXT     1  // 'next' is valid
+#define VIRTQ_DESC_F_WRITE    2  // Device writes this buffer (else reads it)
+#define VIRTQ_DESC_F_INDIRECT 4  // Buffer is a table of descriptors
+
+typedef struct {
+    uint64_t addr;   // Physical address
+    uint32_t len;
+    uint16_t flags;
+    uint16_t next;
+} __attribute__((packed)) virtq_desc_t;
+
+typedef struct {
+    uint16_t flags;
+    uint16_t idx;    // Where we put the next entry (free running)
+    uint16_t ring[];
+} __attribute__((packed)) virtq_avail_t;
+
+typedef struct {
+    uint32_t id;     // Head descriptor of the finished chain
+    uint32_t len;    // Bytes written by the device
+} __attribute__((packed)) virtq_used_elem_t;
+
+typedef struct {
+    uint16_t flags;
+    volatile uint16_t idx; // Where the device puts the next entry (free running, device-written)
+    virtq_used_elem_t ring[];
+} __attribute__((packed)) virtq_used_t;
+
+#endif
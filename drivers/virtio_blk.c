@@ -0,0 +1,395 @@
+#include "virtio_blk.h"
+#include "virtio.h"
+#include "pci.h"
+#include "blockdev.h"
+#include "ports.h"
+#include "../cpu/isr.h"
+#include "../kernel/sync.h"
+#include "../mm/pmm.h"
+#include "../mm/vmm.h"
+
+// External for debugging (kernel.c)
+extern void print_string(char* str);
+extern void print_hex(uint32_t n);
+extern void print_dec(uint32_t n);
+extern void memset(void *dest, int val, int len);
+
+// Per-slot DMA memory: header, status byte and (with INDIRECT_DESC) the
+// slot's own descriptor table, so a request takes one ring entry
+#define VBLK_SLOT_SIZE     1024
+#define VBLK_SLOT_STATUS   16
+#define VBLK_SLOT_TABLE    64
+#define VBLK_CHAIN_MAX     (VIRTIO_BLK_MAX_SEGS + 2) // Header + data + status
+
+static struct {
+    int present;
+    uint16_t io;             // Legacy I/O BAR
+    uint16_t qsize;
+    virtq_desc_t *desc;
+    virtq_avail_t *avail;
+    virtq_used_t *used;
+    uint16_t last_used;      // Next used ring entry to reap
+    int indirect;            // VIRTIO_RING_F_INDIRECT_DESC negotiated
+    int flush;               // VIRTIO_BLK_F_FLUSH negotiated
+    int readonly;
+    uint32_t sectors;        // Capacity (low 32 bits)
+    int irq_line;            // The PCI IRQ line has our handler
+    int irq;                 // Completion by IRQ (else callers poll)
+    uint32_t nslots;
+    uint32_t free_slots;
+    process_t *slot_waiters; // Tasks waiting for free_slots (wait_next list)
+    uint32_t slots_phys;
+    uint8_t *slots;
+} vblk;
+
+static struct {
+    int busy;
+    volatile int done;       // Set by vblk_reap (IRQ handler or a polling caller)
+    process_t *waiter;       // Task sleeping on this request (NULL = none)
+} vblk_slot[VIRTIO_BLK_MAX_REQS];
+
+static irq_lock_t vblk_lock; // Rings, slots, slot_waiters (taken from the IRQ handler)
+
+static int vblk_bd_read(blockdev_t *dev, uint32_t lba, uint32_t count, void *buffer);
+static int vblk_bd_write(blockdev_t *dev, uint32_t lba, uint32_t count, const void *buffer);
+static void vblk_bd_enable_irq(blockdev_t *dev);
+
+static blockdev_t vblk_blockdev = {
+    "vda", 0, VIRTIO_BLK_MAX_SECTORS, vblk_bd_read, vblk_bd_write, vblk_bd_enable_irq, 0
+};
+
+// Collect finished requests from the used ring (vblk_lock held)
+static void vblk_reap() {
+    while (vblk.last_used != vblk.used->idx) {
+        __asm__ volatile("" ::: "memory"); // Read the entry after seeing idx
+        virtq_used_elem_t *e = &vblk.used->ring[vblk.last_used % vblk.qsize];
+        uint32_t slot = vblk.indirect ? e->id : e->id / VBLK_CHAIN_MAX;
+
+        vblk_slot[slot].done = 1;
+        if (vblk_slot[slot].waiter) unblock_process(vblk_slot[slot].waiter);
+        vblk.last_used++;
+    }
+}
+
+// PCI IRQ: reading ISR acknowledges (and deasserts) the interrupt. The line
+// may be shared, so an ISR of 0 means "not us".
+static void vblk_irq_handler(void *ctx) {
+    uint8_t isr = port_byte_in(vblk.io + VIRTIO_PCI_ISR);
+    if (!(isr & 1)) return;
+
+    irq_lock(&vblk_lock);
+    vblk_reap();
+    irq_unlock(&vblk_lock);
+}
+
+// Set up virtqueue 0 in PMM memory and hand it to the device
+static int vblk_setup_queue() {
+    port_word_out(vblk.io + VIRTIO_PCI_QUEUE_SEL, 0);
+    vblk.qsize = port_word_in(vblk.io + VIRTIO_PCI_QUEUE_SIZE);
+    if (vblk.qsize == 0) return -1;
+
+    uint32_t avail_end = 16 * vblk.qsize + 6 + 2 * vblk.qsize;
+    uint32_t used_off = (avail_end + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t used_size = 6 + 8 * vblk.qsize;
+    uint32_t pages = (used_off + used_size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+    uint32_t phys = pmm_alloc_blocks(pages, 1);
+    if (!phys) return -1;
+    uint8_t *mem = (uint8_t *)P2V(phys);
+    memset(mem, 0, pages * PAGE_SIZE);
+
+    vblk.desc = (virtq_desc_t *)mem;
+    vblk.avail = (virtq_avail_t *)(mem + 16 * vblk.qsize);
+    vblk.used = (virtq_used_t *)(mem + used_off);
+    vblk.avail->flags = 0; // We want interrupts
+
+    port_dword_out(vblk.io + VIRTIO_PCI_QUEUE_PFN, phys / PAGE_SIZE);
+    return 0;
+}
+
+int virtio_blk_init() {
+    pci_device_t *dev = pci_find_device(VIRTIO_PCI_VENDOR, VIRTIO_BLK_DEVICE_LEGACY, 0);
+    if (!dev || !pci_bar_is_io(dev, 0)) return -1;
+
+    pci_enable(dev, PCI_CMD_IO | PCI_CMD_BUS_MASTER);
+    vblk.io = (uint16_t)pci_bar(dev, 0);
+    irq_lock_init(&vblk_lock);
+
+    // 1. Reset, then tell the device we found it and can drive it
+    port_byte_out(vblk.io + VIRTIO_PCI_STATUS, 0);
+    port_byte_out(vblk.io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACKNOWLEDGE);
+    port_byte_out(vblk.io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER);
+
+    // 2. Features: indirect descriptors, flush, and learn about read-only
+    uint32_t host = port_dword_in(vblk.io + VIRTIO_PCI_HOST_FEATURES);
+    uint32_t guest = host & (VIRTIO_RING_F_INDIRECT_DESC | VIRTIO_BLK_F_FLUSH | VIRTIO_BLK_F_RO);
+    port_dword_out(vblk.io + VIRTIO_PCI_GUEST_FEATURES, guest);
+    vblk.indirect = (guest & VIRTIO_RING_F_INDIRECT_DESC) != 0;
+    vblk.flush = (guest & VIRTIO_BLK_F_FLUSH) != 0;
+    vblk.readonly = (guest & VIRTIO_BLK_F_RO) != 0;
+
+    // 3. Capacity (sectors beyond 2TB are not addressable by our 32-bit LBAs)
+    uint32_t cap_lo = port_dword_in(vblk.io + VIRTIO_PCI_CONFIG + VIRTIO_BLK_CFG_CAPACITY);
+    uint32_t cap_hi = port_dword_in(vblk.io + VIRTIO_PCI_CONFIG + VIRTIO_BLK_CFG_CAPACITY + 4);
+    vblk.sectors = cap_hi ? 0xFFFFFFFF : cap_lo;
+
+    // 4. The request queue and the request slots. Without indirect descriptors
+    //    every slot owns a fixed run of VBLK_CHAIN_MAX ring descriptors.
+    uint32_t slots_pages = VIRTIO_BLK_MAX_REQS * VBLK_SLOT_SIZE / PAGE_SIZE;
+    if (vblk_setup_queue() != 0 || !(vblk.slots_phys = pmm_alloc_blocks(slots_pages, 1))) {
+        port_byte_out(vblk.io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+        print_string("virtio-blk: Queue setup failed.\n");
+        return -1;
+    }
+    vblk.slots = (uint8_t *)P2V(vblk.slots_phys);
+    vblk.nslots = vblk.indirect ? vblk.qsize : vblk.qsize / VBLK_CHAIN_MAX;
+    if (vblk.nslots > VIRTIO_BLK_MAX_REQS) vblk.nslots = VIRTIO_BLK_MAX_REQS;
+    if (vblk.nslots == 0) {
+        port_byte_out(vblk.io + VIRTIO_PCI_STATUS, VIRTIO_STATUS_FAILED);
+        print_string("virtio-blk: Queue too small.\n");
+        return -1;
+    }
+    vblk.free_slots = vblk.nslots;
+
+    // 5. Driver ready
+    port_byte_out(vblk.io + VIRTIO_PCI_STATUS,
+                  VIRTIO_STATUS_ACKNOWLEDGE | VIRTIO_STATUS_DRIVER | VIRTIO_STATUS_DRIVER_OK);
+
+    // 6. Completion IRQ (legacy INTx, routed through the PIC)
+    if (pic_irq_register(dev->irq, vblk_irq_handler, 0) == 0) {
+        vblk.irq_line = 1;
+    } else {
+        print_string("virtio-blk: IRQ line not supported, polling.\n");
+    }
+    vblk.present = 1;
+
+    print_string("virtio-blk: ");
+    print_dec(vblk.sectors / 2048);
+    print_string(" MB, queue ");
+    print_dec(vblk.qsize);
+    print_string(", ");
+    print_dec(vblk.nslots);
+    print_string(" request slot(s)");
+    if (vblk.indirect) print_string(", indirect");
+    if (vblk.readonly) print_string(", read-only");
+    print_string("\n");
+
+    vblk_blockdev.sectors = vblk.sectors;
+    blockdev_register(&vblk_blockdev);
+    return 0;
+}
+
+int virtio_blk_present() {
+    return vblk.present;
+}
+
+uint32_t virtio_blk_sectors() {
+    return vblk.sectors;
+}
+
+void virtio_blk_enable_irq() {
+    // Only if the line got a handler: otherwise keep polling
+    vblk.irq = vblk.present && vblk.irq_line;
+}
+
+// Take up to 'want' free slots (at least one, sleeping until one is free).
+// Taking them all at once means we never sleep while holding slots.
+static uint32_t vblk_alloc_slots(uint32_t want, uint32_t *out) {
+    irq_lock(&vblk_lock);
+    while (vblk.free_slots == 0) {
+        current_process->wait_next = vblk.slot_waiters;
+        vblk.slot_waiters = current_process;
+        irq_lock_sleep(&vblk_lock);
+    }
+
+    uint32_t n = 0;
+    for (uint32_t i = 0; i < vblk.nslots && n < want; i++) {
+        if (!vblk_slot[i].busy) {
+            vblk_slot[i].busy = 1;
+            out[n++] = i;
+        }
+    }
+    vblk.free_slots -= n;
+    irq_unlock(&vblk_lock);
+    return n;
+}
+
+static void vblk_free_slots(uint32_t *slots, uint32_t n) {
+    irq_lock(&vblk_lock);
+    for (uint32_t i = 0; i < n; i++) vblk_slot[slots[i]].busy = 0;
+    vblk.free_slots += n;
+
+    // Wake every waiter: each takes what it can, the rest sleep again
+    process_t *w = vblk.slot_waiters;
+    vblk.slot_waiters = 0;
+    while (w) {
+        process_t *next = w->wait_next;
+        unblock_process(w);
+        w = next;
+    }
+    irq_unlock(&vblk_lock);
+}
+
+// Describe [buffer, buffer + bytes) as physically contiguous segments in
+// d[0..]; descriptor j links to index 'base + j + 1'. Returns the count.
+static uint32_t vblk_build_sg(uint8_t *buffer, uint32_t bytes, int device_writes,
+                              virtq_desc_t *d, uint16_t base) {
+    uint32_t n = 0;
+    uint32_t va = (uint32_t)buffer;
+    uint32_t end = va + bytes;
+
+    while (va < end) {
+        uint32_t len = PAGE_SIZE - (va & (PAGE_SIZE - 1));
+        if (len > end - va) len = end - va;
+
+        // The device writes behind the MMU's back: break COW (and fault the
+        // page in) with a CPU write first, so it fills our private copy
+        if (device_writes) *(volatile uint8_t *)va = *(volatile uint8_t *)va;
+        uint32_t phys = vmm_virt_to_phys(va);
+
+        if (n > 0 && d[n - 1].addr + d[n - 1].len == phys) {
+            d[n - 1].len += len; // Physically adjacent: extend the last segment
+        } else {
+            d[n].addr = phys;
+            d[n].len = len;
+            d[n].flags = VIRTQ_DESC_F_NEXT | (device_writes ? VIRTQ_DESC_F_WRITE : 0);
+            d[n].next = base + n + 1;
+            n++;
+        }
+        va += len;
+    }
+    return n;
+}
+
+// Build the chain for one request in 'slot' and make it visible to the device
+static void vblk_submit(uint32_t slot, uint32_t type, uint32_t lba, uint8_t *buffer, uint32_t bytes) {
+    uint8_t *mem = vblk.slots + slot * VBLK_SLOT_SIZE;
+    uint32_t mem_phys = vblk.slots_phys + slot * VBLK_SLOT_SIZE;
+
+    virtio_blk_req_hdr_t *hdr = (virtio_blk_req_hdr_t *)mem;
+    hdr->type = type;
+    hdr->reserved = 0;
+    hdr->sector = lba;
+    mem[VBLK_SLOT_STATUS] = 0xFF;
+
+    // Indirect: the chain lives in the slot's table (indices from 0) and the
+    // ring gets one descriptor pointing at it. Direct: the slot's ring run.
+    uint16_t head = vblk.indirect ? slot : slot * VBLK_CHAIN_MAX;
+    uint16_t base = vblk.indirect ? 0 : head;
+    virtq_desc_t *d = vblk.indirect ? (virtq_desc_t *)(mem + VBLK_SLOT_TABLE) : &vblk.desc[head];
+
+    uint32_t n = 0;
+    d[n].addr = mem_phys;
+    d[n].len = sizeof(virtio_blk_req_hdr_t);
+    d[n].flags = VIRTQ_DESC_F_NEXT;
+    d[n].next = base + 1;
+    n++;
+
+    n += vblk_build_sg(buffer, bytes, type == VIRTIO_BLK_T_IN, d + n, base + n);
+
+    d[n].addr = mem_phys + VBLK_SLOT_STATUS;
+    d[n].len = 1;
+    d[n].flags = VIRTQ_DESC_F_WRITE;
+    d[n].next = 0;
+    n++;
+
+    if (vblk.indirect) {
+        vblk.desc[head].addr = mem_phys + VBLK_SLOT_TABLE;
+        vblk.desc[head].len = n * sizeof(virtq_desc_t);
+        vblk.desc[head].flags = VIRTQ_DESC_F_INDIRECT;
+        vblk.desc[head].next = 0;
+    }
+
+    irq_lock(&vblk_lock);
+    vblk_slot[slot].done = 0;
+    vblk_slot[slot].waiter = 0;
+    vblk.avail->ring[vblk.avail->idx % vblk.qsize] = head;
+    __asm__ volatile("" ::: "memory"); // Entry before index (x86 keeps store order)
+    vblk.avail->idx++;
+    irq_unlock(&vblk_lock);
+
+    __sync_synchronize(); // Index visible before the kick
+    port_word_out(vblk.io + VIRTIO_PCI_QUEUE_NOTIFY, 0);
+}
+
+// Wait for the request in 'slot' and return its status (0 = OK)
+static int vblk_wait(uint32_t slot) {
+    irq_lock(&vblk_lock);
+    while (!vblk_slot[slot].done) {
+        if (vblk.irq) {
+            vblk_slot[slot].waiter = current_process;
+            irq_lock_sleep(&vblk_lock);
+        } else {
+            vblk_reap();
+        }
+    }
+    vblk_slot[slot].waiter = 0;
+    irq_unlock(&vblk_lock);
+
+    return vblk.slots[slot * VBLK_SLOT_SIZE + VBLK_SLOT_STATUS] == VIRTIO_BLK_S_OK ? 0 : -1;
+}
+
+// Cut the transfer into VIRTIO_BLK_CHUNK requests and keep as many of them
+// in flight as we got slots: submit, then wait for the oldest request and
+// reuse its slot for the next chunk. The device may finish them in any order.
+static int vblk_transfer(uint32_t lba, uint32_t count, uint8_t *buffer, int write) {
+    if (!vblk.present || count == 0 || count > VIRTIO_BLK_MAX_SECTORS) return -1;
+    if (lba + count < lba || lba + count > vblk.sectors) return -1;
+    if (write && vblk.readonly) return -1;
+
+    uint32_t type = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;
+    uint32_t chunks = (count + VIRTIO_BLK_CHUNK - 1) / VIRTIO_BLK_CHUNK;
+    uint32_t slots[VIRTIO_BLK_MAX_REQS];
+    uint32_t nslots = vblk_alloc_slots(chunks, slots);
+
+    int result = 0;
+    uint32_t submitted = 0, completed = 0;
+    while (completed < chunks) {
+        // Fill every idle slot
+        while (submitted < chunks && submitted - completed < nslots) {
+            uint32_t first = submitted * VIRTIO_BLK_CHUNK;
+            uint32_t n = count - first < VIRTIO_BLK_CHUNK ? count - first : VIRTIO_BLK_CHUNK;
+            vblk_submit(slots[submitted % nslots], type, lba + first,
+                        buffer + first * 512, n * 512);
+            submitted++;
+        }
+        if (vblk_wait(slots[completed % nslots]) != 0) result = -1;
+        completed++;
+    }
+
+    // Writes: make them durable like the ATA driver's cache flush
+    if (write && result == 0 && vblk.flush) {
+        vblk_submit(slots[0], VIRTIO_BLK_T_FLUSH, 0, 0, 0);
+        result = vblk_wait(slots[0]);
+    }
+
+    vblk_free_slots(slots, nslots);
+
+    if (result != 0) {
+        print_string("virtio-blk: I/O error at LBA 0x");
+        print_hex(lba);
+        print_string("\n");
+    }
+    return result;
+}
+
+int virtio_blk_read_sectors(uint32_t lba, uint32_t count, void *buffer) {
+    return vblk_transfer(lba, count, (uint8_t *)buffer, 0);
+}
+
+int virtio_blk_write_sectors(uint32_t lba, uint32_t count, const void *buffer) {
+    return vblk_transfer(lba, count, (uint8_t *)buffer, 1);
+}
+
+// blockdev_t entry points
+static int vblk_bd_read(blockdev_t *dev, uint32_t lba, uint32_t count, void *buffer) {
+    return vblk_transfer(lba, count, (uint8_t *)buffer, 0);
+}
+
+static int vblk_bd_write(blockdev_t *dev, uint32_t lba, uint32_t count, const void *buffer) {
+    return vblk_transfer(lba, count, (uint8_t *)buffer, 1);
+}
+
+static void vblk_bd_enable_irq(blockdev_t *dev) {
+    virtio_blk_enable_irq();
+}
@@ -0,0 +1,54 @@
+#ifndef VIRTIO_BLK_H
+#define VIRTIO_BLK_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Virtio Block Device (legacy PCI interface, one request queue)
+// ---------------------------------------------------------
+// Requests are descriptor chains [header][data segments][status byte]. Data
+// segments point straight at the caller's pages (no bounce buffer). Several
+// requests are in flight at once: large transfers are cut into chunks that
+// the device works on in parallel, and every task gets its own request slots.
+#define VIRTIO_BLK_DEVICE_LEGACY 0x1001 // Transitional device ID (0x1042 = modern only)
+
+// Device specific configuration (offsets from VIRTIO_PCI_CONFIG)
+#define VIRTIO_BLK_CFG_CAPACITY  0x00   // 64 bits: size in 512-byte sectors
+
+// Feature bits
+#define VIRTIO_BLK_F_RO          (1 << 5)  // Read-only device
+#define VIRTIO_BLK_F_FLUSH       (1 << 9)  // VIRTIO_BLK_T_FLUSH supported
+
+// Request types and status values
+#define VIRTIO_BLK_T_IN          0
+#define VIRTIO_BLK_T_OUT         1
+#define VIRTIO_BLK_T_FLUSH       4
+#define VIRTIO_BLK_S_OK          0
+
+typedef struct {
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t sector;
+} __attribute__((packed)) virtio_blk_req_hdr_t;
+
+#define VIRTIO_BLK_MAX_SECTORS   256  // Per virtio_blk_read/write_sectors call
+#define VIRTIO_BLK_CHUNK         32   // Sectors per request when a call is split
+#define VIRTIO_BLK_MAX_REQS      32   // Request slots (requests in flight)
+#define VIRTIO_BLK_MAX_SEGS      (VIRTIO_BLK_MAX_SECTORS * 512 / 4096 + 1) // Pages one call can touch
+
+// Find and initialize the first virtio-blk PCI function (pci_init first).
+// Returns 0 if a disk is ready, -1 otherwise.
+int virtio_blk_init();
+int virtio_blk_present();
+uint32_t virtio_blk_sectors();
+
+// Complete requests on the device's PCI IRQ from now on (callers sleep).
+// Call once the scheduler is up; before that, requests poll the used ring.
+void virtio_blk_enable_irq();
+
+// Transfer 'count' (1..VIRTIO_BLK_MAX_SECTORS) sectors. Writes are flushed
+// to stable storage before returning. Returns 0 on success, -1 on error.
+int virtio_blk_read_sectors(uint32_t lba, uint32_t count, void *buffer);
+int virtio_blk_write_sectors(uint32_t lba, uint32_t count, const void *buffer);
+
+#endif
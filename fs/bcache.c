@@ -0,0 +1,589 @@
+#include "bcache.h"
+#include "../kernel/sync.h"
+#include "../mm/pmm.h"
+#include "../mm/vmm.h"
+#include "../mm/kheap.h"
+
+// External for debugging (kernel.c)
+extern void print_string(char* str);
+extern void print_dec(uint32_t n);
+extern void memory_copy(char *source, char *dest, int nbytes);
+
+#define BUFS_PER_PAGE (PMM_BLOCK_SIZE / BCACHE_BLOCK_SIZE)
+
+static buf_t *bufs = 0;
+static uint32_t nbufs = 0;
+
+static buf_t *hash_table[BCACHE_HASH_SIZE];
+
+// Unpinned buffers, least recently used at the head (recycled first)
+static buf_t *lru_head = 0;
+static buf_t *lru_tail = 0;
+
+// Tasks waiting for a buffer to finish loading or to become free
+// (linked through wait_next, all woken on any change)
+static process_t *waiters = 0;
+
+static uint32_t ndirty = 0;             // Buffers waiting to be written back
+
+static uint32_t hits = 0;
+static uint32_t misses = 0;
+static uint32_t prefetched = 0;
+static uint32_t written = 0;
+
+// Read-ahead requests for the daemon (bcache_readahead_thread)
+typedef struct {
+    blockdev_t *dev;
+    uint32_t blockno;
+    uint32_t count;
+} ra_request_t;
+
+static ra_request_t ra_queue[BCACHE_RA_QUEUE];
+static uint32_t ra_head = 0, ra_tail = 0;   // Pop at head, push at tail
+static int ra_started = 0;                  // Set by bcache_start_threads
+static process_t *ra_daemon = 0;            // The daemon, once it has run
+static volatile int ra_daemon_sleeping = 0;
+static uint8_t *ra_scratch = 0;             // BCACHE_RA_MAX blocks
+static buf_t *ra_run[BCACHE_RA_MAX];        // Buffers claimed by bcache_prefetch
+
+// Write-back: the flusher thread writes dirty buffers every
+// BCACHE_FLUSH_SECONDS (or sooner when too many pile up)
+static process_t *flusher = 0;
+static volatile int flusher_sleeping = 0;
+static uint32_t last_flush_tick = 0;
+static mutex_t flush_mutex;                 // One bcache_sync at a time (owns flush_scratch)
+static uint8_t *flush_scratch = 0;          // BCACHE_RA_MAX blocks
+static buf_t *flush_run[BCACHE_RA_MAX];     // Buffers being written by bcache_sync
+
+// Protects everything above and every buf_t's bookkeeping fields
+static irq_lock_t bcache_lock;
+
+static inline uint32_t bcache_hash(blockdev_t *dev, uint32_t blockno) {
+    return (blockno ^ ((uint32_t)dev >> 4)) & (BCACHE_HASH_SIZE - 1);
+}
+
+static buf_t *hash_lookup(blockdev_t *dev, uint32_t blockno) {
+    buf_t *b = hash_table[bcache_hash(dev, blockno)];
+    while (b && (b->dev != dev || b->blockno != blockno)) b = b->hash_next;
+    return b;
+}
+
+static void hash_insert(buf_t *b) {
+    uint32_t h = bcache_hash(b->dev, b->blockno);
+    b->hash_next = hash_table[h];
+    hash_table[h] = b;
+}
+
+static void hash_remove(buf_t *b) {
+    buf_t **pp = &hash_table[bcache_hash(b->dev, b->blockno)];
+    while (*pp && *pp != b) pp = &(*pp)->hash_next;
+    if (*pp) *pp = b->hash_next;
+    b->hash_next = 0;
+}
+
+static void lru_remove(buf_t *b) {
+    if (b->lru_prev) b->lru_prev->lru_next = b->lru_next;
+    else lru_head = b->lru_next;
+    if (b->lru_next) b->lru_next->lru_prev = b->lru_prev;
+    else lru_tail = b->lru_prev;
+    b->lru_prev = b->lru_next = 0;
+}
+
+// Most recently used end
+static void lru_push_tail(buf_t *b) {
+    b->lru_next = 0;
+    b->lru_prev = lru_tail;
+    if (lru_tail) lru_tail->lru_next = b;
+    else lru_head = b;
+    lru_tail = b;
+}
+
+// Recycled next (buffers holding nothing useful)
+static void lru_push_head(buf_t *b) {
+    b->lru_prev = 0;
+    b->lru_next = lru_head;
+    if (lru_head) lru_head->lru_prev = b;
+    else lru_tail = b;
+    lru_head = b;
+}
+
+// Pin / unpin. A buffer sits on the LRU list exactly while it is unpinned
+// and clean: dirty buffers can't be recycled until they are written back.
+static void buf_pin(buf_t *b) {
+    if (b->refcnt++ == 0 && !b->dirty) lru_remove(b);
+}
+
+static void buf_unpin(buf_t *b) {
+    if (--b->refcnt == 0 && !b->dirty) {
+        if (b->valid) lru_push_tail(b);
+        else lru_push_head(b);
+    }
+}
+
+// Sleep until the next bcache_wake_all (bcache_lock held, re-acquired on return)
+static void bcache_sleep() {
+    current_process->wait_next = waiters;
+    waiters = current_process;
+    irq_lock_sleep(&bcache_lock);
+}
+
+static void bcache_wake_all() {
+    while (waiters) {
+        process_t *p = waiters;
+        waiters = p->wait_next;
+        p->wait_next = 0;
+        unblock_process(p);
+    }
+}
+
+// Take the least recently used unpinned buffer and rename it to 'blockno'.
+// Returns it pinned and not valid, or NULL if every buffer is pinned.
+static buf_t *bcache_recycle(blockdev_t *dev, uint32_t blockno) {
+    buf_t *b = lru_head;
+    if (!b) return 0;
+
+    lru_remove(b);
+    if (b->dev) hash_remove(b);
+    b->dev = dev;
+    b->blockno = blockno;
+    b->valid = 0;
+    b->loading = 0;
+    b->dirty = 0;
+    b->refcnt = 1;
+    hash_insert(b);
+    return b;
+}
+
+void bcache_init() {
+    irq_lock_init(&bcache_lock);
+
+    // 1. Size: a share of the memory that is free now, in whole pages
+    uint32_t count = pmm_free_count() / BCACHE_MEM_SHARE * BUFS_PER_PAGE;
+    if (count < BCACHE_MIN_BUFS) count = BCACHE_MIN_BUFS;
+    if (count > BCACHE_MAX_BUFS) count = BCACHE_MAX_BUFS;
+
+    // 2. Headers (contiguous, so the array can be indexed)
+    uint32_t header_pages = (count * sizeof(buf_t) + PMM_BLOCK_SIZE - 1) / PMM_BLOCK_SIZE;
+    uint32_t header_phys = pmm_alloc_blocks(header_pages, 1);
+    if (!header_phys || header_phys + header_pages * PMM_BLOCK_SIZE > KERNEL_DIRECT_MAP_SIZE) {
+        if (header_phys) pmm_free_blocks(header_phys, header_pages);
+        print_string("[BCACHE] Error: no memory, disk reads are uncached\n");
+        return;
+    }
+    bufs = (buf_t *)P2V(header_phys);
+    mutex_init(&flush_mutex);
+    flush_scratch = (uint8_t *)kmalloc(BCACHE_RA_MAX * BCACHE_BLOCK_SIZE); // NULL = one block per write
+
+    // 3. Data pages one at a time (need not be contiguous): stop early if
+    //    memory runs out or leaves the direct map
+    for (nbufs = 0; nbufs < count; nbufs += BUFS_PER_PAGE) {
+        uint32_t phys = pmm_alloc_block();
+        if (!phys) break;
+        if (phys >= KERNEL_DIRECT_MAP_SIZE) {
+            pmm_free_block(phys);
+            break;
+        }
+        for (uint32_t i = 0; i < BUFS_PER_PAGE; i++) {
+            buf_t *b = &bufs[nbufs + i];
+            b->dev = 0;
+            b->blockno = 0;
+            b->data = (uint8_t *)P2V(phys) + i * BCACHE_BLOCK_SIZE;
+            b->refcnt = 0;
+            b->valid = 0;
+            b->loading = 0;
+            b->dirty = 0;
+            b->hash_next = 0;
+            lru_push_tail(b);
+        }
+    }
+
+    print_string("[BCACHE] ");
+    print_dec(nbufs);
+    print_string(" buffers (");
+    print_dec(nbufs * BCACHE_BLOCK_SIZE / 1024);
+    print_string(" KB)\n");
+}
+
+// Shared body of bread / bget: a pinned buffer for 'blockno'. With 'read'
+// a miss is read from disk; without, the caller fills the buffer (it stays
+// 'loading' until bdirty).
+static buf_t *bcache_get(blockdev_t *dev, uint32_t blockno, int read) {
+    buf_t *b;
+
+    if (!nbufs) return 0;
+
+    irq_lock(&bcache_lock);
+    for (;;) {
+        b = hash_lookup(dev, blockno);
+        if (b) {
+            // 1. Cached (or being loaded): pin it so it can't be recycled
+            buf_pin(b);
+            while (b->loading) bcache_sleep();
+            if (b->valid) {
+                hits++;
+                irq_unlock(&bcache_lock);
+                return b;
+            }
+            // The load failed: try again ourselves
+            break;
+        }
+
+        // 2. Miss: recycle the oldest clean free buffer. If there is none,
+        //    write the dirty ones back (they become recyclable) or wait.
+        b = bcache_recycle(dev, blockno);
+        if (b) break;
+        if (ndirty) {
+            irq_unlock(&bcache_lock);
+            bcache_sync(0);
+            irq_lock(&bcache_lock);
+        } else {
+            bcache_sleep();
+        }
+    }
+    b->loading = 1;
+    if (!read) {
+        irq_unlock(&bcache_lock);
+        return b;
+    }
+    misses++;
+    irq_unlock(&bcache_lock);
+
+    // 3. Read without the lock (may sleep); others wanting the block wait
+    //    on 'loading'
+    int result = blockdev_read(dev, blockno, 1, b->data);
+
+    irq_lock(&bcache_lock);
+    b->loading = 0;
+    b->valid = (result == 0);
+    bcache_wake_all();
+    irq_unlock(&bcache_lock);
+
+    if (result != 0) {
+        brelse(b);
+        return 0;
+    }
+    return b;
+}
+
+buf_t *bread(blockdev_t *dev, uint32_t blockno) {
+    return bcache_get(dev, blockno, 1);
+}
+
+buf_t *bget(blockdev_t *dev, uint32_t blockno) {
+    buf_t *b = bcache_get(dev, blockno, 0);
+    if (b && !b->loading) {
+        // Cached and valid: claim it for the caller's update all the same
+        irq_lock(&bcache_lock);
+        b->loading = 1;
+        irq_unlock(&bcache_lock);
+    }
+    return b;
+}
+
+void bdirty(buf_t *b) {
+    irq_lock(&bcache_lock);
+    if (b->loading) {
+        // Filled by bget's caller: readers may have it now
+        b->loading = 0;
+        b->valid = 1;
+        bcache_wake_all();
+    }
+    if (!b->dirty) {
+        b->dirty = 1;
+        ndirty++;
+    }
+    // Too much unwritten data: don't wait for the next period
+    if (ndirty > nbufs / 4 && flusher_sleeping) {
+        flusher_sleeping = 0;
+        unblock_process(flusher);
+    }
+    irq_unlock(&bcache_lock);
+}
+
+void brelse(buf_t *b) {
+    irq_lock(&bcache_lock);
+    buf_unpin(b);
+    if (b->refcnt == 0 && waiters) bcache_wake_all();
+    irq_unlock(&bcache_lock);
+}
+
+int bcache_read(blockdev_t *dev, uint32_t blockno, uint32_t count, void *dst) {
+    uint8_t *out = (uint8_t *)dst;
+
+    if (!nbufs) return blockdev_read(dev, blockno, count, dst);
+
+    uint32_t i = 0;
+    while (i < count) {
+        // 1. Cached, or being loaded (e.g. by read-ahead): bread waits for
+        //    the load instead of reading the block a second time
+        irq_lock(&bcache_lock);
+        if (hash_lookup(dev, blockno + i)) {
+            irq_unlock(&bcache_lock);
+            buf_t *b = bread(dev, blockno + i);
+            if (!b) return -1;
+            memory_copy((char *)b->data, (char *)(out + i * BCACHE_BLOCK_SIZE), BCACHE_BLOCK_SIZE);
+            brelse(b);
+            i++;
+            continue;
+        }
+
+        // 2. Miss: claim the run up to the next cached block (hashed,
+        //    'loading', pinned by us) so that a writer's bget waits for our
+        //    read instead of racing it and being overwritten by stale data
+        uint32_t run = 0;
+        while (i + run < count && run < BCACHE_RA_MAX && !hash_lookup(dev, blockno + i + run)) {
+            buf_t *b = bcache_recycle(dev, blockno + i + run);
+            if (!b) break;
+            b->loading = 1;
+            run++;
+        }
+        if (run == 0) {
+            // Every clean buffer is pinned: bread writes back or waits
+            irq_unlock(&bcache_lock);
+            buf_t *b = bread(dev, blockno + i);
+            if (!b) return -1;
+            memory_copy((char *)b->data, (char *)(out + i * BCACHE_BLOCK_SIZE), BCACHE_BLOCK_SIZE);
+            brelse(b);
+            i++;
+            continue;
+        }
+        misses += run;
+        irq_unlock(&bcache_lock);
+
+        // 3. One multi-block read straight into the caller's buffer, then
+        //    publish (or drop) the claimed blocks. They are pinned, so the
+        //    pointers stay good after the lock is dropped.
+        uint8_t *src = out + i * BCACHE_BLOCK_SIZE;
+        int result = blockdev_read(dev, blockno + i, run, src);
+        for (uint32_t j = 0; j < run; j++) {
+            irq_lock(&bcache_lock);
+            buf_t *b = hash_lookup(dev, blockno + i + j);
+            irq_unlock(&bcache_lock);
+
+            if (result == 0) memory_copy((char *)(src + j * BCACHE_BLOCK_SIZE), (char *)b->data, BCACHE_BLOCK_SIZE);
+
+            irq_lock(&bcache_lock);
+            b->loading = 0;
+            b->valid = (result == 0);
+            buf_unpin(b);
+            irq_unlock(&bcache_lock);
+        }
+        irq_lock(&bcache_lock);
+        bcache_wake_all();
+        irq_unlock(&bcache_lock);
+        if (result != 0) return -1;
+        i += run;
+    }
+    return 0;
+}
+
+// Load the missing blocks of [blockno, blockno + count) into the cache.
+// Each run of missing blocks is claimed first (hashed, 'loading', pinned by
+// us) so readers wait for it, then fetched with one request into 'scratch'.
+static void bcache_prefetch(blockdev_t *dev, uint32_t blockno, uint32_t count, uint8_t *scratch) {
+    uint32_t i = 0;
+    while (i < count) {
+        // 1. Claim a run of blocks nobody has cached or is loading
+        irq_lock(&bcache_lock);
+        uint32_t run = 0;
+        while (i + run < count && run < BCACHE_RA_MAX && !hash_lookup(dev, blockno + i + run)) {
+            buf_t *b = bcache_recycle(dev, blockno + i + run);
+            if (!b) break;
+            b->loading = 1;
+            ra_run[run++] = b;
+        }
+        int cached = (run == 0 && hash_lookup(dev, blockno + i));
+        irq_unlock(&bcache_lock);
+
+        if (run == 0) {
+            if (!cached) return; // Every buffer is pinned: give up
+            i++;
+            continue;
+        }
+
+        // 2. Fetch it (sleeps; the claimed buffers stay pinned)
+        int result = blockdev_read(dev, blockno + i, run, scratch);
+        for (uint32_t j = 0; result == 0 && j < run; j++) {
+            memory_copy((char *)(scratch + j * BCACHE_BLOCK_SIZE), (char *)ra_run[j]->data, BCACHE_BLOCK_SIZE);
+        }
+
+        // 3. Publish (or drop) them and wake anyone waiting for one
+        irq_lock(&bcache_lock);
+        for (uint32_t j = 0; j < run; j++) {
+            buf_t *b = ra_run[j];
+            b->loading = 0;
+            b->valid = (result == 0);
+            buf_unpin(b);
+        }
+        if (result == 0) prefetched += run;
+        bcache_wake_all();
+        irq_unlock(&bcache_lock);
+
+        i += run;
+    }
+}
+
+// Read-ahead daemon: serves queued requests one after the other, so the
+// disk works on the next blocks while the reader consumes the current ones
+static void bcache_readahead_thread() {
+    irq_lock(&bcache_lock);
+    ra_daemon = current_process;
+    irq_unlock(&bcache_lock);
+
+    for (;;) {
+        irq_lock(&bcache_lock);
+        while (ra_head == ra_tail) {
+            ra_daemon_sleeping = 1;
+            irq_lock_sleep(&bcache_lock);
+        }
+        ra_daemon_sleeping = 0;
+        ra_request_t req = ra_queue[ra_head % BCACHE_RA_QUEUE];
+        ra_head++;
+        irq_unlock(&bcache_lock);
+
+        bcache_prefetch(req.dev, req.blockno, req.count, ra_scratch);
+    }
+}
+
+int bcache_sync(blockdev_t *dev) {
+    int result = 0;
+    uint32_t max_run = flush_scratch ? BCACHE_RA_MAX : 1;
+
+    if (!nbufs) return 0;
+    mutex_lock(&flush_mutex);
+
+    for (uint32_t i = 0; i < nbufs; i++) {
+        // 1. A dirty buffer and the dirty blocks right after it: pin them and
+        //    mark them clean (anyone changing them again re-dirties them)
+        irq_lock(&bcache_lock);
+        buf_t *first = &bufs[i];
+        if (!first->dirty || first->loading || (dev && first->dev != dev)) {
+            irq_unlock(&bcache_lock);
+            continue;
+        }
+        blockdev_t *bdev = first->dev;
+        uint32_t blockno = first->blockno;
+        uint32_t run = 0;
+        while (run < max_run) {
+            buf_t *b = run == 0 ? first : hash_lookup(bdev, blockno + run);
+            if (!b || !b->dirty || b->loading) break;
+            buf_pin(b);
+            b->dirty = 0;
+            ndirty--;
+            flush_run[run++] = b;
+        }
+        irq_unlock(&bcache_lock);
+
+        // 2. One write for the whole run
+        int err;
+        if (run == 1) {
+            err = blockdev_write(bdev, blockno, 1, first->data);
+        } else {
+            for (uint32_t j = 0; j < run; j++) {
+                buf_t *b = flush_run[j];
+                memory_copy((char *)b->data, (char *)(flush_scratch + j * BCACHE_BLOCK_SIZE), BCACHE_BLOCK_SIZE);
+            }
+            err = blockdev_write(bdev, blockno, run, flush_scratch);
+        }
+
+        // 3. Unpin (failed writes stay dirty for the next attempt)
+        irq_lock(&bcache_lock);
+        for (uint32_t j = 0; j < run; j++) {
+            buf_t *b = flush_run[j];
+            if (err && !b->dirty) {
+                b->dirty = 1;
+                ndirty++;
+            }
+            buf_unpin(b);
+        }
+        if (err) result = -1;
+        else written += run;
+        bcache_wake_all();
+        irq_unlock(&bcache_lock);
+    }
+
+    mutex_unlock(&flush_mutex);
+    return result;
+}
+
+// Flusher: sleeps until bcache_timer_tick (or bdirty under pressure) wakes it
+static void bcache_flusher_thread() {
+    irq_lock(&bcache_lock);
+    flusher = current_process;
+    irq_unlock(&bcache_lock);
+
+    for (;;) {
+        irq_lock(&bcache_lock);
+        flusher_sleeping = 1;
+        while (flusher_sleeping) irq_lock_sleep(&bcache_lock);
+        irq_unlock(&bcache_lock);
+
+        bcache_sync(0);
+    }
+}
+
+void bcache_timer_tick() {
+    extern uint32_t tick, timer_hz;
+
+    // Unlocked peek: nothing to do most of the time
+    if (!flusher_sleeping || !ndirty) return;
+    if (tick - last_flush_tick < BCACHE_FLUSH_SECONDS * timer_hz) return;
+
+    irq_lock(&bcache_lock);
+    if (flusher_sleeping) {
+        flusher_sleeping = 0;
+        last_flush_tick = tick;
+        unblock_process(flusher);
+    }
+    irq_unlock(&bcache_lock);
+}
+
+void bcache_start_threads() {
+    if (!nbufs || ra_started) return;
+
+    create_task(bcache_flusher_thread);
+
+    ra_scratch = (uint8_t *)kmalloc(BCACHE_RA_MAX * BCACHE_BLOCK_SIZE);
+    if (!ra_scratch) return;
+
+    ra_started = 1;
+    create_task(bcache_readahead_thread);
+}
+
+void bcache_readahead(blockdev_t *dev, uint32_t blockno, uint32_t count) {
+    if (!ra_started || count == 0) return;
+
+    // Never let read-ahead push out more than a quarter of the cache
+    uint32_t max = nbufs / 4 < BCACHE_RA_MAX ? nbufs / 4 : BCACHE_RA_MAX;
+
+    irq_lock(&bcache_lock);
+    while (count > 0 && ra_tail - ra_head < BCACHE_RA_QUEUE) {
+        uint32_t n = count < max ? count : max;
+        ra_queue[ra_tail % BCACHE_RA_QUEUE] = (ra_request_t){ dev, blockno, n };
+        ra_tail++;
+        blockno += n;
+        count -= n;
+    }
+    // Queue full: the rest is dropped (read-ahead is only a hint)
+    if (ra_daemon_sleeping) {
+        ra_daemon_sleeping = 0;
+        unblock_process(ra_daemon);
+    }
+    irq_unlock(&bcache_lock);
+}
+
+void bcache_print_stats() {
+    print_string("Buffer cache: ");
+    print_dec(nbufs);
+    print_string(" buffers, ");
+    print_dec(hits);
+    print_string(" hits, ");
+    print_dec(misses);
+    print_string(" misses, ");
+    print_dec(prefetched);
+    print_string(" read ahead, ");
+    print_dec(written);
+    print_string(" written, ");
+    print_dec(ndirty);
+    print_string(" dirty\n");
+}
@@ -0,0 +1,75 @@
+#ifndef BCACHE_H
+#define BCACHE_H
+
+#include <stdint.h>
+#include "../drivers/blockdev.h"
+
+// ---------------------------------------------------------
+// Block Buffer Cache
+// ---------------------------------------------------------
+// One 512-byte buffer per cached disk block, found through a hash table on
+// (device, block number). Buffers nobody holds sit on an LRU list and are
+// recycled least recently used first. bread() pins a buffer (reference
+// count) so it can't be recycled while the caller looks at it.
+// The number of buffers is chosen at boot from free physical memory.
+#define BCACHE_BLOCK_SIZE 512
+#define BCACHE_HASH_SIZE  1024         // Buckets (power of two)
+#define BCACHE_MEM_SHARE  8            // Use 1/8 of free memory...
+#define BCACHE_MIN_BUFS   64
+#define BCACHE_MAX_BUFS   16384        // ...but at most 8MB of buffers
+#define BCACHE_RA_MAX     128          // Blocks per read-ahead request (64KB)
+#define BCACHE_RA_QUEUE   16           // Read-ahead requests waiting for the daemon
+#define BCACHE_FLUSH_SECONDS 5         // Dirty buffers are written back at least this often
+
+typedef struct buf {
+    blockdev_t *dev;
+    uint32_t blockno;
+    uint8_t *data;                     // BCACHE_BLOCK_SIZE bytes
+    int refcnt;                        // Pins (bread without brelse)
+    int valid;                         // data holds the block
+    int loading;                       // A reader is fetching it from disk (or a bget caller filling it)
+    int dirty;                         // Modified, not written back yet
+    struct buf *hash_next;
+    struct buf *lru_prev, *lru_next;   // On the LRU list while refcnt == 0 and clean
+} buf_t;
+
+// Allocate the buffers (after pmm_init / kheap_init)
+void bcache_init();
+
+// Pinned, valid buffer for 'blockno', read from disk on a miss. NULL on I/O
+// error. Release with brelse(). Never call with a cache lock held.
+buf_t *bread(blockdev_t *dev, uint32_t blockno);
+void brelse(buf_t *b);
+
+// Writing (write-back): change a pinned buffer, then bdirty() it. It is
+// written to disk later by the flusher thread, bcache_sync, or when the
+// cache runs out of clean buffers.
+// bget() is bread() for a block about to be overwritten: on a miss nothing
+// is read and the caller must fill all of b->data. Readers of the block
+// wait until the bdirty().
+buf_t *bget(blockdev_t *dev, uint32_t blockno);
+void bdirty(buf_t *b);
+
+// Write back every dirty buffer of 'dev' (NULL = all), merging consecutive
+// blocks into one request. 0, or -1 if a write failed (those stay dirty).
+int bcache_sync(blockdev_t *dev);
+
+// Read 'count' consecutive blocks into 'dst': cached blocks are copied, the
+// missing runs are claimed in the cache and fetched with one multi-block
+// request each. Returns 0 or -1.
+int bcache_read(blockdev_t *dev, uint32_t blockno, uint32_t count, void *dst);
+
+// Asynchronous read-ahead: queue [blockno, blockno + count) for the read-ahead
+// daemon and return at once. Blocks it is still loading are waited for by
+// bread/bcache_read rather than read twice. A no-op until the daemon runs.
+void bcache_readahead(blockdev_t *dev, uint32_t blockno, uint32_t count);
+
+// Start the read-ahead daemon and the flusher (needs multitasking, see kernel_main)
+void bcache_start_threads();
+
+// Timer interrupt: wake the flusher every BCACHE_FLUSH_SECONDS
+void bcache_timer_tick();
+
+void bcache_print_stats();
+
+#endif
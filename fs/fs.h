@@ -15,6 +15,12 @@
 // We know it's formatted with SimpleFS.
 #define SIMPLEFS_MAGIC 0x12345678
 
+// On-disk format version (superblock 'version').
+// 0 = the original 48 direct block pointers per inode (24KB per file)
+// 2 = extents, see sfs_inode
+// 3 = plus the free block bitmap (writable)
+#define SIMPLEFS_VERSION 3
+
 // 2. Block Size
 // We align with the standard sector size (512 bytes) for simplicity.
 #define PROJ_BLOCK_SIZE 512
@@ -35,21 +41,42 @@ typedef struct {
     uint32_t inode_table_block; // Which block does the inode table start?
     uint32_t data_block_start;  // Which block does the data area start?
     uint32_t num_inodes;        // How many inodes (files) can we store?
-    uint8_t  padding[488];      // Pad to 512 bytes (Block Size)
+    uint32_t version;           // On-disk format (SIMPLEFS_VERSION)
+    uint32_t block_bitmap_block;  // First block of the data block usage bitmap (1 bit per block)
+    uint32_t block_bitmap_blocks; // Its length in blocks
+    uint8_t  padding[476];      // Pad to 512 bytes (Block Size)
 } __attribute__((packed)) sfs_superblock;
 
+/*
+ * [Extent]
+ * A run of 'length' consecutive blocks starting at block 'start'.
+ * A contiguous file needs a single extent, however big it is, and is read
+ * with a few large multi-sector requests.
+ */
+typedef struct {
+    uint32_t start;
+    uint32_t length;            // 0 = unused (ends the extent list)
+} __attribute__((packed)) sfs_extent;
+
+#define SFS_INODE_EXTENTS    26 // In the inode itself
+#define SFS_OVERFLOW_EXTENTS (PROJ_BLOCK_SIZE / sizeof(sfs_extent)) // 64 more in the overflow block
+
 /*
  * [Inode] (Index Node)
  * Represents a single file.
  * In a real FS, filenames are in "Directory Entries", but for simplicity,
  * we store the filename directly here.
+ * The file's blocks are the extents in order: first the ones in the inode,
+ * then (if overflow_block != 0) the ones in the overflow block.
+ * The bootloader reads 'size' and extents[0].start (offsets 33 and 37).
  */
 typedef struct {
     uint8_t  used;                    // 1 if this inode is in use, 0 if free
     char     filename[FILENAME_MAX_LEN]; // Name of the file (e.g., "kernel.bin")
     uint32_t size;                    // Size of the file in bytes
-    uint32_t blocks[48];              // Direct pointers to data blocks (48 * 512 = 24KB max)
-    uint8_t  padding[27];             // Pad to 256 bytes (1+32+4+192+27 = 256)
+    sfs_extent extents[SFS_INODE_EXTENTS]; // Data block runs
+    uint32_t overflow_block;          // Block of SFS_OVERFLOW_EXTENTS more extents (0 = none)
+    uint8_t  padding[7];              // Pad to 256 bytes (1+32+4+208+4+7 = 256)
 } __attribute__((packed)) sfs_inode;
 
 #endif
@@ -1,6 +1,9 @@
 #include "fs.h"
-#include "../drivers/ata.h"
+#include "simplefs.h"
+#include "bcache.h"
+#include "../drivers/blockdev.h"
 #include "../mm/kheap.h"
+#include "../kernel/sync.h"
 
 // Debug functions
 extern void print_string(char* str);
@@ -8,10 +11,29 @@ extern void print_hex(uint32_t n);
 extern void print_hex(uint32_t n);
 extern void print_dec(uint32_t n);
 extern void memory_copy(char *source, char *dest, int nbytes);
+extern void memset(void *dest, int val, int len);
 
 // Global Superblock
 sfs_superblock sb;
 
+// The disk we mounted (NULL = not mounted)
+static blockdev_t *fs_dev = 0;
+
+// In-memory inode cache: the whole inode table, loaded at mount and kept in
+// sync by fs_icache_invalidate. Used inodes are chained into a filename hash
+// (SimpleFS is flat, so one table serves the only directory).
+typedef struct {
+    sfs_inode disk;       // Copy of the on-disk inode
+    int hash_next;        // Next inode in the same name bucket (-1 = end)
+} fs_icache_entry;
+
+static fs_icache_entry *icache = 0;
+static int name_hash[FS_NAME_HASH_SIZE];  // First inode of each bucket (-1 = empty)
+static irq_lock_t icache_lock;            // Protects icache and name_hash
+
+static int fs_icache_load();
+static int fs_bitmaps_load();
+
 // String Compare Helper
 static int strcmp(char *s1, char *s2) {
     while (*s1 && (*s1 == *s2)) {
@@ -26,97 +48,743 @@ void fs_init() {
     
     // 1. Read Superblock (Sector 17)
     // Why 17? MBR(1) + Reserved(16)
+    // Disks are tried in probe order (fastest driver first): mount the first
+    // one that holds a SimpleFS.
     uint8_t buffer[512];
-    ata_read_sector(17, buffer);
-    
     sfs_superblock *read_sb = (sfs_superblock*)buffer;
+
+    for (int i = 0; i < blockdev_count(); i++) {
+        blockdev_t *dev = blockdev_get(i);
+        read_sb->magic = 0;
+        if (blockdev_read(dev, 17, 1, buffer) == 0 && read_sb->magic == SIMPLEFS_MAGIC) {
+            fs_dev = dev;
+            break;
+        }
+    }
     
-    if (read_sb->magic != SIMPLEFS_MAGIC) {
-        print_string("[FS] Error: Invalid Magic Number! Found: ");
+    if (!fs_dev) {
+        print_string("[FS] Error: No disk with a valid Magic Number! Last found: ");
         print_hex(read_sb->magic);
         print_string("\n");
         return;
     }
     
+    if (read_sb->version != SIMPLEFS_VERSION) {
+        print_string("[FS] Error: Unsupported format version ");
+        print_dec(read_sb->version);
+        print_string(" (rebuild disk.img with tools/mkfs)\n");
+        fs_dev = 0;
+        return;
+    }
+
     // Copy to global
     sb = *read_sb;
+
+    // Everything after the superblock goes through the buffer cache
+    bcache_init();
+
+    if (fs_icache_load() != 0) {
+        print_string("[FS] Error: Can't load the inode table\n");
+        fs_dev = 0;
+        return;
+    }
+
+    // Without the bitmaps the file system is still readable
+    if (fs_bitmaps_load() != 0) {
+        print_string("[FS] Error: Can't load the bitmaps, mounting read-only\n");
+    }
     print_string("[FS] Mount Success! Total Blocks: ");
     print_dec(sb.total_blocks);
-    print_string("\n");
+    print_string(" (");
+    print_string(fs_dev->name);
+    print_string(")\n");
+}
+
+#define INODES_PER_BLOCK (512 / sizeof(sfs_inode))
+
+static uint32_t fs_inode_blocks() {
+    return (sb.num_inodes + INODES_PER_BLOCK - 1) / INODES_PER_BLOCK;
+}
+
+// FNV-1a over the filename
+static uint32_t fs_name_hash(char *name) {
+    uint32_t h = 2166136261u;
+    while (*name) {
+        h ^= (uint8_t)*name++;
+        h *= 16777619u;
+    }
+    return h & (FS_NAME_HASH_SIZE - 1);
+}
+
+static void icache_hash_insert(uint32_t ino) {
+    uint32_t h = fs_name_hash(icache[ino].disk.filename);
+    icache[ino].hash_next = name_hash[h];
+    name_hash[h] = ino;
+}
+
+static void icache_hash_remove(uint32_t ino) {
+    int *pp = &name_hash[fs_name_hash(icache[ino].disk.filename)];
+    while (*pp != -1 && *pp != (int)ino) pp = &icache[*pp].hash_next;
+    if (*pp != -1) *pp = icache[ino].hash_next;
+    icache[ino].hash_next = -1;
+}
+
+// Load the whole inode table into the inode cache (at mount)
+static int fs_icache_load() {
+    irq_lock_init(&icache_lock);
+    for (int i = 0; i < FS_NAME_HASH_SIZE; i++) name_hash[i] = -1;
+
+    icache = (fs_icache_entry *)kmalloc(sb.num_inodes * sizeof(fs_icache_entry));
+    if (!icache) return -1;
+
+    for (uint32_t blk = 0; blk < fs_inode_blocks(); blk++) {
+        buf_t *b = bread(fs_dev, sb.inode_table_block + blk);
+        if (!b) {
+            kfree(icache);
+            icache = 0;
+            return -1;
+        }
+        for (uint32_t i = 0; i < INODES_PER_BLOCK; i++) {
+            uint32_t ino = blk * INODES_PER_BLOCK + i;
+            if (ino >= sb.num_inodes) break;
+            memory_copy((char *)(b->data + i * sizeof(sfs_inode)), (char *)&icache[ino].disk, sizeof(sfs_inode));
+            icache[ino].hash_next = -1;
+            if (icache[ino].disk.used == 1) icache_hash_insert(ino);
+        }
+        brelse(b);
+    }
+    return 0;
+}
+
+void fs_icache_invalidate(uint32_t ino) {
+    if (!icache || ino >= sb.num_inodes) return;
+
+    // 1. Fresh copy from disk (through the buffer cache, may sleep)
+    sfs_inode fresh;
+    buf_t *b = bread(fs_dev, sb.inode_table_block + ino / INODES_PER_BLOCK);
+    if (!b) return;
+    memory_copy((char *)(b->data + (ino % INODES_PER_BLOCK) * sizeof(sfs_inode)), (char *)&fresh, sizeof(sfs_inode));
+    brelse(b);
+
+    // 2. Swap it in and re-index the name
+    irq_lock(&icache_lock);
+    if (icache[ino].disk.used == 1) icache_hash_remove(ino);
+    memory_copy((char *)&fresh, (char *)&icache[ino].disk, sizeof(sfs_inode));
+    if (icache[ino].disk.used == 1) icache_hash_insert(ino);
+    irq_unlock(&icache_lock);
 }
 
 // Find a file by name and return its Inode
 // Returns 1 on success, 0 on failure
+// One hash bucket of the in-memory inode cache is searched: no disk access
+// and no scan of the whole table.
 int fs_find_file(char *filename, sfs_inode *out_inode) {
-    uint8_t buffer[512];
-    
-    // Loop through all inodes
-    // Inodes are stored starting at sb.inode_table_block
-    // Each block contains 512 / sizeof(sfs_inode) inodes.
-    // Simplifying: Just read sector by sector and check all inodes in it.
-    
-    uint32_t inodes_per_block = 512 / sizeof(sfs_inode);
-    uint32_t total_inode_blocks = (sb.num_inodes + inodes_per_block - 1) / inodes_per_block;
-    // print_dec(inodes_per_block); //2
-    // print_string("\n");
-    // print_dec(total_inode_blocks);//8
-    // print_string("\n");
-    // while(1);
-    for (uint32_t i = 0; i < total_inode_blocks; i++) {
-        ata_read_sector(sb.inode_table_block + i, buffer);
-        // Iterate through all inodes in this block
-        for (uint32_t j = 0; j < inodes_per_block; j++) {
-            sfs_inode *current_inode = (sfs_inode *)(buffer + j * sizeof(sfs_inode));
-            // Check bounds (optional but good practice if total inodes is strict)
-            // But checking 'used' flag is sufficient usually
-            
-            if (current_inode->used == 1) {
-
-                if (strcmp(filename, current_inode->filename) == 0) {
-                    // Found! Copy to output
-                    // Use explicit memory_copy to avoid compiler emitting memcpy/struct copy issues
-                    // *out_inode = *current_inode; 
-                    memory_copy((char*)current_inode, (char*)out_inode, sizeof(sfs_inode));
-                    return 1;
-                }
-            }
+    if (!icache) return 0;
+
+    irq_lock(&icache_lock);
+    for (int ino = name_hash[fs_name_hash(filename)]; ino != -1; ino = icache[ino].hash_next) {
+        if (strcmp(filename, icache[ino].disk.filename) == 0) {
+            // Found! Copy to output
+            // Use explicit memory_copy to avoid compiler emitting memcpy/struct copy issues
+            // *out_inode = *current_inode; 
+            memory_copy((char*)&icache[ino].disk, (char*)out_inode, sizeof(sfs_inode));
+            irq_unlock(&icache_lock);
+            return 1;
         }
     }
-    
+    irq_unlock(&icache_lock);
+
     return 0; // Not Found
 }
 
 // List all files in the root directory
 void fs_list_files() {
     print_string("--- File List ---\n");
-    uint8_t buffer[512];
-    uint32_t inodes_per_block = 512 / sizeof(sfs_inode);
-    uint32_t total_inode_blocks = (sb.num_inodes + inodes_per_block - 1) / inodes_per_block;
-    for (uint32_t i = 0; i < total_inode_blocks; i++) {
-        ata_read_sector(sb.inode_table_block + i, buffer);
-        
-        for (uint32_t j = 0; j < inodes_per_block; j++) {
-            sfs_inode *current_inode = (sfs_inode *)(buffer + j * sizeof(sfs_inode));
-            
-            if (current_inode->used == 1) {
-                print_string("  - ");
-                print_string(current_inode->filename);
-                print_string(" (");
-                print_dec(current_inode->size);
-                print_string(" bytes)\n");
-            }
+    for (uint32_t ino = 0; icache && ino < sb.num_inodes; ino++) {
+        sfs_inode current_inode;
+        irq_lock(&icache_lock);
+        memory_copy((char *)&icache[ino].disk, (char *)&current_inode, sizeof(sfs_inode));
+        irq_unlock(&icache_lock);
+
+        if (current_inode.used == 1) {
+            print_string("  - ");
+            print_string(current_inode.filename);
+            print_string(" (");
+            print_dec(current_inode.size);
+            print_string(" bytes)\n");
         }
     }
     print_string("-----------------\n");
+    bcache_print_stats();
+}
+
+// Map file block 'fblock' to its disk block. *run = how many blocks from
+// there on (at most 'max') are contiguous on disk. Returns 0 if 'fblock' is
+// past the last extent or the overflow block can't be read.
+static uint32_t fs_bmap(sfs_inode *inode, uint32_t fblock, uint32_t max, uint32_t *run) {
+    // 1. Extents in the inode
+    for (int i = 0; i < SFS_INODE_EXTENTS && inode->extents[i].length; i++) {
+        sfs_extent *e = &inode->extents[i];
+        if (fblock < e->length) {
+            *run = e->length - fblock < max ? e->length - fblock : max;
+            return e->start + fblock;
+        }
+        fblock -= e->length;
+    }
+    if (!inode->overflow_block) return 0;
+
+    // 2. Extents in the overflow block (buffer cache hit after the first use)
+    buf_t *b = bread(fs_dev, inode->overflow_block);
+    if (!b) return 0;
+    sfs_extent *ext = (sfs_extent *)b->data;
+    uint32_t block = 0;
+    for (uint32_t i = 0; i < SFS_OVERFLOW_EXTENTS && ext[i].length; i++) {
+        if (fblock < ext[i].length) {
+            *run = ext[i].length - fblock < max ? ext[i].length - fblock : max;
+            block = ext[i].start + fblock;
+            break;
+        }
+        fblock -= ext[i].length;
+    }
+    brelse(b);
+    return block;
+}
+
+// Queue file blocks [from, from + count) for the read-ahead daemon (skipping
+// what is already queued), one request per contiguous run
+static void fs_readahead(sfs_file_t *file, uint32_t from, uint32_t count) {
+    uint32_t total = (file->inode.size + 511) / 512;
+    uint32_t end = from + count < total ? from + count : total;
+    if (from < file->ra_end) from = file->ra_end;
+
+    while (from < end) {
+        uint32_t run;
+        uint32_t block = fs_bmap(&file->inode, from, end - from, &run);
+        if (!block) break;
+        bcache_readahead(fs_dev, block, run);
+        from += run;
+    }
+    if (end > file->ra_end) file->ra_end = end;
+}
+
+// Read file blocks [first, first + count) into buffer.
+// A read that starts where the previous one ended is sequential: the
+// read-ahead window doubles (up to FS_RA_MAX_BLOCKS) and the next window is
+// queued for the daemon before we wait for the current chunk, so the disk
+// is always working one window ahead of the reader. Anything else resets
+// the window (random access gets no read-ahead).
+static int fs_read_blocks(sfs_file_t *file, uint32_t first, uint32_t count, uint8_t *buffer) {
+    if (first == file->next_block) {
+        if (file->ra_window == 0) file->ra_window = FS_RA_MIN_BLOCKS;
+    } else {
+        file->ra_window = 0;
+        file->ra_end = 0;
+    }
+
+    while (count > 0) {
+        // 1. Chunk: one window at a time when sequential
+        uint32_t chunk = count;
+        if (file->ra_window && chunk > file->ra_window) chunk = file->ra_window;
+
+        // 2. Start fetching the window after this chunk
+        if (file->ra_window) fs_readahead(file, first + chunk, file->ra_window);
+
+        // 3. This chunk: one cache request per contiguous run
+        for (uint32_t i = 0; i < chunk; ) {
+            uint32_t run;
+            uint32_t block = fs_bmap(&file->inode, first + i, chunk - i, &run);
+            if (!block || bcache_read(fs_dev, block, run, buffer + i * 512) != 0) return -1;
+            i += run;
+        }
+
+        first += chunk;
+        count -= chunk;
+        buffer += chunk * 512;
+        file->next_block = first;
+        if (file->ra_window && file->ra_window < FS_RA_MAX_BLOCKS) file->ra_window *= 2;
+    }
+    return 0;
+}
+
+int fs_open(char *filename, sfs_file_t *file) {
+    if (!fs_find_file(filename, &file->inode)) return 0;
+    file->next_block = 0;
+    file->ra_end = 0;
+    file->ra_window = 0;
+    return 1;
 }
 
-// Read file content into buffer
+// Read up to 'size' bytes at 'offset'. Whole blocks go straight into the
+// caller's buffer, a partial first/last block through the buffer cache.
+// Returns the number of bytes read (0 at end of file) or -1.
+int fs_read(sfs_file_t *file, uint32_t offset, uint32_t size, char *buffer) {
+    if (offset >= file->inode.size) return 0;
+    if (size > file->inode.size - offset) size = file->inode.size - offset;
+
+    uint32_t done = 0;
+    while (done < size) {
+        uint32_t pos = offset + done;
+        uint32_t block = pos / 512;
+        uint32_t in_block = pos % 512;
+        uint32_t whole = (size - done) / 512;
+
+        if (in_block == 0 && whole > 0) {
+            if (fs_read_blocks(file, block, whole, (uint8_t *)buffer + done) != 0) return -1;
+            done += whole * 512;
+            continue;
+        }
+
+        // Partial block
+        uint32_t run;
+        uint32_t disk_block = fs_bmap(&file->inode, block, 1, &run);
+        buf_t *b = disk_block ? bread(fs_dev, disk_block) : 0;
+        if (!b) return -1;
+        uint32_t n = 512 - in_block;
+        if (n > size - done) n = size - done;
+        memory_copy((char *)b->data + in_block, buffer + done, n);
+        brelse(b);
+        done += n;
+        file->next_block = block + 1;
+    }
+    return done;
+}
+
+// Read file content into buffer (rounded up to whole blocks)
+// Goes through fs_read_blocks, so big files (ELF loads) get read-ahead.
 void fs_read_file(sfs_inode *inode, char *buffer) {
-    uint32_t needed_blocks = (inode->size + 511) / 512;
-    
-    for (uint32_t i = 0; i < needed_blocks; i++) {
-        // Read each block
-        // Note: buffer pointer arithmetic needs care.
-        ata_read_sector(inode->blocks[i], (uint8_t*)(buffer + i * 512));
+    sfs_file_t file;
+    memory_copy((char *)inode, (char *)&file.inode, sizeof(sfs_inode));
+    file.next_block = 0;
+    file.ra_end = 0;
+    file.ra_window = 0;
+
+    fs_read_blocks(&file, 0, (inode->size + 511) / 512, (uint8_t *)buffer);
+}
+
+// ---------------------------------------------------------
+// Writing
+// ---------------------------------------------------------
+// All updates (data, inodes, bitmaps) go through the buffer cache and are
+// written back later by its flusher (or fs_sync). The bitmaps are also kept
+// in memory for allocation. One mutex serialises writers; readers only see
+// an inode once fs_write_inode has put it in the inode cache.
+
+#define SFS_MAX_EXTENTS   (SFS_INODE_EXTENTS + SFS_OVERFLOW_EXTENTS)
+#define BITS_PER_BLOCK    (PROJ_BLOCK_SIZE * 8)
+
+static mutex_t fs_write_mutex;
+static uint8_t inode_bitmap[PROJ_BLOCK_SIZE]; // One block: up to 4096 inodes
+static uint8_t *block_bitmap = 0;             // sb.block_bitmap_blocks blocks
+
+static inline int bitmap_test(uint8_t *map, uint32_t bit) {
+    return map[bit / 8] & (1 << (bit % 8));
+}
+
+// Load both bitmaps (at mount)
+static int fs_bitmaps_load() {
+    mutex_init(&fs_write_mutex);
+
+    block_bitmap = (uint8_t *)kmalloc(sb.block_bitmap_blocks * PROJ_BLOCK_SIZE);
+    if (!block_bitmap) return -1;
+
+    if (bcache_read(fs_dev, sb.inode_bitmap_block, 1, inode_bitmap) != 0 ||
+        bcache_read(fs_dev, sb.block_bitmap_block, sb.block_bitmap_blocks, block_bitmap) != 0) {
+        kfree(block_bitmap);
+        block_bitmap = 0;
+        return -1;
+    }
+    return 0;
+}
+
+// Set bits [first, first + count) of 'map' to 'used' and copy the changed
+// bitmap blocks (starting at disk block 'disk_block') into the cache
+static void fs_bitmap_set(uint8_t *map, uint32_t disk_block, uint32_t first, uint32_t count, int used) {
+    if (count == 0) return;
+    for (uint32_t bit = first; bit < first + count; bit++) {
+        if (used) map[bit / 8] |= 1 << (bit % 8);
+        else map[bit / 8] &= ~(1 << (bit % 8));
+    }
+
+    for (uint32_t blk = first / BITS_PER_BLOCK; blk <= (first + count - 1) / BITS_PER_BLOCK; blk++) {
+        buf_t *b = bget(fs_dev, disk_block + blk);
+        if (!b) continue;
+        memory_copy((char *)(map + blk * PROJ_BLOCK_SIZE), (char *)b->data, PROJ_BLOCK_SIZE);
+        bdirty(b);
+        brelse(b);
     }
 }
+
+// Free blocks from 'start' on (at most 'max')
+static uint32_t fs_free_run(uint32_t start, uint32_t max) {
+    uint32_t run = 0;
+    while (run < max && start + run < sb.total_blocks && !bitmap_test(block_bitmap, start + run)) run++;
+    return run;
+}
+
+// Allocate a run of up to 'want' blocks. Contiguous files first: right after
+// 'goal' (the file's last block + 1) if that is free, else the first free
+// run of 'want' blocks, else the longest free run there is.
+// Returns its first block (*got = its length), or 0 if the disk is full.
+static uint32_t fs_alloc_blocks(uint32_t goal, uint32_t want, uint32_t *got) {
+    uint32_t start = 0, len = 0;
+
+    if (goal >= sb.data_block_start && goal < sb.total_blocks && !bitmap_test(block_bitmap, goal)) {
+        start = goal;
+        len = fs_free_run(goal, want);
+    }
+
+    for (uint32_t b = sb.data_block_start; !start && b < sb.total_blocks; ) {
+        if (bitmap_test(block_bitmap, b)) {
+            b++;
+            continue;
+        }
+        uint32_t run = fs_free_run(b, want);
+        if (run == want) {
+            start = b;
+            len = run;
+        } else if (run > len) {
+            goal = b; // Longest so far
+            len = run;
+        }
+        b += run;
+    }
+    if (!start && len) start = goal;
+    if (!start) return 0;
+
+    fs_bitmap_set(block_bitmap, sb.block_bitmap_block, start, len, 1);
+    *got = len;
+    return start;
+}
+
+static void fs_free_blocks(uint32_t start, uint32_t count) {
+    fs_bitmap_set(block_bitmap, sb.block_bitmap_block, start, count, 0);
+}
+
+// All extents of 'inode' into ext[SFS_MAX_EXTENTS]. Returns how many, or -1.
+static int fs_extents_load(sfs_inode *inode, sfs_extent *ext) {
+    int n = 0;
+    while (n < SFS_INODE_EXTENTS && inode->extents[n].length) {
+        ext[n] = inode->extents[n];
+        n++;
+    }
+    if (n < SFS_INODE_EXTENTS || !inode->overflow_block) return n;
+
+    buf_t *b = bread(fs_dev, inode->overflow_block);
+    if (!b) return -1;
+    sfs_extent *more = (sfs_extent *)b->data;
+    for (uint32_t i = 0; i < SFS_OVERFLOW_EXTENTS && more[i].length; i++) ext[n++] = more[i];
+    brelse(b);
+    return n;
+}
+
+// Put ext[0..n) back into 'inode', allocating an overflow block if it needs
+// one. An overflow block it no longer needs is dropped from the inode but not
+// freed: the caller does that once the inode is on its way to disk.
+static int fs_extents_store(sfs_inode *inode, sfs_extent *ext, int n) {
+    for (int i = 0; i < SFS_INODE_EXTENTS; i++) {
+        if (i < n) inode->extents[i] = ext[i];
+        else inode->extents[i].start = inode->extents[i].length = 0;
+    }
+
+    if (n <= SFS_INODE_EXTENTS) {
+        inode->overflow_block = 0;
+        return 0;
+    }
+
+    if (!inode->overflow_block) {
+        uint32_t got;
+        inode->overflow_block = fs_alloc_blocks(0, 1, &got);
+        if (!inode->overflow_block) return -1;
+    }
+    buf_t *b = bget(fs_dev, inode->overflow_block);
+    if (!b) return -1;
+    memset(b->data, 0, PROJ_BLOCK_SIZE);
+    memory_copy((char *)(ext + SFS_INODE_EXTENTS), (char *)b->data, (n - SFS_INODE_EXTENTS) * sizeof(sfs_extent));
+    bdirty(b);
+    brelse(b);
+    return 0;
+}
+
+// fs_bmap over a loaded extent list
+static uint32_t fs_ext_map(sfs_extent *ext, int n, uint32_t fblock) {
+    for (int i = 0; i < n; i++) {
+        if (fblock < ext[i].length) return ext[i].start + fblock;
+        fblock -= ext[i].length;
+    }
+    return 0;
+}
+
+// Give the file 'blocks' blocks in total (it has 'have'). New blocks extend
+// the last extent whenever the allocator finds them right behind it.
+static int fs_grow(sfs_extent *ext, int *n, uint32_t have, uint32_t blocks) {
+    while (have < blocks) {
+        uint32_t goal = *n ? ext[*n - 1].start + ext[*n - 1].length : 0;
+        uint32_t got;
+        uint32_t start = fs_alloc_blocks(goal, blocks - have, &got);
+        if (!start) return -1;
+
+        if (*n && start == goal) {
+            ext[*n - 1].length += got;
+        } else if (*n == SFS_MAX_EXTENTS) {
+            fs_free_blocks(start, got); // Too fragmented
+            return -1;
+        } else {
+            ext[*n].start = start;
+            ext[*n].length = got;
+            (*n)++;
+        }
+        have += got;
+    }
+    return 0;
+}
+
+// Keep the first 'blocks' blocks of the file, drop the rest from the list
+// (and free them in the bitmap if 'release')
+static void fs_shrink(sfs_extent *ext, int *n, uint32_t blocks, int release) {
+    uint32_t pos = 0;
+    int kept = 0;
+    for (int i = 0; i < *n; i++) {
+        uint32_t len = ext[i].length;
+        if (pos >= blocks) {
+            if (release) fs_free_blocks(ext[i].start, len);
+        } else {
+            if (pos + len > blocks) {
+                if (release) fs_free_blocks(ext[i].start + (blocks - pos), pos + len - blocks);
+                ext[i].length = blocks - pos;
+            }
+            kept = i + 1;
+        }
+        pos += len;
+    }
+    *n = kept;
+}
+
+// Copy 'size' bytes of 'src' (NULL = zeros) to file offset 'pos'. Blocks from
+// 'new_from' on were just allocated: they aren't read from disk first.
+static int fs_write_data(sfs_extent *ext, int n, uint32_t new_from, uint32_t pos, uint32_t size, const char *src) {
+    while (size > 0) {
+        uint32_t fblock = pos / PROJ_BLOCK_SIZE;
+        uint32_t off = pos % PROJ_BLOCK_SIZE;
+        uint32_t len = PROJ_BLOCK_SIZE - off < size ? PROJ_BLOCK_SIZE - off : size;
+        uint32_t disk = fs_ext_map(ext, n, fblock);
+        if (!disk) return -1;
+
+        buf_t *b;
+        if (fblock >= new_from || len == PROJ_BLOCK_SIZE) {
+            b = bget(fs_dev, disk);
+            if (b && len != PROJ_BLOCK_SIZE) memset(b->data, 0, PROJ_BLOCK_SIZE);
+        } else {
+            b = bread(fs_dev, disk);
+        }
+        if (!b) return -1;
+
+        if (src) memory_copy((char *)src, (char *)(b->data + off), len);
+        else memset(b->data + off, 0, len);
+        bdirty(b);
+        brelse(b);
+
+        pos += len;
+        size -= len;
+        if (src) src += len;
+    }
+    return 0;
+}
+
+// Write inode 'ino' back (through the cache) and refresh the inode cache
+static int fs_write_inode(uint32_t ino, sfs_inode *inode) {
+    buf_t *b = bread(fs_dev, sb.inode_table_block + ino / INODES_PER_BLOCK);
+    if (!b) return -1;
+    memory_copy((char *)inode, (char *)(b->data + (ino % INODES_PER_BLOCK) * sizeof(sfs_inode)), sizeof(sfs_inode));
+    bdirty(b);
+    brelse(b);
+
+    fs_icache_invalidate(ino);
+    return 0;
+}
+
+static void fs_icache_get(uint32_t ino, sfs_inode *out) {
+    irq_lock(&icache_lock);
+    memory_copy((char *)&icache[ino].disk, (char *)out, sizeof(sfs_inode));
+    irq_unlock(&icache_lock);
+}
+
+// Resize inode 'ino' to 'new_size' and/or write 'size' bytes of 'src' at
+// 'offset' (size 0 = resize only). fs_write_mutex held.
+// Blocks the file gives up are freed only after the new inode is written, and
+// blocks it got are freed again on failure, so an error never leaves the old
+// inode pointing at free blocks or leaks new ones.
+static int fs_update(uint32_t ino, uint32_t new_size, uint32_t offset, uint32_t size, const char *src) {
+    sfs_inode inode;
+    fs_icache_get(ino, &inode);
+    if (!inode.used) return -1;
+
+    // Pin the inode's table block: fs_write_inode can't fail on a cache miss
+    // after the overflow block has been rewritten
+    buf_t *ib = bread(fs_dev, sb.inode_table_block + ino / INODES_PER_BLOCK);
+    if (!ib) return -1;
+
+    // ext: the new extent list, old: the current one (blocks to free later)
+    sfs_extent *ext = (sfs_extent *)kmalloc(2 * SFS_MAX_EXTENTS * sizeof(sfs_extent));
+    if (!ext) {
+        brelse(ib);
+        return -1;
+    }
+    sfs_extent *old = ext + SFS_MAX_EXTENTS;
+    int n = fs_extents_load(&inode, ext);
+    int old_n = n;
+    uint32_t old_overflow = inode.overflow_block;
+    int result = -1;
+    if (n < 0) goto out;
+    memory_copy((char *)ext, (char *)old, n * sizeof(sfs_extent));
+
+    uint32_t have = (inode.size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
+    uint32_t blocks = (new_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
+
+    if (blocks > have) {
+        if (fs_grow(ext, &n, have, blocks) != 0) goto undo;
+    } else if (blocks < have) {
+        fs_shrink(ext, &n, blocks, 0);
+    }
+
+    // Growing: the bytes between the old end and the new data read as zeros
+    if (new_size > inode.size) {
+        uint32_t zero_end = size ? offset : new_size;
+        if (zero_end > inode.size &&
+            fs_write_data(ext, n, have, inode.size, zero_end - inode.size, 0) != 0) goto undo;
+    }
+    if (size && fs_write_data(ext, n, have, offset, size, src) != 0) goto undo;
+
+    if (fs_extents_store(&inode, ext, n) != 0) goto undo;
+    inode.size = new_size;
+    if (fs_write_inode(ino, &inode) != 0) goto undo;
+
+    // The new inode is written: now the dropped blocks can go
+    if (blocks < have) fs_shrink(old, &old_n, blocks, 1);
+    if (old_overflow && inode.overflow_block != old_overflow) fs_free_blocks(old_overflow, 1);
+    result = 0;
+    goto out;
+
+undo:
+    // Give back the blocks we allocated (the inode still has the old ones)
+    if (blocks > have) fs_shrink(ext, &n, have, 1);
+    if (inode.overflow_block && inode.overflow_block != old_overflow) fs_free_blocks(inode.overflow_block, 1);
+out:
+    kfree(ext);
+    brelse(ib);
+    return result;
+}
+
+int fs_lookup(char *filename) {
+    if (!icache) return -1;
+
+    irq_lock(&icache_lock);
+    for (int ino = name_hash[fs_name_hash(filename)]; ino != -1; ino = icache[ino].hash_next) {
+        if (strcmp(filename, icache[ino].disk.filename) == 0) {
+            irq_unlock(&icache_lock);
+            return ino;
+        }
+    }
+    irq_unlock(&icache_lock);
+    return -1;
+}
+
+// New empty file 'filename' (fs_write_mutex held, the name checked unused).
+// Returns the inode number or -1.
+static int fs_create_locked(char *filename, uint32_t len) {
+    // 1. First free inode
+    uint32_t ino = 0;
+    while (ino < sb.num_inodes && bitmap_test(inode_bitmap, ino)) ino++;
+    if (ino == sb.num_inodes) return -1;
+    fs_bitmap_set(inode_bitmap, sb.inode_bitmap_block, ino, 1, 1);
+
+    // 2. Empty file
+    sfs_inode inode;
+    memset(&inode, 0, sizeof(inode));
+    inode.used = 1;
+    memory_copy(filename, inode.filename, len + 1);
+    if (fs_write_inode(ino, &inode) != 0) {
+        fs_bitmap_set(inode_bitmap, sb.inode_bitmap_block, ino, 1, 0); // Give the inode back
+        return -1;
+    }
+    return ino;
+}
+
+int fs_create(char *filename) {
+    uint32_t len = 0;
+    while (filename[len]) len++;
+    if (!block_bitmap || len == 0 || len >= FILENAME_MAX_LEN) return -1;
+
+    mutex_lock(&fs_write_mutex);
+    int result = fs_lookup(filename) == -1 ? fs_create_locked(filename, len) : -1;
+    mutex_unlock(&fs_write_mutex);
+    return result;
+}
+
+// Lookup and create in one step under the mutex: two callers racing on a new
+// name both get the one file
+int fs_open_or_create(char *filename, int truncate) {
+    uint32_t len = 0;
+    while (filename[len]) len++;
+    if (!block_bitmap || len == 0 || len >= FILENAME_MAX_LEN) return -1;
+
+    mutex_lock(&fs_write_mutex);
+    int ino = fs_lookup(filename);
+    if (ino < 0) ino = fs_create_locked(filename, len);
+    else if (truncate && fs_update(ino, 0, 0, 0, 0) != 0) ino = -1;
+    mutex_unlock(&fs_write_mutex);
+    return ino;
+}
+
+// offset FS_APPEND = at the end of the file (read under the mutex)
+int fs_write(uint32_t ino, uint32_t offset, uint32_t size, const char *buffer) {
+    if (!block_bitmap || ino >= sb.num_inodes) return -1;
+    if (size == 0) return 0;
+
+    mutex_lock(&fs_write_mutex);
+    sfs_inode inode;
+    fs_icache_get(ino, &inode);
+    if (offset == FS_APPEND) offset = inode.size;
+    uint32_t end = offset + size;
+    if (end < offset) {
+        mutex_unlock(&fs_write_mutex);
+        return -1;
+    }
+    int result = fs_update(ino, end > inode.size ? end : inode.size, offset, size, buffer);
+    mutex_unlock(&fs_write_mutex);
+
+    return result == 0 ? (int)size : -1;
+}
+
+int fs_truncate(uint32_t ino, uint32_t size) {
+    if (!block_bitmap || ino >= sb.num_inodes) return -1;
+
+    mutex_lock(&fs_write_mutex);
+    int result = fs_update(ino, size, 0, 0, 0);
+    mutex_unlock(&fs_write_mutex);
+    return result;
+}
+
+int fs_unlink(char *filename) {
+    if (!block_bitmap) return -1;
+
+    mutex_lock(&fs_write_mutex);
+    int result = -1;
+    int ino = fs_lookup(filename);
+    if (ino < 0 || fs_update(ino, 0, 0, 0, 0) != 0) goto out;
+
+    // Free the inode (its blocks went with the truncate)
+    sfs_inode inode;
+    memset(&inode, 0, sizeof(inode));
+    if (fs_write_inode(ino, &inode) != 0) goto out;
+    fs_bitmap_set(inode_bitmap, sb.inode_bitmap_block, ino, 1, 0);
+    result = 0;
+
+out:
+    mutex_unlock(&fs_write_mutex);
+    return result;
+}
+
+int fs_sync() {
+    if (!fs_dev) return -1;
+    return bcache_sync(fs_dev);
+}
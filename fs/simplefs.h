@@ -3,9 +3,41 @@
 
 #include "fs.h"
 
+#define FS_NAME_HASH_SIZE 64  // Filename index buckets (power of two)
+
+// Read-ahead window for sequential readers (in blocks)
+#define FS_RA_MIN_BLOCKS 8    // 4KB after the first sequential read
+#define FS_RA_MAX_BLOCKS 128  // 64KB (BCACHE_RA_MAX)
+
+// An open file: the inode plus per-reader sequential access state
+typedef struct {
+    sfs_inode inode;
+    uint32_t next_block;   // Block a sequential reader asks for next
+    uint32_t ra_end;       // Read-ahead queued up to (not including) this block
+    uint32_t ra_window;    // Current read-ahead window, 0 = random access
+} sfs_file_t;
+
 void fs_init();
 void fs_list_files();
 int fs_find_file(char *filename, sfs_inode *out_inode);
+
+// Re-read inode 'ino' into the inode cache (call after writing it to disk)
+void fs_icache_invalidate(uint32_t ino);
 void fs_read_file(sfs_inode *inode, char *buffer);
 
+// Open by name (1 = found) and read 'size' bytes at 'offset' (returns bytes read)
+int fs_open(char *filename, sfs_file_t *file);
+int fs_read(sfs_file_t *file, uint32_t offset, uint32_t size, char *buffer);
+
+// Writing (write-back: data reaches the disk within BCACHE_FLUSH_SECONDS, or
+// at fs_sync). -1 on error (no such file, disk or inodes full, ...).
+int fs_lookup(char *filename);   // Inode number
+int fs_create(char *filename);   // New empty file: inode number (-1 if it exists)
+int fs_open_or_create(char *filename, int truncate); // Inode number, created if missing (emptied if 'truncate')
+int fs_write(uint32_t ino, uint32_t offset, uint32_t size, const char *buffer); // Bytes written
+#define FS_APPEND 0xFFFFFFFF             // fs_write offset: the current end of the file
+int fs_truncate(uint32_t ino, uint32_t size); // Shrink, or grow with zeros
+int fs_unlink(char *filename);   // Delete the file and free its blocks
+int fs_sync();                   // Write every dirty block of the file system back
+
 #endif
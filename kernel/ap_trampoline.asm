@@ -0,0 +1,98 @@
+; -----------------------------------------------------------------------------
+; kernel/ap_trampoline.asm - Application Processor Boot Code
+; -----------------------------------------------------------------------------
+; smp_init() copies everything between ap_trampoline_start and ap_trampoline_end
+; to physical 0x7000 and sends the Startup IPI with vector 0x07.
+; Every AP then starts HERE, in 16-bit Real Mode, at CS:IP = 0x0700:0000.
+;
+; The code is linked at 3GB like the rest of the kernel but executes at 0x7000,
+; so every absolute address inside the trampoline goes through REL().
+
+[bits 16]
+
+AP_BASE equ 0x7000
+%define REL(x) (AP_BASE + (x) - ap_trampoline_start)
+
+section .text
+
+global ap_trampoline_start
+global ap_trampoline_end
+global ap_boot_args
+
+align 16
+ap_trampoline_start:
+    cli
+    cld
+
+    ; 1. Real Mode -> Protected Mode (temporary flat GDT, same selectors as the kernel)
+    xor ax, ax
+    mov ds, ax
+    lgdt [REL(ap_gdt_ptr)]
+
+    mov eax, cr0
+    or eax, 1           ; PE
+    mov cr0, eax
+
+    jmp dword 0x08:REL(ap_protected_mode)
+
+[bits 32]
+ap_protected_mode:
+    mov ax, 0x10
+    mov ds, ax
+    mov es, ax
+    mov fs, ax
+    mov gs, ax
+    mov ss, ax
+
+    ; 2. Enable Paging with the Kernel Page Directory.
+    ; The BSP temporarily identity-maps 0-4MB, so the next instruction (at ~0x7000)
+    ; is still reachable after the switch.
+    mov eax, [REL(ap_boot_args.cr3)]
+    mov cr3, eax
+
+    mov eax, cr0
+    or eax, 0x80010000  ; PG | WP (same as head.asm)
+    mov cr0, eax
+
+    ; 3. Take a CPU index (1, 2, 3, ...) - all APs run this at the same time
+    mov eax, 1
+    lock xadd [REL(ap_boot_args.next_index)], eax
+    cmp eax, [REL(ap_boot_args.max_index)]
+    jae .park           ; More CPUs than MAX_CPUS: leave this one asleep
+
+    ; 4. Stack = top of ap_stacks[index] (4KB each, higher half address)
+    mov esp, eax
+    inc esp
+    shl esp, 12
+    add esp, [REL(ap_boot_args.stack_base)]
+
+    ; 5. ap_main(index) - absolute call into the higher half
+    push eax
+    mov ebx, [REL(ap_boot_args.entry)]
+    call ebx
+
+.park:
+    cli
+    hlt
+    jmp .park
+
+; Temporary GDT: Null, Kernel Code (0x08), Kernel Data (0x10)
+align 8
+ap_gdt:
+    dq 0
+    dq 0x00CF9A000000FFFF
+    dq 0x00CF92000000FFFF
+ap_gdt_ptr:
+    dw ap_gdt_ptr - ap_gdt - 1
+    dd REL(ap_gdt)
+
+; Parameters written by smp_init() (layout = ap_boot_args_t in smp.c)
+align 4
+ap_boot_args:
+.cr3:        dd 0
+.stack_base: dd 0
+.entry:      dd 0
+.max_index:  dd 0
+.next_index: dd 0
+
+ap_trampoline_end:
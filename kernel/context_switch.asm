@@ -41,8 +41,10 @@ switch_task:
 ; Used to start new tasks with interrupts enabled
 ; void task_wrapper();
 ; Expects: EBX = Function Address to call
+extern schedule_tail
 global task_wrapper
 task_wrapper:
+    call schedule_tail ; Finish the switch that brought us here (unlocks the run queue)
     sti         ; Enable Interrupts (Critical for Preemption!)
     call ebx    ; Call the task function
     jmp $       ; Infinite loop if task returns (TODO: task_exit)
@@ -53,6 +55,8 @@ task_wrapper:
 extern isr_exit
 global fork_ret
 fork_ret:
+    call schedule_tail ; Finish the switch that brought us here (unlocks the run queue)
+
     ; EAX = 0 (Success for child)
     mov eax, 0
     
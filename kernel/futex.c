@@ -0,0 +1,400 @@
+#include "futex.h"
+#include "process.h"
+#include "sync.h"
+#include "vmm.h"
+
+// Defined in drivers/timer.c
+extern uint32_t tick;
+extern uint32_t timer_hz;
+
+// One hash chain. Waiters are kept in FIFO order (woken oldest first).
+// Different futex words may share a bucket: always compare the full key.
+typedef struct futex_bucket {
+    irq_lock_t lock;    // Protects the chain and the futex_* fields of queued tasks
+    process_t *head;    // Front of the chain (woken first)
+    process_t *tail;    // Back of the chain (enqueued last)
+} futex_bucket_t;
+
+// All zero = unlocked and empty, so no init function is needed
+static futex_bucket_t futex_hash[FUTEX_HASH_SIZE];
+
+// Number of queued waiters with a timeout (futex_timer_tick() skips the scan at 0)
+static volatile uint32_t futex_timed_waiters = 0;
+
+// ---------------------------------------------------------
+// Keys and Buckets
+// ---------------------------------------------------------
+
+// Build the key for a user address. Returns 0 if the word is not mapped user memory.
+static int futex_get_key(uint32_t *uaddr, futex_key_t *key, int private)
+{
+    uint32_t addr = (uint32_t)uaddr;
+    if (addr & 3) return 0; // Futex words must be 32-bit aligned
+
+    page_directory *pd = (page_directory *)P2V((uint32_t)current_process->pd);
+    if (!vmm_is_user_range(pd, addr, sizeof(uint32_t))) return 0;
+
+    if (!private) {
+        // Shared memory: key by the physical location, valid in every process
+        pt_entry pte = vmm_get_pte(pd, addr);
+        if (pte & I86_PTE_SHARED) {
+            key->base = (pte & I86_PTE_FRAME) | FUTEX_KEY_SHARED;
+            key->offset = addr & (PAGE_SIZE - 1);
+            return 1;
+        }
+    }
+
+    key->base = (uint32_t)current_process->pd;
+    key->offset = addr;
+    return 1;
+}
+
+static inline int futex_key_match(futex_key_t *a, futex_key_t *b)
+{
+    return a->base == b->base && a->offset == b->offset;
+}
+
+// Multiplicative (Fibonacci) hashing: the top bits of key * 2^32/phi
+static futex_bucket_t *futex_hash_bucket(futex_key_t *key)
+{
+    uint32_t h = (key->offset ^ key->base) * 0x9E3779B9;
+    return &futex_hash[h >> (32 - FUTEX_HASH_BITS)];
+}
+
+// Chain operations (bucket lock must be held)
+static void futex_enqueue(futex_bucket_t *b, process_t *p)
+{
+    p->futex_bucket = b;
+    p->futex_next = 0;
+    p->futex_prev = b->tail;
+    if (b->tail) {
+        b->tail->futex_next = p;
+    } else {
+        b->head = p;
+    }
+    b->tail = p;
+}
+
+static void futex_unqueue(futex_bucket_t *b, process_t *p)
+{
+    if (p->futex_prev) p->futex_prev->futex_next = p->futex_next;
+    else b->head = p->futex_next;
+    if (p->futex_next) p->futex_next->futex_prev = p->futex_prev;
+    else b->tail = p->futex_prev;
+
+    p->futex_next = 0;
+    p->futex_prev = 0;
+    if (p->futex_deadline) {
+        p->futex_deadline = 0;
+        __sync_fetch_and_sub(&futex_timed_waiters, 1);
+    }
+}
+
+// Dequeue and wake one waiter. Once futex_bucket is NULL the waiter owns its
+// futex_* fields again and may return to user space at any moment.
+static void futex_wake_one(futex_bucket_t *b, process_t *p, int result)
+{
+    futex_unqueue(b, p);
+    p->futex_result = result;
+    p->futex_bucket = 0;
+    sched_wake(p);
+}
+
+// Lock two buckets without deadlocking against a requeue going the other way
+static void futex_lock_pair(futex_bucket_t *b1, futex_bucket_t *b2)
+{
+    if (b1 == b2) {
+        irq_lock(&b1->lock);
+    } else if (b1 < b2) {
+        irq_lock(&b1->lock);
+        irq_lock(&b2->lock);
+    } else {
+        irq_lock(&b2->lock);
+        irq_lock(&b1->lock);
+    }
+}
+
+// Reverse order of futex_lock_pair (irq_unlock restores the state saved by its irq_lock)
+static void futex_unlock_pair(futex_bucket_t *b1, futex_bucket_t *b2)
+{
+    if (b1 == b2) {
+        irq_unlock(&b1->lock);
+    } else if (b1 < b2) {
+        irq_unlock(&b2->lock);
+        irq_unlock(&b1->lock);
+    } else {
+        irq_unlock(&b1->lock);
+        irq_unlock(&b2->lock);
+    }
+}
+
+// ---------------------------------------------------------
+// Operations
+// ---------------------------------------------------------
+
+// FUTEX_WAIT: Block the caller if *uaddr == val, until woken or timed out.
+// Returns 0 (woken), FUTEX_EAGAIN, FUTEX_ETIMEDOUT or FUTEX_EINVAL.
+int futex_wait(uint32_t *uaddr, uint32_t val, uint32_t timeout_ms, int private)
+{
+    futex_key_t key;
+    if (!futex_get_key(uaddr, &key, private)) return FUTEX_EINVAL;
+
+    futex_bucket_t *b = futex_hash_bucket(&key);
+    irq_lock(&b->lock);
+
+    // Re-check the value under the bucket lock (wakers take it too).
+    // If a waker already changed it, don't sleep — avoids lost wakeup.
+    if (*(volatile uint32_t *)uaddr != val) {
+        irq_unlock(&b->lock);
+        return FUTEX_EAGAIN;
+    }
+
+    process_t *me = current_process;
+    me->futex_key = key;
+    me->futex_result = 0;
+    me->futex_deadline = 0;
+    if (timeout_ms) {
+        // Round up: never wake before the requested time has passed
+        uint32_t ticks = (timeout_ms / 1000) * timer_hz + ((timeout_ms % 1000) * timer_hz + 999) / 1000;
+        me->futex_deadline = tick + ticks;
+        if (me->futex_deadline == 0) me->futex_deadline = 1; // 0 means "no timeout"
+        __sync_fetch_and_add(&futex_timed_waiters, 1);
+    }
+    futex_enqueue(b, me);
+
+    for (;;) {
+        // Sleep (drops the bucket lock without a lost-wakeup window)
+        irq_lock_sleep(&b->lock);
+        irq_unlock(&b->lock);
+
+        if (me->futex_bucket == 0) break; // Dequeued by a waker or the timer
+
+        // Still queued: a requeue may have moved us to another bucket meanwhile.
+        // Lock whichever bucket we are in now and go back to sleep there.
+        for (;;) {
+            b = me->futex_bucket;
+            if (!b) break;
+            irq_lock(&b->lock);
+            if (me->futex_bucket == b) break;
+            irq_unlock(&b->lock);
+        }
+        if (!b) break;
+    }
+
+    return me->futex_result;
+}
+
+// FUTEX_WAKE: Wake up to nr_wake waiters on uaddr (FIFO order).
+// Returns the number of tasks woken, or FUTEX_EINVAL.
+int futex_wake(uint32_t *uaddr, int nr_wake, int private)
+{
+    futex_key_t key;
+    if (!futex_get_key(uaddr, &key, private)) return FUTEX_EINVAL;
+
+    futex_bucket_t *b = futex_hash_bucket(&key);
+    int woken = 0;
+
+    irq_lock(&b->lock);
+    process_t *p = b->head;
+    while (p && woken < nr_wake) {
+        process_t *next = p->futex_next;
+        if (futex_key_match(&p->futex_key, &key)) {
+            futex_wake_one(b, p, 0);
+            woken++;
+        }
+        p = next;
+    }
+    irq_unlock(&b->lock);
+
+    return woken;
+}
+
+// FUTEX_REQUEUE / FUTEX_CMP_REQUEUE: Wake nr_wake waiters of uaddr and move up
+// to nr_requeue of the rest to uaddr2 without waking them. Used by condition
+// variable broadcast: one thread wakes, the others queue on the mutex directly
+// instead of all stampeding for it at once.
+// Returns the number of tasks woken plus requeued, or a FUTEX_E* error.
+int futex_requeue(uint32_t *uaddr, int nr_wake, int nr_requeue, uint32_t *uaddr2,
+                  int cmp, uint32_t cmpval, int private)
+{
+    futex_key_t key, key2;
+    if (!futex_get_key(uaddr, &key, private) || !futex_get_key(uaddr2, &key2, private)) {
+        return FUTEX_EINVAL;
+    }
+
+    futex_bucket_t *b1 = futex_hash_bucket(&key);
+    futex_bucket_t *b2 = futex_hash_bucket(&key2);
+    int done = 0, requeued = 0;
+
+    // Requeueing onto the same word would only shuffle the queue (forever)
+    if (futex_key_match(&key, &key2)) nr_requeue = 0;
+
+    futex_lock_pair(b1, b2);
+
+    if (cmp && *(volatile uint32_t *)uaddr != cmpval) {
+        futex_unlock_pair(b1, b2);
+        return FUTEX_EAGAIN;
+    }
+
+    process_t *p = b1->head;
+    while (p) {
+        process_t *next = p->futex_next;
+        if (futex_key_match(&p->futex_key, &key)) {
+            if (done < nr_wake) {
+                futex_wake_one(b1, p, 0);
+                done++;
+            } else if (requeued < nr_requeue) {
+                // Keep the timeout: only the word being waited on changes
+                uint32_t deadline = p->futex_deadline;
+                p->futex_deadline = 0; // Still counted in futex_timed_waiters
+                futex_unqueue(b1, p);
+                p->futex_deadline = deadline;
+                p->futex_key = key2;
+                futex_enqueue(b2, p);
+                requeued++;
+            } else {
+                break;
+            }
+        }
+        p = next;
+    }
+
+    futex_unlock_pair(b1, b2);
+    return done + requeued;
+}
+
+// ---------------------------------------------------------
+// Priority Inheritance Locks
+// ---------------------------------------------------------
+// The lock word holds the owner's TID (0 = free). User space takes and drops
+// an uncontended lock with a compare-and-swap; a contender sets FUTEX_WAITERS
+// and sleeps here on the owner (see pi_block_on), which makes the owner's
+// unlock fail its CAS and come in through FUTEX_UNLOCK_PI. Everything below
+// runs under the global PI lock, so word updates here cannot interleave.
+
+// The kernel writes PI words itself: they must be writable (or COW) user memory
+static int futex_pi_writable(uint32_t *uaddr)
+{
+    page_directory *pd = (page_directory *)P2V((uint32_t)current_process->pd);
+    pt_entry pte = vmm_get_pte(pd, (uint32_t)uaddr);
+    return (pte & (I86_PTE_WRITABLE | I86_PTE_COW)) != 0;
+}
+
+// FUTEX_LOCK_PI: Acquire the PI lock at uaddr, blocking (and boosting the
+// owner) while someone else holds it. No timeout.
+// Returns 0 once the lock is ours, FUTEX_EDEADLK or FUTEX_EINVAL.
+int futex_lock_pi(uint32_t *uaddr, int private)
+{
+    futex_key_t key;
+    if (!futex_get_key(uaddr, &key, private) || !futex_pi_writable(uaddr)) return FUTEX_EINVAL;
+
+    volatile uint32_t *word = uaddr;
+    uint32_t tid = current_process->id;
+
+    pi_lock();
+    for (;;) {
+        uint32_t val = *word;
+        uint32_t owner_tid = val & FUTEX_TID_MASK;
+
+        // 1. Free (the owner unlocked after our caller's CAS failed)
+        if (owner_tid == 0) {
+            if (__sync_bool_compare_and_swap(word, val, tid)) break;
+            continue;
+        }
+
+        if (owner_tid == tid) {
+            pi_unlock();
+            return FUTEX_EDEADLK;
+        }
+
+        // 2. Owner is gone (exited holding it): take the lock over.
+        //    Keep FUTEX_WAITERS, others may be on their way in.
+        process_t *owner = find_task(owner_tid);
+        if (!owner) {
+            if (__sync_bool_compare_and_swap(word, val, tid | (val & FUTEX_WAITERS))) break;
+            continue;
+        }
+
+        // 3. Force the owner's unlock into the kernel, then wait for the handoff
+        if (!(val & FUTEX_WAITERS) &&
+            !__sync_bool_compare_and_swap(word, val, val | FUTEX_WAITERS)) {
+            continue;
+        }
+        if (pi_block_on(owner, &key) == 0) break; // Word already holds our TID
+        // FUTEX_EOWNERDEAD: look at the word again
+    }
+    pi_unlock();
+
+    return 0;
+}
+
+// FUTEX_UNLOCK_PI: Release the PI lock at uaddr. The most important waiter
+// becomes the owner right away (its TID is stored in the word), so a newcomer
+// can't barge in ahead of it.
+// Returns 0, FUTEX_EPERM (not the owner) or FUTEX_EINVAL.
+int futex_unlock_pi(uint32_t *uaddr, int private)
+{
+    futex_key_t key;
+    if (!futex_get_key(uaddr, &key, private) || !futex_pi_writable(uaddr)) return FUTEX_EINVAL;
+
+    volatile uint32_t *word = uaddr;
+
+    pi_lock();
+    if ((*word & FUTEX_TID_MASK) != current_process->id) {
+        pi_unlock();
+        return FUTEX_EPERM;
+    }
+
+    int more;
+    process_t *next = pi_handoff(&key, &more);
+    *word = next ? (next->id | (more ? FUTEX_WAITERS : 0)) : 0;
+    pi_unlock();
+
+    return 0;
+}
+
+// SYS_FUTEX: Single entry point for all operations
+int sys_futex(uint32_t *uaddr, int op, uint32_t val, uint32_t val2, uint32_t *uaddr2, uint32_t val3)
+{
+    int private = (op & FUTEX_PRIVATE_FLAG) != 0;
+
+    switch (op & FUTEX_CMD_MASK) {
+        case FUTEX_WAIT:
+            return futex_wait(uaddr, val, val2, private);
+        case FUTEX_WAKE:
+            return futex_wake(uaddr, (int)val, private);
+        case FUTEX_REQUEUE:
+            return futex_requeue(uaddr, (int)val, (int)val2, uaddr2, 0, 0, private);
+        case FUTEX_CMP_REQUEUE:
+            return futex_requeue(uaddr, (int)val, (int)val2, uaddr2, 1, val3, private);
+        case FUTEX_LOCK_PI:
+            return futex_lock_pi(uaddr, private);
+        case FUTEX_UNLOCK_PI:
+            return futex_unlock_pi(uaddr, private);
+        default:
+            return FUTEX_EINVAL;
+    }
+}
+
+// Timer tick (BSP): expire timed waiters. Only scans while some exist.
+void futex_timer_tick()
+{
+    if (futex_timed_waiters == 0) return;
+
+    uint32_t now = tick;
+    for (int i = 0; i < FUTEX_HASH_SIZE; i++) {
+        futex_bucket_t *b = &futex_hash[i];
+        if (!b->head) continue; // Racy peek, the next tick catches anything missed
+
+        irq_lock(&b->lock);
+        process_t *p = b->head;
+        while (p) {
+            process_t *next = p->futex_next;
+            if (p->futex_deadline && (int32_t)(now - p->futex_deadline) >= 0) {
+                futex_wake_one(b, p, FUTEX_ETIMEDOUT);
+            }
+            p = next;
+        }
+        irq_unlock(&b->lock);
+    }
+}
@@ -0,0 +1,69 @@
+#ifndef FUTEX_H
+#define FUTEX_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Futex: Fast User-Space Mutex Slow Path
+// ---------------------------------------------------------
+// User space does the uncontended work with atomics and only calls in here to
+// sleep on / wake up a 32-bit word. Waiters live in a hash table of chained
+// buckets, each with its own lock.
+//
+// Keys:
+//   Private: (page directory, user address). Threads of one process only.
+//   Shared:  (physical frame, offset) for words in shared memory (I86_PTE_SHARED),
+//            so processes match even if they map the object at different addresses.
+// Without FUTEX_PRIVATE_FLAG the kernel looks at the page to decide; ordinary
+// (COW/anonymous) pages fall back to the private key, so unrelated processes
+// using the same address never match.
+
+// Operations for SYS_FUTEX (ECX). programs/lib.h uses the same numbers.
+#define FUTEX_WAIT        0 // Sleep if *uaddr == val. val2 = timeout in ms (0 = forever)
+#define FUTEX_WAKE        1 // Wake up to val waiters
+#define FUTEX_REQUEUE     2 // Wake val waiters, move up to val2 others to uaddr2
+#define FUTEX_CMP_REQUEUE 3 // Same, but only if *uaddr == val3 (else FUTEX_EAGAIN)
+#define FUTEX_LOCK_PI     4 // Acquire a PI lock word (owner TID), boosting the owner while we wait
+#define FUTEX_UNLOCK_PI   5 // Hand a PI lock word to its most important waiter
+#define FUTEX_PRIVATE_FLAG 128 // OR into op: word is process-private, skip the page walk
+#define FUTEX_CMD_MASK    (~FUTEX_PRIVATE_FLAG)
+
+// Return values (negative = error)
+#define FUTEX_EAGAIN    -1 // *uaddr did not hold the expected value
+#define FUTEX_ETIMEDOUT -2 // Timeout expired before a wake up
+#define FUTEX_EINVAL    -3 // Bad address or operation
+#define FUTEX_EDEADLK   -4 // LOCK_PI on a lock we already own
+#define FUTEX_EPERM     -5 // UNLOCK_PI on a lock we don't own
+#define FUTEX_EOWNERDEAD -6 // (internal) PI owner exited while we waited
+
+// PI lock word: owner TID, plus FUTEX_WAITERS while tasks wait in the kernel
+// (the owner's unlock must then go through FUTEX_UNLOCK_PI). 0 = unlocked.
+#define FUTEX_WAITERS   0x80000000
+#define FUTEX_TID_MASK  0x3FFFFFFF
+
+// 256 buckets: 4KB of lock + list heads
+#define FUTEX_HASH_BITS 8
+#define FUTEX_HASH_SIZE (1 << FUTEX_HASH_BITS)
+
+// Identifies one futex word (see Keys above)
+#define FUTEX_KEY_SHARED 1 // Bit 0 of base (both bases are page aligned)
+typedef struct {
+    uint32_t base;    // Private: page directory (physical). Shared: frame | FUTEX_KEY_SHARED
+    uint32_t offset;  // Private: user virtual address.     Shared: offset inside the frame
+} futex_key_t;
+
+struct futex_bucket;
+
+// 'private' = 1 for FUTEX_PRIVATE_FLAG semantics
+int futex_wait(uint32_t *uaddr, uint32_t val, uint32_t timeout_ms, int private);
+int futex_wake(uint32_t *uaddr, int nr_wake, int private);
+int futex_requeue(uint32_t *uaddr, int nr_wake, int nr_requeue, uint32_t *uaddr2,
+                  int cmp, uint32_t cmpval, int private);
+int futex_lock_pi(uint32_t *uaddr, int private);
+int futex_unlock_pi(uint32_t *uaddr, int private);
+int sys_futex(uint32_t *uaddr, int op, uint32_t val, uint32_t val2, uint32_t *uaddr2, uint32_t val3);
+
+// Called on every timer tick: wakes waiters whose timeout expired
+void futex_timer_tick();
+
+#endif
@@ -10,8 +10,18 @@
 #include "kheap.h"
 #include "gdt.h"
 #include "tss.h"
+#include "sysenter.h"
+#include "fpu.h"
+#include "smp.h"
+#include "spinlock.h"
+#include "vdso.h"
 #include "../drivers/ata.h"
+#include "../drivers/pci.h"
+#include "../drivers/virtio_blk.h"
+#include "../drivers/ahci.h"
+#include "../drivers/blockdev.h"
 #include "../fs/simplefs.h"
+#include "../fs/bcache.h"
 
 extern uint32_t _kernel_end;
 
@@ -255,11 +265,15 @@ void handle_scrolling()
 
 void print_backspace(); // Forward Declaration
 
+// Serializes the screen/serial output between CPUs
+static volatile uint32_t console_lock = 0;
+
 void print_buffer(char *string, int len)
 {
     // Save current interrupt state and disable interrupts to prevent race condition
     uint32_t flags;
     __asm__ volatile("pushf; pop %0; cli" : "=r" (flags));
+    spin_lock(&console_lock);
 
     for (int i = 0; i < len; i++)
     {
@@ -292,6 +306,7 @@ void print_buffer(char *string, int len)
     }
 
     set_cursor_offset(cursor_offset);
+    spin_unlock(&console_lock);
 
     // Restore interrupt state (if it was enabled before, enable it back)
     if (flags & 0x200) {
@@ -394,9 +409,13 @@ void main()
     print_string("IDT loaded successfully!\n");
 
     // Initialize GDT and TSS 
-    init_gdt();
-    init_tss();
+    init_gdt(0); // BSP = CPU 0 (APs set up their own in ap_main)
+    init_tss(0);
     print_string("GDT & TSS Initialized.\n");
+    // SYSENTER/SYSEXIT fast system call path (INT 0x80 stays available)
+    init_sysenter();
+    // x87/SSE for user programs (state switched lazily via #NM)
+    init_fpu();
     // Initialize Timer (50 Hz)
     init_timer(50);
     //while(1);
@@ -457,7 +476,16 @@ void main()
     //     print_string("FAILURE! Fragmentation detected.\n");
     // }
     // print_string("----------------------------\n");
+    // --- PCI Bus Scan (disk controllers) ---
+    pci_init();
+
+    // Disk drivers register block devices in probe order, fastest first:
+    // SimpleFS mounts the first disk that holds it.
+    ahci_init();       // SATA (q35), NCQ
+    virtio_blk_init(); // Paravirtual disk (QEMU/KVM)
+
     // --- ATA Driver Test ---
+    ata_init();
     print_string("Testing ATA Driver...\n");
     uint8_t sect[512];
     ata_read_sector(0, sect); // Read MBR (Sector 0)
@@ -468,9 +496,21 @@ void main()
     print_string("\n");
 
     fs_init();
+
+    // Shared time/info page for user space (needs PMM + timer frequency)
+    vdso_init();
     
     // Initialize Multitasking (Creates PID 0)
     init_multitasking();
+
+    // Disk requests can sleep now: let the disk IRQs complete them
+    blockdev_enable_irq();
+    // ...and let daemons read ahead of sequential file readers and write
+    // dirty buffers back
+    bcache_start_threads();
+
+    // Start the other CPUs (each gets its own GDT/TSS, LAPIC timer and run queue)
+    smp_init();
     //while(1);
     // --- Create PID 1: Shell Task ---
     // Instead of transforming the Kernel (PID 0) into Shell via enter_user_mode,
@@ -4,6 +4,8 @@
 #include "vmm.h"
 #include "pmm.h"
 #include "sync.h"
+#include "vdso.h"
+#include "gdt.h"
 
 // External function (Assembly) to switch context
 // void switch_task(uint32_t *next_esp, uint32_t **current_esp_ptr);
@@ -52,11 +54,11 @@ void enter_user_mode(uint32_t entry_point)
 
 #include "../mm/kheap.h"
 
-// Process List (Doubly Linked)
+// Process List (Doubly Linked): every process on every CPU.
+// Used for parent/child bookkeeping (exit/wait); scheduling uses the per-CPU run queues.
 static process_t *process_list = 0;
-/* static process_t *current_process = 0; // Removed static for sync.c access */
-process_t *current_process = 0;
-static uint32_t next_pid = 0;
+static irq_lock_t proc_lock; // Protects process_list and exit/wait state changes
+static uint32_t next_pid = 0; // Allocated with __sync_fetch_and_add
 
 extern void print_string(char *str);
 extern void print_dec(int n);
@@ -73,6 +75,8 @@ void init_multitasking()
     process_list->id = 0;
     process_list->parent_id = -1; // Kernel has no parent
     process_list->state = PROCESS_RUNNING;
+    process_list->cpu = 0;
+    process_list->on_cpu = 1;
 
     // Get current CR3
     uint32_t cr3;
@@ -82,8 +86,19 @@ void init_multitasking()
     process_list->next = 0;
     process_list->prev = 0;
 
-    current_process = process_list;
+    irq_lock_init(&proc_lock);
+
+    // PID 0 runs on the BSP and doubles as its idle task
+    cpu_t *bsp = &cpus[0];
+    process_list->rq_next = process_list;
+    process_list->rq_prev = process_list;
+    bsp->rq_head = process_list;
+    bsp->nr_tasks = 1;
+    bsp->idle = process_list;
+    bsp->current = process_list;
+
     next_pid = 1;
+    vdso_set_current(0);
 
     print_string("Multitasking Initialized. Kernel is PID 0.\n");
 }
@@ -98,7 +113,7 @@ void create_task(void (*function)())
     }
     memset(new_task, 0, sizeof(process_t));
 
-    int pid = next_pid++;
+    int pid = __sync_fetch_and_add(&next_pid, 1);
 
     
     new_task->id = pid;
@@ -135,12 +150,8 @@ void create_task(void (*function)())
 
     new_task->state = PROCESS_READY;
 
-    // Append to linked list
-    process_t *tail = process_list;
-    while (tail->next) tail = tail->next;
-    
-    tail->next = new_task;
-    new_task->prev = tail;
+    // Append to process list + a CPU's run queue
+    sched_add(new_task);
 }
 
 // Helper stub defined in context_switch.asm
@@ -158,7 +169,7 @@ int sys_fork(registers_t *regs)
 
     // 2. Identify IDs
     uint32_t parent_pid = current_process->id;
-    uint32_t child_pid = next_pid++;
+    uint32_t child_pid = __sync_fetch_and_add(&next_pid, 1);
 
     // 3. Initialize Child
     child->id = child_pid;
@@ -169,6 +180,13 @@ int sys_fork(registers_t *regs)
     // 4. Clone Address Space
     extern uint32_t vmm_clone_directory(page_directory * src);
     child->pd = (page_directory *)vmm_clone_directory((page_directory *)P2V((uint32_t)current_process->pd));
+
+    // Child continues with the parent's FPU/SSE registers
+    fpu_fork(child);
+
+    // ...and its TLS block (same address in the copied address space)
+    child->tls_base = current_process->tls_base;
+    child->tls_size = current_process->tls_size;
     
     // 5. Setup Child's Kernel Stack
     uint32_t *child_stack_ptr = child->stack + 1024;
@@ -205,12 +223,8 @@ int sys_fork(registers_t *regs)
     
     child->state = PROCESS_READY;
 
-    // 7. Append to List
-    process_t *tail = process_list;
-    while (tail->next) tail = tail->next;
-    
-    tail->next = child;
-    child->prev = tail;
+    // 7. Append to List (and a CPU's run queue)
+    sched_add(child);
 
     return child_pid;
 }
@@ -222,9 +236,10 @@ int sys_clone(registers_t *regs)
     // 1. Allocate process structure
     process_t *child = (process_t*)kmalloc(sizeof(process_t));
     if (!child) return -1;
+    memset(child, 0, sizeof(process_t)); // No stale wait/ring pointers from a previous PCB
 
     // 2. Setup IDs
-    child->id = next_pid++;
+    child->id = __sync_fetch_and_add(&next_pid, 1);
     child->parent_id = current_process->id;
     child->state = PROCESS_READY;
     child->exit_code = 0;
@@ -241,6 +256,9 @@ int sys_clone(registers_t *regs)
     pmm_inc_ref(V2P((uint32_t)child->pd));
     irq_unlock(&pd_ref_lock);
     
+    // Thread starts with a copy of the creator's FPU/SSE registers (MXCSR, etc.)
+    fpu_fork(child);
+
     // 4. Setup Kernel Stack (Same logic as fork)
     uint32_t *stack_ptr = (uint32_t*)(child->stack + 1024);
     
@@ -262,6 +280,9 @@ int sys_clone(registers_t *regs)
     if (regs->ecx != 0) {
         child_regs->eip = regs->ecx;
     }
+
+    // No TLS until the thread installs its own (the creator's belongs to the creator)
+    child_regs->gs = GDT_USER_DATA_SEL;
     
     // 6. Manual Stack Setup for "fork_ret" (Kernel Thread Return)
     // We emulate what `switch_task` expects on the stack when it switches to this thread.
@@ -278,12 +299,8 @@ int sys_clone(registers_t *regs)
     
     child->esp = stack_ptr; // Save kernel stack pointer
     
-    // 5. Add to process list
-    process_t *tail = process_list;
-    while (tail->next) tail = tail->next;
-    tail->next = child;
-    child->prev = tail;
-    child->next = 0;
+    // 5. Add to process list (and a CPU's run queue: threads spread over the CPUs)
+    sched_add(child);
     
     return child->id; // Return Child PID (TID) to parent
 }
@@ -294,54 +311,178 @@ void block_process() {
     schedule();
 }
 
+// Mark a task READY. It stays on its own CPU's run queue; if that CPU is
+// idling or running something less important, poke it so the task doesn't
+// wait for the next timer tick.
+void sched_wake(process_t *p) {
+    p->state = PROCESS_READY;
+    smp_kick(p->cpu, p->eff_prio);
+}
+
+// p's effective priority went up (PI boost): make its CPU reconsider
+void sched_prio_changed(process_t *p) {
+    if (p->state == PROCESS_READY) {
+        smp_kick(p->cpu, p->eff_prio);
+    }
+}
+
+// Look up a live task by PID (NULL if none, or if it has started to exit).
+// A task found while holding the PI lock cannot finish exiting until it is
+// released (sys_exit -> pi_owner_exit), so the pointer stays valid that long.
+process_t *find_task(uint32_t pid) {
+    irq_lock(&proc_lock);
+    process_t *p = process_list;
+    while (p) {
+        if (p->id == pid && p->state != PROCESS_TERMINATED && !p->exiting) break;
+        p = p->next;
+    }
+    irq_unlock(&proc_lock);
+    return p;
+}
+
 // Unblock a specific process (mark as READY)
 void unblock_process(process_t *p) {
     if (p && p->state == PROCESS_BLOCKED) {
-        p->state = PROCESS_READY;
+        sched_wake(p);
+    }
+}
+
+// Make a new task known to the system:
+// 1. process_list (parent/child bookkeeping)
+// 2. the run queue of the least loaded online CPU.
+//    Tasks never migrate afterwards, so their lazily saved FPU state and
+//    their wakeups always stay on one CPU.
+void sched_add(process_t *p)
+{
+    irq_lock(&proc_lock);
+    process_t *tail = process_list;
+    while (tail->next) tail = tail->next;
+    tail->next = p;
+    p->prev = tail;
+    p->next = 0;
+
+    uint32_t best = 0;
+    for (uint32_t i = 1; i < ncpus; i++) {
+        if (cpus[i].online && cpus[i].nr_tasks < cpus[best].nr_tasks) best = i;
+    }
+    cpu_t *cpu = &cpus[best];
+    p->cpu = best;
+
+    // Inherit the creator's priority (tasks created by the idle task get the default)
+    p->prio = current_process->prio > PRIO_IDLE ? current_process->prio : PRIO_DEFAULT;
+    p->eff_prio = p->prio;
+
+    spin_lock(&cpu->rq_lock);
+    if (!cpu->rq_head) {
+        p->rq_next = p;
+        p->rq_prev = p;
+        cpu->rq_head = p;
+    } else {
+        // Insert at the tail (just before head)
+        p->rq_next = cpu->rq_head;
+        p->rq_prev = cpu->rq_head->rq_prev;
+        cpu->rq_head->rq_prev->rq_next = p;
+        cpu->rq_head->rq_prev = p;
+    }
+    cpu->nr_tasks++;
+    spin_unlock(&cpu->rq_lock);
+    irq_unlock(&proc_lock);
+
+    smp_kick(best, p->eff_prio);
+}
+
+// Take a dead task off its CPU's run queue (caller holds proc_lock)
+static void sched_remove(process_t *p)
+{
+    cpu_t *cpu = &cpus[p->cpu];
+
+    spin_lock(&cpu->rq_lock);
+    if (p->rq_next == p) {
+        cpu->rq_head = 0;
+    } else {
+        p->rq_prev->rq_next = p->rq_next;
+        p->rq_next->rq_prev = p->rq_prev;
+        if (cpu->rq_head == p) cpu->rq_head = p->rq_next;
     }
+    p->rq_next = 0;
+    p->rq_prev = 0;
+    cpu->nr_tasks--;
+    spin_unlock(&cpu->rq_lock);
 }
 
-// Linked-List Round-Robin Scheduler
+// Priority Scheduler over THIS CPU's run queue (round-robin among equals)
 void schedule()
 {
     // Atomic Schedule: Ensure no interrupts interrupt the scheduler itself
     __asm__ volatile("cli");
 
-    if (!process_list || !process_list->next) return;
+    cpu_t *cpu = this_cpu();
+    process_t *prev = cpu->current;
+    if (!prev) return; // Scheduler not running on this CPU yet
+
+    // Held across switch_task, released by schedule_tail() in the NEXT task.
+    spin_lock(&cpu->rq_lock);
+
+    // 1. Select next process: the READY or RUNNING one with the highest
+    //    effective priority. Scanning starts right after 'prev', so equal
+    //    priorities take turns (and 'prev' itself comes last).
+    //    (the idle task of an AP is not on the queue: start at the head then)
+    process_t *next = 0;
+    if (cpu->rq_head) {
+        process_t *start = prev->rq_next ? prev->rq_next : cpu->rq_head;
+        process_t *p = start;
+        do {
+            if ((p->state == PROCESS_READY || p->state == PROCESS_RUNNING) &&
+                (!next || p->eff_prio > next->eff_prio)) {
+                next = p;
+            }
+            p = p->rq_next;
+        } while (p != start);
+    }
+    if (!next) next = cpu->idle;
+
+    // 2. Context Switch needed?
+    if (!next || next == prev) {
+        spin_unlock(&cpu->rq_lock);
+        return;
+    }
+
+    cpu->current = next;
+    next->on_cpu = 1;
 
-    // 1. Select next process
-    process_t *next = current_process->next;
-    if (!next) next = process_list; // Wrap around to head
+    // Update TSS ESP0 for User Mode interrupts
+    uint32_t new_kernel_stack = (uint32_t)(next->stack + 1024);
+    tss_set_stack(new_kernel_stack);
 
-    process_t *start_node = next;
+    // Its TLS segment (takes effect when it reloads %gs on the way to user mode)
+    gdt_set_tls(cpu->id, next->tls_base, next->tls_size);
 
-    // Find first READY or RUNNING process
-    while (next->state != PROCESS_READY && next->state != PROCESS_RUNNING) {
-        next = next->next;
-        if (!next) next = process_list;
+    // Let user space read its PID from the vDSO page without a syscall
+    vdso_set_current(next->id);
 
-        if (next == start_node) {
-            return;
-        }
+    // Lazy FPU: arm CR0.TS unless 'next' still owns the FPU registers
+    fpu_switch(next);
+
+    // Switch Page Directory (CR3) if different
+    if (next->pd != prev->pd) {
+        __asm__ volatile("mov %0, %%cr3" ::"r"(next->pd));
     }
 
-    // 2. Context Switch needed?
-    if (next != current_process) {
-        process_t *prev = current_process;
-        current_process = next;
-
-        // Update TSS ESP0 for User Mode interrupts
-        extern void tss_set_stack(uint32_t kernel_esp);
-        uint32_t new_kernel_stack = (uint32_t)(current_process->stack + 1024);
-        tss_set_stack(new_kernel_stack);
-
-        // Switch Page Directory (CR3) if different
-        if (current_process->pd != prev->pd) {
-            __asm__ volatile("mov %0, %%cr3" ::"r"(current_process->pd));
-        }
+    cpu->prev = prev;
+    switch_task(next->esp, &prev->esp);
 
-        switch_task(current_process->esp, &prev->esp);
-    }
+    // Back in 'prev' (possibly much later, switched to by another schedule())
+    schedule_tail();
+}
+
+// First thing a task does after switch_task() lands in it: the task we came
+// from is off its stack now (sys_wait may free it), and the run queue is ours
+// to unlock. New tasks get here through task_wrapper / fork_ret.
+void schedule_tail()
+{
+    cpu_t *cpu = this_cpu();
+    cpu->prev->on_cpu = 0;
+    spin_unlock(&cpu->rq_lock);
 }
 
 // External declarations for sys_execve
@@ -350,13 +491,10 @@ extern void memset(void *dest, int val, int len);
 
 int sys_execve(char *filename, char **argv, char **envp, registers_t *regs)
 {
-    // Critical Section: Disable Interrupts to prevent preemption during ELF load
-    // The ATA Driver is Polling-based, so it works fine with interrupts disabled.
-    __asm__ volatile("cli");
-
     // 1. Load the ELF file
     // Note: elf_load writes directly into the current Page Directory's User Space (0x400000)
     // It assumes the memory is already mapped (which it is, 4MB-8MB).
+    // The disk reads sleep on IRQ14, so other tasks run while the ELF loads.
     uint32_t entry = elf_load(filename);
 
     if (!entry)
@@ -383,6 +521,27 @@ int sys_execve(char *filename, char **argv, char **envp, registers_t *regs)
 
     memset((void *)0xF00000, 0, 4096);
 
+    // Make sure the shared vDSO page is visible to the new program
+    vdso_map(current_pd);
+
+    // Only elf_load needs interrupts: fpu_release tests and clears this CPU's
+    // FPU owner, and gdt_set_tls must hit the CPU we return to user mode on.
+    uint32_t flags = irq_save();
+
+    // The old program's syscall ring is gone with its memory image
+    current_process->ring = 0;
+
+    // ...and so is its FPU/SSE state: start clean on the next FPU instruction
+    fpu_release(current_process);
+
+    // ...and its TLS block
+    current_process->tls_base = 0;
+    current_process->tls_size = 0;
+    gdt_set_tls(cpu_id(), 0, 0);
+    regs->gs = GDT_USER_DATA_SEL;
+
+    irq_restore(flags);
+
     // 3. Update Trap Frame (regs) to "Return" to the New Program
     // When the syscall handler returns, it performs IRET using these values.
     regs->eip = entry;        // Jump to ELF Entry Point
@@ -399,12 +558,97 @@ int sys_execve(char *filename, char **argv, char **envp, registers_t *regs)
     // EAX will be overwritten by the return value of this function (0),
     // effectively passing 0 to the new program.
 
-    // End Critical Section
-    __asm__ volatile("sti");
-
     return 0; // Success
 }
 
+// First code run by a spawned process (in its own, fresh address space).
+// Same job as launch_shell(), for the file recorded by sys_spawn().
+static void spawn_entry()
+{
+    uint32_t entry = elf_load(current_process->spawn_path);
+    if (!entry) {
+        sys_exit(-1);
+    }
+
+    // Like sys_execve, only the load runs with interrupts on: from here to the
+    // IRET this task must stay on its CPU
+    __asm__ volatile("cli");
+
+    uint32_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    page_directory *current_pd = (page_directory *)P2V(cr3);
+
+    uint32_t frame = pmm_alloc_block();
+    if (!frame) {
+        sys_exit(-1);
+    }
+    vmm_map_page_in_dir(current_pd, 0xF00000, frame, I86_PTE_PRESENT | I86_PTE_WRITABLE | I86_PTE_USER);
+    memset((void *)0xF00000, 0, 4096);
+
+    enter_user_mode(entry); // IRET re-enables interrupts
+}
+
+// Filenames from user mode (SYS_SPAWN, the file syscalls, RING_OP_SPAWN):
+// checked page by page, so a name straddling into unmapped memory fails cleanly
+int copy_user_filename(uint32_t uaddr, char *out)
+{
+    page_directory *pd = (page_directory*)P2V((uint32_t)current_process->pd);
+    for (uint32_t i = 0; i < FILENAME_MAX_LEN; i++) {
+        if ((i == 0 || ((uaddr + i) & (PAGE_SIZE - 1)) == 0) &&
+            !vmm_is_user_range(pd, uaddr + i, 1)) return -1;
+        out[i] = ((char*)uaddr)[i];
+        if (out[i] == '\0') return 0;
+    }
+    return -1;
+}
+
+// sys_spawn: Create a new process that runs 'filename'.
+// Unlike fork + exec, nothing of the caller's address space is copied:
+// the child starts from a clean clone of the kernel directory.
+// Returns the child PID (the caller can wait() for it), or -1.
+int sys_spawn(char *filename)
+{
+    process_t *child = (process_t*)kmalloc(sizeof(process_t));
+    if (!child) return -1;
+    memset(child, 0, sizeof(process_t));
+
+    // 1. Copy the filename (callers pass a kernel copy, see copy_user_filename)
+    int i = 0;
+    while (i < FILENAME_MAX_LEN - 1 && filename[i] != '\0') {
+        child->spawn_path[i] = filename[i];
+        i++;
+    }
+    child->spawn_path[i] = '\0';
+
+    // 2. Fresh address space (kernel mappings + vDSO page only)
+    child->pd = (page_directory *)vmm_clone_directory(kernel_directory);
+    if (!child->pd) {
+        kfree(child);
+        return -1;
+    }
+
+    child->id = __sync_fetch_and_add(&next_pid, 1);
+    child->parent_id = current_process->id;
+
+    // 3. Forge the Stack for switch_task -> task_wrapper -> spawn_entry
+    // (Same layout as create_task)
+    extern void task_wrapper();
+    uint32_t *stack_ptr = &child->stack[1023];
+    *stack_ptr-- = (uint32_t)task_wrapper; // Return Address
+    *stack_ptr-- = (uint32_t)spawn_entry;  // EBX (called by task_wrapper)
+    *stack_ptr-- = 0;                      // ESI
+    *stack_ptr-- = 0;                      // EDI
+    *stack_ptr-- = 0;                      // EBP
+    child->esp = stack_ptr + 1;
+
+    child->state = PROCESS_READY;
+
+    // 4. Append to List
+    sched_add(child);
+
+    return child->id;
+}
+
 // -------------------------------------------------
 // Step 4.5: Exit & Wait Implementation
 // -------------------------------------------------
@@ -413,8 +657,12 @@ void sys_exit(int code)
 {
     __asm__ volatile("cli");
 
-    current_process->exit_code = code;
-    current_process->state = PROCESS_TERMINATED;
+    // Tasks blocked on PI locks we still hold must not wait for a dead owner
+    pi_owner_exit(current_process);
+
+    // The FPU registers of this CPU may hold our state: forget it before the
+    // PCB can be freed by the parent (possibly on another CPU).
+    fpu_release(current_process);
 
     print_string("\n[Kernel] Process ");
     print_dec(current_process->id);
@@ -422,19 +670,24 @@ void sys_exit(int code)
     print_dec(code);
     print_string(".\n");
 
+    irq_lock(&proc_lock);
+    current_process->exit_code = code;
+    current_process->state = PROCESS_TERMINATED;
+
     // Wake up parent if it is blocked waiting for us
     if (current_process->parent_id != -1) {
         process_t *node = process_list;
         while (node) {
             if (node->id == current_process->parent_id) {
                 if (node->state == PROCESS_BLOCKED) {
-                    node->state = PROCESS_READY;
+                    sched_wake(node);
                 }
                 break;
             }
             node = node->next;
         }
     }
+    irq_unlock(&proc_lock); // Interrupts stay off (we did cli)
 
     schedule();
 
@@ -446,9 +699,12 @@ void sys_exit(int code)
 
 int sys_wait(int *status)
 {
+    irq_lock(&proc_lock);
+
     while (1)
     {
         int has_children = 0;
+        int zombie_busy = 0;
         process_t *node = process_list;
         
         while (node) {
@@ -456,18 +712,27 @@ int sys_wait(int *status)
                 has_children = 1;
                 
                 if (node->state == PROCESS_TERMINATED) {
+                    // Its CPU may still be switching away from it (on its stack)
+                    if (node->on_cpu) {
+                        zombie_busy = 1;
+                        node = node->next;
+                        continue;
+                    }
+
                     // 1. Found Zombie Child
                     if (status) *status = node->exit_code;
                     int child_pid = node->id;
                     
-                    // 2. Unlink from List
+                    // 2. Unlink from List (and its CPU's run queue)
                     if (node->prev) node->prev->next = node->next;
                     if (node->next) node->next->prev = node->prev;
+                    sched_remove(node);
+                    irq_unlock(&proc_lock);
 
                     // 3. Free Resources
                     // A. Free Page Directory (and User Pages)
                     vmm_free_directory((page_directory*)P2V((uint32_t)node->pd));
-                    
+
                     // B. Free PCB (and Kernel Stack inside it)
                     kfree(node);
                     
@@ -479,114 +744,83 @@ int sys_wait(int *status)
 
         if (!has_children)
         {
+            irq_unlock(&proc_lock);
             return -1; // No children to wait for
         }
 
+        if (zombie_busy) {
+            // A matter of a few instructions on the other CPU: retry
+            irq_unlock(&proc_lock);
+            __asm__ volatile("pause");
+            irq_lock(&proc_lock);
+            continue;
+        }
+
         // Children exist but are running.
         // Instead of busy waiting (HLT), mark itself as BLOCKED and yield.
         // It will be woken up when a child process calls sys_exit().
-        block_process(); 
-    }
-}
-
-// ---------------------------------------------------
-// Futex: Fast User-Space Mutex Slow Path (FIFO Queue)
-// ---------------------------------------------------
-
-// Per-address wait queue.
-// Each entry tracks the head and tail of the queue of processes
-// blocked on a specific futex address.
-#define FUTEX_TABLE_SIZE 8
-typedef struct {
-    int *addr;          // The futex address this bucket is for (NULL = unused slot)
-    process_t *head;    // Front of FIFO queue (woken first)
-    process_t *tail;    // Back of FIFO queue (enqueued last)
-} futex_bucket_t;
-
-static futex_bucket_t futex_table[FUTEX_TABLE_SIZE];
-
-// Find or create a bucket for the given addr (interrupts must be off)
-static futex_bucket_t *futex_get_bucket(int *addr)
-{
-    // 1. Try to find existing bucket for this addr
-    for (int i = 0; i < FUTEX_TABLE_SIZE; i++) {
-        if (futex_table[i].addr == addr) return &futex_table[i];
-    }
-    // 2. Allocate a new empty slot
-    for (int i = 0; i < FUTEX_TABLE_SIZE; i++) {
-        if (futex_table[i].addr == 0) {
-            futex_table[i].addr = addr;
-            futex_table[i].head = 0;
-            futex_table[i].tail = 0;
-            return &futex_table[i];
-        }
+        irq_lock_sleep(&proc_lock);
     }
-    return 0; // Table full (shouldn't happen with 8 unique locks)
 }
 
-// sys_futex_wait: Block the calling process if *addr == val.
-// Enqueues the caller at the TAIL of the per-addr FIFO queue.
-int sys_futex_wait(int *addr, int val)
+// sys_setprio: Change the base priority of task 'tid' (0 = caller).
+// Lowering is always allowed. A task can't raise itself above PRIO_DEFAULT
+// (or the priority it already has): with strict priorities and no migration,
+// a CPU-bound task up there would starve everything else on its CPU.
+// Another task must be a thread of the caller's process (same page directory),
+// and can't be raised above the caller's own base priority.
+// A PI boost in effect stays until the lock is released.
+// Returns the old base priority, or -1 if there is no such task (or no right).
+int sys_setprio(uint32_t tid, int prio)
 {
-    __asm__ volatile("cli");
-
-    // Re-check the value atomically (with interrupts off).
-    // If a waker already changed it, don't sleep — avoids lost wakeup.
-    if (*addr != val) {
-        __asm__ volatile("sti");
+    pi_lock();
+    process_t *p = tid ? find_task(tid) : current_process;
+    if (!p || (p != current_process && p->pd != current_process->pd)) {
+        pi_unlock();
         return -1;
     }
 
-    futex_bucket_t *bucket = futex_get_bucket(addr);
-    if (!bucket) {
-        __asm__ volatile("sti");
-        return -1; // Futex table full
-    }
-
-    // Enqueue current process at the TAIL (FIFO order)
-    current_process->wait_next = 0;
-    if (bucket->tail == 0) {
-        bucket->head = current_process;
-        bucket->tail = current_process;
-    } else {
-        bucket->tail->wait_next = current_process;
-        bucket->tail = current_process;
+    int old = p->prio;
+    if (prio >= 0) {
+        if (prio < PRIO_MIN) prio = PRIO_MIN;
+        if (prio > PRIO_MAX) prio = PRIO_MAX;
+        int limit = p == current_process ? (p->prio > PRIO_DEFAULT ? p->prio : PRIO_DEFAULT)
+                                         : current_process->prio;
+        if (prio > limit && prio > p->prio) {
+            pi_unlock();
+            return -1;
+        }
+        p->prio = prio;
+        pi_update(p);
     }
+    pi_unlock();
 
-    current_process->futex_wait_addr = addr;
-    current_process->state = PROCESS_BLOCKED;
-
-    // Context switch (scheduler re-enables interrupts in next process)
-    schedule();
-
-    // Woken up by sys_futex_wake — addr field already cleared by waker
-    return 0;
+    // Lowered ourselves below another READY task? Let it run.
+    if (p == current_process) schedule();
+    return old;
 }
 
-// sys_futex_wake: Wake one process from the HEAD of the addr's FIFO queue.
-void sys_futex_wake(int *addr)
+// sys_set_thread_area: Give the calling thread a TLS segment [base, base + size)
+// (size 0 = remove it). Every switch to this thread rewrites GDT entry 7 of
+// its CPU with it, so %gs-relative accesses hit this thread's block only.
+// Also loads %gs for the caller on the way back to user mode.
+// Returns the selector (GDT_TLS_SEL), or -1 if the range is not user space.
+int sys_set_thread_area(uint32_t base, uint32_t size, registers_t *regs)
 {
-    __asm__ volatile("cli");
-
-    for (int i = 0; i < FUTEX_TABLE_SIZE; i++) {
-        if (futex_table[i].addr == addr && futex_table[i].head != 0) {
-            // Dequeue from the HEAD (FIFO: oldest waiter goes first)
-            process_t *waking = futex_table[i].head;
-            futex_table[i].head = waking->wait_next;
-            if (futex_table[i].head == 0) {
-                futex_table[i].tail = 0;       // Queue now empty
-                futex_table[i].addr = 0;       // Release the slot
-            }
-            waking->wait_next = 0;
-            waking->futex_wait_addr = 0;
-            waking->state = PROCESS_READY;
-            break; // Wake only one (like Linux FUTEX_WAKE with val=1)
-        }
+    if (size && (base + size < base || base + size > KERNEL_VIRT_BASE)) {
+        return -1;
     }
 
-    __asm__ volatile("sti");
-}
+    // Interrupts off: the scheduler must not switch us between the two steps
+    uint32_t flags = irq_save();
+    current_process->tls_base = size ? base : 0;
+    current_process->tls_size = size;
+    gdt_set_tls(cpu_id(), current_process->tls_base, size);
+    irq_restore(flags);
 
+    regs->gs = GDT_TLS_SEL;
+    return GDT_TLS_SEL;
+}
 
 // PID 1 Entry Point: Launches the Shell
 void launch_shell()
@@ -3,6 +3,9 @@
 
 #include <stdint.h>
 #include "../mm/vmm.h"
+#include "../fs/fs.h"
+#include "../cpu/fpu.h"
+#include "futex.h"
 
 typedef enum {
     PROCESS_READY,
@@ -11,6 +14,14 @@ typedef enum {
     PROCESS_BLOCKED // New state for sleeping/waiting
 } ProcessState;
 
+// Scheduling Priorities (higher = more important)
+// The scheduler always runs the READY task with the highest effective
+// priority on its CPU, round-robin among equals.
+#define PRIO_IDLE    0  // Idle tasks only (PID 0, per-CPU idle)
+#define PRIO_MIN     1
+#define PRIO_DEFAULT 10
+#define PRIO_MAX     31
+
 typedef struct process {
     uint32_t *esp;       // Stack Pointer (Saved when switching out)
     uint32_t stack[1024]; // 4KB Static Stack for this task
@@ -22,32 +33,64 @@ typedef struct process {
     struct process *next; // Next process in list
     struct process *prev; // Previous process in list
     struct process *wait_next; // Wait Queue (Semaphore/Mutex)
-    int *futex_wait_addr;      // Address this process is waiting on (NULL if not waiting)
+    futex_key_t futex_key;     // Futex word this task sleeps on (see futex.c)
+    struct futex_bucket *volatile futex_bucket; // Hash bucket it is queued in (NULL = not waiting)
+    struct process *futex_next; // Bucket wait list (FIFO, doubly linked)
+    struct process *futex_prev;
+    uint32_t futex_deadline;   // Tick at which the wait times out (0 = no timeout)
+    int futex_result;          // 0 = woken, FUTEX_ETIMEDOUT = timed out
+    struct syscall_ring *ring; // Registered batched syscall ring (NULL if none, see ring.h)
+    char spawn_path[FILENAME_MAX_LEN]; // Program to load on first run (sys_spawn only)
+    int fpu_used;              // 1 once fpu_state holds valid (saved or live) FPU/SSE registers
+    uint32_t cpu;              // CPU whose run queue holds this task (fixed for life, see sched_add)
+    volatile int on_cpu;       // 1 while a CPU still runs on this task's kernel stack
+    struct process *rq_next;   // Run Queue links (circular, per CPU)
+    struct process *rq_prev;
+    int prio;                  // Base priority (PRIO_*), set by sys_setprio
+    volatile int eff_prio;     // Effective priority: max(prio, PI-boosts from waiters)
+    struct process *volatile pi_owner; // Owner of the PI lock we block on (NULL = not blocked)
+    struct process *pi_waiters; // Tasks blocked on PI locks we own (linked by pi_next)
+    struct process *pi_next;
+    int exiting;               // Set under the PI lock once sys_exit has started
+    uint32_t tls_base;         // Thread-Local Storage segment (GDT_TLS_SEL), see sys_set_thread_area
+    uint32_t tls_size;         // 0 = none (flat segment)
+    uint8_t fpu_state[FPU_STATE_SIZE + FPU_STATE_ALIGN]; // FXSAVE area (see cpu/fpu.c, lazily saved)
 } process_t;
 
 #include "isr.h"
+#include "smp.h"
 
 // Globals
-extern process_t *current_process;
+// The task running on THIS CPU (per-CPU, see smp.h)
+#define current_process (this_cpu()->current)
 
 // Core Process Management
 void init_multitasking();
 void create_task(void (*function)());
 void schedule();
+void schedule_tail();
+void sched_add(process_t *p);
+void sched_wake(process_t *p);
 void block_process();
 void unblock_process(process_t *p);
+void sched_prio_changed(process_t *p);
+process_t *find_task(uint32_t pid);
 
 // System Calls
 int sys_fork(registers_t *regs);
 int sys_clone(registers_t *regs); // Kernel Thread
 int sys_execve(char *filename, char **argv, char **envp, registers_t *regs);
+int sys_spawn(char *filename); // New process running 'filename' (fork + exec in one step), a kernel string
 void sys_exit(int code);
+int sys_setprio(uint32_t tid, int prio); // tid 0 = caller, prio < 0 = only query; returns old priority
+int sys_set_thread_area(uint32_t base, uint32_t size, registers_t *regs); // Returns the %gs selector
 int sys_wait(int *status);
-int sys_futex_wait(int *addr, int val);  // Block if *addr == val
-void sys_futex_wake(int *addr);          // Wake one process waiting on addr
 
 // Other process-related functions
 void enter_user_mode(uint32_t entry_point);
+// Copy a user filename into 'out' (FILENAME_MAX_LEN bytes), checking every
+// page it touches. 0, or -1 if it is unmapped, kernel memory or too long.
+int copy_user_filename(uint32_t uaddr, char *out);
 void launch_shell();
 
 #endif
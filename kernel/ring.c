@@ -0,0 +1,104 @@
+#include "ring.h"
+#include "process.h"
+#include "futex.h"
+
+extern void print_buffer(char *str, unsigned int len);
+extern char keyboard_getchar();
+extern int sys_spawn(char *filename);
+
+// Check that [addr, addr + len) is mapped user memory of the current process
+static int user_range_ok(uint32_t addr, uint32_t len) {
+    uint32_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+    return vmm_is_user_range((page_directory*)P2V(cr3), addr, len);
+}
+
+// SYS_RING_SETUP: Register (or with NULL, unregister) the ring of the calling thread
+// Returns 0 on success, -1 on a bad pointer.
+int sys_ring_setup(syscall_ring_t *ring) {
+    if (ring == 0) {
+        current_process->ring = 0;
+        return 0;
+    }
+    if (!user_range_ok((uint32_t)ring, sizeof(syscall_ring_t))) {
+        return -1;
+    }
+
+    // Start from a clean, empty ring
+    ring->sq_head = 0;
+    ring->sq_tail = 0;
+    ring->cq_head = 0;
+    ring->cq_tail = 0;
+
+    current_process->ring = ring;
+    return 0;
+}
+
+// Execute one submission and return its result
+static int ring_execute(ring_sqe_t *sqe) {
+    switch (sqe->op) {
+        case RING_OP_NOP:
+            return 0;
+
+        case RING_OP_WRITE:
+            if (sqe->fd != 1) return -1;
+            if (!user_range_ok(sqe->addr, sqe->len)) return -1;
+            print_buffer((char*)sqe->addr, sqe->len);
+            return sqe->len;
+
+        case RING_OP_READ: {
+            if (sqe->fd != 0) return -1;
+            if (!user_range_ok(sqe->addr, sqe->len)) return -1;
+            char *buf = (char*)sqe->addr;
+            for (uint32_t i = 0; i < sqe->len; i++) {
+                buf[i] = keyboard_getchar(); // Blocks until a key arrives
+            }
+            return sqe->len;
+        }
+
+        case RING_OP_FUTEX_WAKE:
+            if (!user_range_ok(sqe->addr, sizeof(int))) return -1;
+            // len = number of waiters to wake (0 = one, like the old single wake)
+            return futex_wake((uint32_t*)sqe->addr, sqe->len ? (int)sqe->len : 1, 0);
+
+        case RING_OP_SPAWN: {
+            char name[FILENAME_MAX_LEN];
+            if (copy_user_filename(sqe->addr, name) != 0) return -1;
+            return sys_spawn(name);
+        }
+
+        default:
+            return -1;
+    }
+}
+
+// SYS_RING_ENTER: Consume up to 'to_submit' queued SQEs with a single trap.
+// Every consumed SQE produces exactly one CQE. Processing stops early if the
+// completion queue is full (the rest stays queued for the next call).
+// Returns the number of SQEs consumed, or -1 if no ring is registered.
+int sys_ring_enter(uint32_t to_submit) {
+    syscall_ring_t *ring = current_process->ring;
+    if (!ring) return -1;
+
+    int done = 0;
+    while (done < (int)to_submit) {
+        uint32_t head = ring->sq_head;
+        if (head == ring->sq_tail) break;                           // SQ empty
+        if (ring->cq_tail - ring->cq_head >= RING_ENTRIES) break;   // CQ full
+
+        // Copy the entry first: user space may refill the slot once sq_head moves
+        ring_sqe_t sqe = ring->sqes[head & (RING_ENTRIES - 1)];
+        ring->sq_head = head + 1;
+
+        int res = ring_execute(&sqe);
+
+        ring_cqe_t *cqe = &ring->cqes[ring->cq_tail & (RING_ENTRIES - 1)];
+        cqe->user_data = sqe.user_data;
+        cqe->res = res;
+        __asm__ volatile("" ::: "memory"); // CQE contents before publishing the tail
+        ring->cq_tail = ring->cq_tail + 1;
+
+        done++;
+    }
+    return done;
+}
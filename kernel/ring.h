@@ -0,0 +1,56 @@
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+#include "isr.h"
+
+// ---------------------------------------------------------
+// Batched Syscall Ring (io_uring-style)
+// ---------------------------------------------------------
+// A process places this structure in its own memory and registers it with
+// SYS_RING_SETUP. It then queues many operations (SQEs) and hands them all
+// to the kernel with a single SYS_RING_ENTER trap. Results come back as CQEs.
+//
+// Indices are free-running counters, masked with (RING_ENTRIES - 1):
+//   sq_tail: written by user,   sq_head: written by kernel
+//   cq_tail: written by kernel, cq_head: written by user
+//
+// NOTE: programs/lib.h carries a copy of this layout. Keep both in sync!
+
+#define RING_ENTRIES 32 // Must be a power of 2
+
+// Operations (ring_sqe_t.op)
+#define RING_OP_NOP        0
+#define RING_OP_WRITE      1 // fd, addr = buffer, len            -> res = bytes written
+#define RING_OP_READ       2 // fd, addr = buffer, len            -> res = bytes read
+#define RING_OP_FUTEX_WAKE 3 // addr = futex word, len = max waiters (0 = 1) -> res = number woken
+#define RING_OP_SPAWN      4 // addr = filename (NUL-terminated)  -> res = child PID or -1
+
+// Submission Queue Entry
+typedef struct {
+    uint32_t op;
+    int32_t  fd;
+    uint32_t addr;
+    uint32_t len;
+    uint32_t user_data; // Copied verbatim into the matching CQE
+} ring_sqe_t;
+
+// Completion Queue Entry
+typedef struct {
+    uint32_t user_data;
+    int32_t  res;       // Result (negative = error)
+} ring_cqe_t;
+
+typedef struct syscall_ring {
+    volatile uint32_t sq_head;
+    volatile uint32_t sq_tail;
+    volatile uint32_t cq_head;
+    volatile uint32_t cq_tail;
+    ring_sqe_t sqes[RING_ENTRIES];
+    ring_cqe_t cqes[RING_ENTRIES];
+} syscall_ring_t;
+
+int sys_ring_setup(syscall_ring_t *ring);
+int sys_ring_enter(uint32_t to_submit);
+
+#endif
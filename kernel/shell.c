@@ -77,13 +77,13 @@ void cmd_cat(char *filename) {
         return;
     }
 
-    sfs_inode inode;
-    if (fs_find_file(filename, &inode)) {
+    sfs_file_t file;
+    if (fs_open(filename, &file)) {
         // Allocate heap memory for file content
-        char *buf = (char*)kmalloc(inode.size + 1);
+        char *buf = (char*)kmalloc(file.inode.size + 1);
         if (buf) {
-            fs_read_file(&inode, buf);
-            buf[inode.size] = '\0'; // Null-terminate
+            int n = fs_read(&file, 0, file.inode.size, buf);
+            buf[n > 0 ? n : 0] = '\0'; // Null-terminate
             print_string(buf);
             print_string("\n");
             kfree(buf); // Free memory
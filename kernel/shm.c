@@ -0,0 +1,84 @@
+#include "shm.h"
+#include "process.h"
+#include "sync.h"
+#include "pmm.h"
+#include "vmm.h"
+
+extern void memset(void *dest, int val, int len);
+
+typedef struct {
+    int used;
+    uint32_t key;
+    uint32_t npages;
+    uint32_t frames[SHM_MAX_PAGES]; // The object holds one reference on each frame
+} shm_object_t;
+
+static shm_object_t shm_objects[SHM_MAX_OBJECTS];
+static irq_lock_t shm_lock; // Protects shm_objects (all zero = unlocked)
+
+// Find object 'key', or create it with 'npages' zeroed frames (shm_lock must be held)
+static shm_object_t *shm_get(uint32_t key, uint32_t npages)
+{
+    shm_object_t *free_slot = 0;
+
+    for (int i = 0; i < SHM_MAX_OBJECTS; i++) {
+        if (shm_objects[i].used && shm_objects[i].key == key) {
+            return &shm_objects[i];
+        }
+        if (!shm_objects[i].used && !free_slot) {
+            free_slot = &shm_objects[i];
+        }
+    }
+
+    if (!free_slot || npages == 0) return 0;
+
+    for (uint32_t i = 0; i < npages; i++) {
+        uint32_t frame = pmm_alloc_block();
+        if (!frame) {
+            while (i > 0) pmm_free_block(free_slot->frames[--i]);
+            return 0;
+        }
+        memset((void*)P2V(frame), 0, PAGE_SIZE);
+        free_slot->frames[i] = frame;
+    }
+
+    free_slot->key = key;
+    free_slot->npages = npages;
+    free_slot->used = 1;
+    return free_slot;
+}
+
+int sys_shm_map(uint32_t key, uint32_t addr, uint32_t size)
+{
+    uint32_t npages = (size + PAGE_SIZE - 1) / PAGE_SIZE;
+    if (npages > SHM_MAX_PAGES) return -1;
+    if (addr == 0 || (addr & (PAGE_SIZE - 1))) return -1;
+
+    irq_lock(&shm_lock);
+    shm_object_t *obj = shm_get(key, npages);
+    if (!obj || npages > obj->npages) {
+        irq_unlock(&shm_lock);
+        return -1;
+    }
+    if (npages == 0) npages = obj->npages; // size 0: map the whole existing object
+    irq_unlock(&shm_lock);
+
+    // The target range must be free user space (and must not wrap around)
+    uint32_t end = addr + npages * PAGE_SIZE;
+    if (end < addr || addr >= KERNEL_VIRT_BASE || end > KERNEL_VIRT_BASE) return -1;
+    page_directory *pd = (page_directory*)P2V((uint32_t)current_process->pd);
+    for (uint32_t i = 0; i < npages; i++) {
+        if (vmm_is_mapped(pd, addr + i * PAGE_SIZE)) return -1;
+    }
+
+    // Frames never leave the object, so no lock is needed past this point
+    for (uint32_t i = 0; i < npages; i++) {
+        uint32_t flags = I86_PTE_PRESENT | I86_PTE_WRITABLE | I86_PTE_USER | I86_PTE_SHARED;
+        if (!vmm_map_page_in_dir(pd, addr + i * PAGE_SIZE, obj->frames[i], flags)) {
+            return -1;
+        }
+        pmm_inc_ref(obj->frames[i]); // One more reference per mapping
+    }
+
+    return addr;
+}
@@ -0,0 +1,23 @@
+#ifndef SHM_H
+#define SHM_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Named Shared Memory
+// ---------------------------------------------------------
+// A shared object is a set of physical frames identified by a small integer
+// key. Any process can map it (at an address of its choice) with SYS_SHM_MAP.
+// The PTEs carry I86_PTE_SHARED: fork() keeps them shared and writable instead
+// of Copy-On-Write, and futexes inside them are keyed by physical frame.
+//
+// Objects live until reboot (like SysV shm that is never removed).
+
+#define SHM_MAX_OBJECTS 16
+#define SHM_MAX_PAGES   16 // 64KB per object
+
+// Map object 'key' (created zero-filled on first use with 'size' bytes) at the
+// page aligned user address 'addr'. Returns addr, or -1 on error.
+int sys_shm_map(uint32_t key, uint32_t addr, uint32_t size);
+
+#endif
@@ -0,0 +1,244 @@
+#include "smp.h"
+#include "vdso.h"
+#include "process.h"
+#include "../cpu/lapic.h"
+#include "../cpu/tss.h"
+#include "../cpu/sysenter.h"
+#include "../cpu/fpu.h"
+#include "../mm/vmm.h"
+#include "../mm/kheap.h"
+#include "../drivers/timer.h"
+#include "../cpu/idt.h"
+
+extern void print_string(char *str);
+extern void print_dec(int n);
+extern void memset(void *dest, int val, int len);
+extern void memory_copy(char *source, char *dest, int nbytes);
+
+extern uint32_t timer_hz;     // drivers/timer.c
+
+cpu_t cpus[MAX_CPUS];
+uint32_t ncpus = 1;
+
+// ---------------------------------------------------------
+// AP Boot Trampoline (kernel/ap_trampoline.asm)
+// ---------------------------------------------------------
+// APs wake up in Real Mode at (SIPI vector << 12), so the trampoline is copied
+// to a fixed page below 1MB. It switches to Protected Mode, turns on paging
+// with the kernel directory and calls ap_main() on its own stack.
+#define AP_TRAMPOLINE_PHYS 0x7000
+
+// Filled in by smp_init() inside the COPY of the trampoline (layout fixed in the asm)
+typedef struct {
+    uint32_t cr3;                 // Physical address of kernel_directory
+    uint32_t stack_base;          // Virtual address of ap_stacks (AP 'i' uses stack i)
+    uint32_t entry;               // ap_main
+    uint32_t max_index;           // APs with index >= this just halt
+    volatile uint32_t next_index; // Atomically incremented by every AP that wakes up
+} __attribute__((packed)) ap_boot_args_t;
+
+extern uint8_t ap_trampoline_start[];
+extern uint8_t ap_trampoline_end[];
+extern uint8_t ap_boot_args[];
+
+// Boot stacks (later: the idle task's stack) of the APs. Entry 0 is unused (BSP).
+#define AP_STACK_SIZE 4096
+static uint8_t ap_stacks[MAX_CPUS][AP_STACK_SIZE] __attribute__((aligned(16)));
+
+static volatile uint32_t aps_online = 0;
+static volatile int smp_go = 0; // BSP finished bring-up (identity map gone)
+
+// First C code on an AP (running on ap_stacks[index], interrupts off)
+void ap_main(uint32_t index)
+{
+    // 1. Per-CPU descriptor tables. After init_gdt(), cpu_id() == index.
+    init_gdt(index);
+    init_tss(index);
+    idt_load();
+
+    // 2. Per-CPU MSRs and control registers
+    init_sysenter();
+    init_fpu();
+    lapic_init();
+
+    cpu_t *cpu = &cpus[index];
+    cpu->id = index;
+    cpu->apic_id = lapic_id();
+
+    // 3. This boot context becomes the CPU's idle task
+    process_t *idle = (process_t *)kmalloc(sizeof(process_t));
+    memset(idle, 0, sizeof(process_t));
+    idle->id = 0;            // Like PID 0 on the BSP: not on process_list, never waited for
+    idle->parent_id = -1;
+    idle->state = PROCESS_RUNNING;
+    idle->pd = (page_directory *)V2P((uint32_t)kernel_directory);
+    idle->cpu = index;
+    idle->on_cpu = 1;
+
+    cpu->idle = idle;
+    cpu->current = idle;
+    tss_set_stack((uint32_t)(idle->stack + 1024));
+
+    __sync_synchronize();
+    cpu->online = 1;
+    __sync_fetch_and_add(&aps_online, 1);
+
+    // 4. Wait for the BSP to drop the temporary identity mapping,
+    //    then flush it from our TLB too.
+    while (!smp_go) {
+        __asm__ volatile("pause");
+    }
+    uint32_t cr3;
+    __asm__ volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) :: "memory");
+
+    // 5. Start time slicing on this CPU and idle until there is work
+    lapic_timer_start(timer_hz);
+    __asm__ volatile("sti");
+    while (1) {
+        __asm__ volatile("hlt");
+    }
+}
+
+// Start all Application Processors (BSP, interrupts off, after init_multitasking).
+void smp_init()
+{
+    cpu_t *bsp = &cpus[0];
+    bsp->id = 0;
+    bsp->online = 1;
+
+    if (!lapic_present()) {
+        print_string("SMP: No Local APIC, running on 1 CPU.\n");
+        return;
+    }
+
+    lapic_map();
+    lapic_init();
+    bsp->apic_id = lapic_id();
+    lapic_timer_calibrate();
+
+    // 1. Copy the trampoline below 1MB and fill in its parameters
+    uint32_t size = (uint32_t)(ap_trampoline_end - ap_trampoline_start);
+    memory_copy((char *)ap_trampoline_start, (char *)P2V(AP_TRAMPOLINE_PHYS), size);
+
+    ap_boot_args_t *args = (ap_boot_args_t *)P2V(AP_TRAMPOLINE_PHYS + (uint32_t)(ap_boot_args - ap_trampoline_start));
+    args->cr3 = V2P((uint32_t)kernel_directory);
+    args->stack_base = (uint32_t)ap_stacks;
+    args->entry = (uint32_t)ap_main;
+    args->max_index = MAX_CPUS;
+    args->next_index = 1;
+
+    // 2. Temporary identity mapping of 0-4MB: the trampoline enables paging
+    //    while still executing at 0x7000. (Must be gone before any process
+    //    directory is cloned, or fork would COW-share kernel memory.)
+    uint32_t kernel_pde = KERNEL_VIRT_BASE >> 22;
+    kernel_directory->m_entries[0] = kernel_directory->m_entries[kernel_pde];
+
+    // 3. INIT - SIPI - SIPI to every other CPU (Intel MP Spec B.4)
+    lapic_send_icr(0, ICR_ALL_BUT_SELF | ICR_INIT | ICR_LEVEL_ASSERT);
+    timer_delay_ms(10);
+    for (int i = 0; i < 2; i++) {
+        lapic_send_icr(0, ICR_ALL_BUT_SELF | ICR_STARTUP | (AP_TRAMPOLINE_PHYS >> 12));
+        timer_delay_ms(1);
+    }
+
+    // 4. Wait (up to 1s) until every AP that woke up has reached ap_main()
+    timer_delay_ms(10);
+    for (int waited = 0; waited < 1000; waited += 10) {
+        uint32_t woke = args->next_index - 1;
+        if (woke > MAX_CPUS - 1) woke = MAX_CPUS - 1;
+        if (aps_online == woke) break;
+        timer_delay_ms(10);
+    }
+    ncpus = 1 + aps_online;
+    vdso_set_ncpus(ncpus);
+
+    // 5. Drop the identity mapping and release the APs
+    kernel_directory->m_entries[0] = 0;
+    uint32_t cr3;
+    __asm__ volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) :: "memory");
+    smp_go = 1;
+
+    print_string("SMP: ");
+    print_dec(ncpus);
+    print_string(" CPU(s) online.\n");
+}
+
+// Make 'cpu' look at its run queue now instead of at its next timer tick,
+// because a task of priority 'prio' bound to it just became READY and the CPU
+// is idling in 'hlt' or running something less important.
+void smp_kick(uint32_t cpu, int prio)
+{
+    if (cpu == cpu_id() || !cpus[cpu].online) return;
+    struct process *cur = cpus[cpu].current;
+    if (cur != cpus[cpu].idle && cur->eff_prio >= prio) return; // The next tick is soon enough
+
+    uint32_t flags = irq_save();
+    lapic_send_ipi(cpus[cpu].apic_id, IPI_RESCHED_VECTOR);
+    irq_restore(flags);
+}
+
+// ---------------------------------------------------------
+// TLB Shootdown
+// ---------------------------------------------------------
+// Page table changes are only visible to the CPU that made them (its own
+// 'invlpg' / CR3 reload). Other CPUs running threads of the same address
+// space may still cache the old translation, so they have to flush too.
+// Call AFTER updating the page tables, holding no spinlock.
+void tlb_shootdown(uint32_t pd_phys)
+{
+    if (ncpus < 2) return;
+
+    uint32_t me = cpu_id();
+    uint32_t flags = irq_save();
+    uint32_t targets = 0;
+
+    for (uint32_t i = 0; i < ncpus; i++) {
+        if (i == me || !cpus[i].online) continue;
+        process_t *cur = cpus[i].current;
+        // A CPU that switches into this directory later reloads CR3 anyway
+        if (cur && (uint32_t)cur->pd == pd_phys) {
+            cpus[i].tlb_flush_pending = 1;
+            targets |= (1 << i);
+            lapic_send_ipi(cpus[i].apic_id, IPI_TLB_VECTOR);
+        }
+    }
+
+    // Wait for the flushes. Keep serving OUR pending flushes meanwhile:
+    // another CPU may be waiting on us the same way (both with interrupts off).
+    for (uint32_t i = 0; i < ncpus; i++) {
+        if (!(targets & (1 << i))) continue;
+        while (cpus[i].tlb_flush_pending) {
+            __asm__ volatile("pause");
+            smp_poll_ipi();
+        }
+    }
+
+    irq_restore(flags);
+}
+
+// Called from spin loops (interrupts possibly off) and the TLB IPI handler
+void smp_poll_ipi()
+{
+    if (ncpus < 2) return;
+
+    cpu_t *cpu = this_cpu();
+    if (cpu->tlb_flush_pending) {
+        uint32_t cr3;
+        __asm__ volatile("mov %%cr3, %0; mov %0, %%cr3" : "=r"(cr3) :: "memory");
+        cpu->tlb_flush_pending = 0;
+    }
+}
+
+// Vector IPI_TLB_VECTOR
+void smp_tlb_handler()
+{
+    smp_poll_ipi();
+    lapic_eoi();
+}
+
+// Vector IPI_RESCHED_VECTOR
+void smp_resched_handler()
+{
+    lapic_eoi();
+    schedule();
+}
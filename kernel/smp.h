@@ -0,0 +1,49 @@
+#ifndef SMP_H
+#define SMP_H
+
+#include <stdint.h>
+#include "spinlock.h"
+#include "../cpu/gdt.h"
+
+// ---------------------------------------------------------
+// Per-CPU Data
+// ---------------------------------------------------------
+// cpus[0] is the BSP (the CPU that ran the bootloader), cpus[1..] are the
+// APs started by smp_init(). Each CPU only ever touches its own entry,
+// except for the run queue (under rq_lock) and the IPI flags.
+
+struct process;
+
+typedef struct cpu {
+    uint32_t id;                 // Index into cpus[] (= cpu_id())
+    uint32_t apic_id;            // Local APIC ID (IPI destination)
+    volatile int online;         // 1 once the CPU runs its scheduler
+
+    struct process *current;     // Task running on this CPU (see current_process)
+    struct process *idle;        // Runs when nothing on the run queue is ready
+    struct process *prev;        // Task just switched away from (finished by schedule_tail)
+
+    // Run Queue: circular list (process_t.rq_next / rq_prev) of every task
+    // bound to this CPU. A task stays on the queue while it sleeps; schedule()
+    // simply skips whatever is not READY/RUNNING.
+    struct process *rq_head;
+    uint32_t nr_tasks;           // Queue length (new tasks go to the shortest queue)
+    volatile uint32_t rq_lock;   // Raw spinlock, held across switch_task
+
+    volatile uint32_t tlb_flush_pending; // Set by tlb_shootdown(), cleared after the flush
+} cpu_t;
+
+extern cpu_t cpus[MAX_CPUS];
+extern uint32_t ncpus;
+
+static inline cpu_t *this_cpu() {
+    return &cpus[cpu_id()];
+}
+
+void smp_init();
+void smp_kick(uint32_t cpu, int prio);
+void tlb_shootdown(uint32_t pd_phys);
+void smp_tlb_handler();
+void smp_resched_handler();
+
+#endif
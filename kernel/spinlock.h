@@ -0,0 +1,49 @@
+#ifndef SPINLOCK_H
+#define SPINLOCK_H
+
+#include <stdint.h>
+
+// ---------------------------------------------------------
+// Raw Spinlock (no interrupt handling)
+// ---------------------------------------------------------
+// Building block for irq_lock_t (sync.h) and the per-CPU run queue lock.
+// The caller is responsible for interrupts: a spinlock that can also be
+// taken from an interrupt handler must only be held with interrupts off.
+
+// Handle IPI work that cannot wait while we spin with interrupts off (kernel/smp.c)
+extern void smp_poll_ipi();
+
+static inline void spin_lock(volatile uint32_t *lock) {
+    while (__sync_lock_test_and_set(lock, 1)) {
+        // Spin on a plain read (no bus locking) until it looks free
+        while (*lock) {
+            __asm__ volatile("pause");
+            smp_poll_ipi();
+        }
+    }
+}
+
+static inline int spin_trylock(volatile uint32_t *lock) {
+    return __sync_lock_test_and_set(lock, 1) == 0;
+}
+
+static inline void spin_unlock(volatile uint32_t *lock) {
+    __sync_lock_release(lock); // Store 0 with release semantics
+}
+
+// EFLAGS helpers
+#define EFLAGS_IF 0x200
+
+static inline uint32_t irq_save() {
+    uint32_t flags;
+    __asm__ volatile("pushf; pop %0; cli" : "=r"(flags) :: "memory");
+    return flags;
+}
+
+static inline void irq_restore(uint32_t flags) {
+    if (flags & EFLAGS_IF) {
+        __asm__ volatile("sti" ::: "memory");
+    }
+}
+
+#endif
@@ -1,30 +1,47 @@
 #include "sync.h"
 
 // --- IRQ Lock Implementation ---
-// On a single-core system (UP), locking = disabling interrupts (cli/sti).
-// This is NOT a true spinlock — it does not busy-wait.
+// cli keeps this CPU's interrupt handlers out, the spin keeps other CPUs out.
 
 void irq_lock_init(irq_lock_t *lock) {
     lock->locked = 0;
+    lock->flags = 0;
 }
 
 void irq_lock(irq_lock_t *lock) {
-    __asm__ volatile("cli");
-    // In SMP, we would spin here: while (__sync_lock_test_and_set(&lock->locked, 1));
-    lock->locked = 1; 
+    uint32_t flags = irq_save();
+    spin_lock(&lock->locked);
+    lock->flags = flags; // Only written by the holder
 }
 
 void irq_unlock(irq_lock_t *lock) {
-    lock->locked = 0;
-    __asm__ volatile("sti");
+    uint32_t flags = lock->flags;
+    spin_unlock(&lock->locked);
+    irq_restore(flags);
 }
 
-// --- Semaphore Implementation ---
-
 extern void block_process();
 extern void schedule();
 extern void unblock_process(process_t *p);
-extern process_t *current_process; // Need access to current process
+
+// Sleep with 'lock' held by the caller, who has already put itself on a wait
+// queue that the waker scans under the same lock.
+// The lock is dropped with interrupts still off, so nothing on THIS CPU can
+// run between "BLOCKED" and schedule(). A waker on another CPU can only mark
+// us READY in that window, which schedule() honours (we just keep running).
+void irq_lock_sleep(irq_lock_t *lock) {
+    uint32_t flags = lock->flags;
+
+    current_process->state = PROCESS_BLOCKED;
+    spin_unlock(&lock->locked);
+
+    schedule();
+
+    spin_lock(&lock->locked);
+    lock->flags = flags; // Caller's original interrupt state, for its irq_unlock()
+}
+
+// --- Semaphore Implementation ---
 
 void sem_init(semaphore_t *sem, int value) {
     sem->value = value;
@@ -34,15 +51,9 @@ void sem_init(semaphore_t *sem, int value) {
 }
 
 void sem_wait(semaphore_t *sem) {
-    while (1) {
-        irq_lock(&sem->lock); // Disable Interrupts
-
-        if (sem->value > 0) {
-            sem->value--;
-            irq_unlock(&sem->lock); // Enable Interrupts
-            return;
-        }
+    irq_lock(&sem->lock);
 
+    while (sem->value <= 0) {
         // Value is 0. We must wait.
         // 1. Add current process to wait queue
         current_process->wait_next = 0;
@@ -54,19 +65,15 @@ void sem_wait(semaphore_t *sem) {
             sem->wait_tail = current_process;
         }
 
-        // Critical Section: Add to queue -> Unlock -> Sleep
-        // We must release the logical lock so signal() can work,
-        // but keep interrupts disabled (CLI) to prevent Lost Wakeup.
-        sem->lock.locked = 0; 
-        
-        current_process->state = PROCESS_BLOCKED;
-        
-        // Context Switch (Re-enables interrupts in next task)
-        schedule(); 
+        // 2. Unlock -> Sleep -> Relock (atomically w.r.t. sem_signal, see irq_lock_sleep)
+        irq_lock_sleep(&sem->lock);
 
         // Woken up by signal(). 
         // Loop back to re-check value because another process might have stolen it (Mesa Semantics).
     }
+
+    sem->value--;
+    irq_unlock(&sem->lock);
 }
 
 void sem_signal(semaphore_t *sem) {
@@ -89,16 +96,145 @@ void sem_signal(semaphore_t *sem) {
     irq_unlock(&sem->lock);
 }
 
+// --- Priority Inheritance ---
+
+static irq_lock_t pi_graph_lock; // All zero = unlocked
+
+void pi_lock() {
+    irq_lock(&pi_graph_lock);
+}
+
+void pi_unlock() {
+    irq_unlock(&pi_graph_lock);
+}
+
+// Recompute p's effective priority from its base priority and its waiters.
+// If it changed and p is itself blocked, its owner may change too, and so on.
+void pi_update(process_t *p) {
+    for (int depth = 0; p && depth < PI_CHAIN_MAX; depth++) {
+        int prio = p->prio;
+        for (process_t *w = p->pi_waiters; w; w = w->pi_next) {
+            if (w->eff_prio > prio) prio = w->eff_prio;
+        }
+        if (prio == p->eff_prio) break;
+
+        int boosted = prio > p->eff_prio;
+        p->eff_prio = prio;
+        if (boosted) sched_prio_changed(p);
+
+        p = p->pi_owner;
+    }
+}
+
+// Block the current task on the PI lock 'key' held by 'owner'.
+// Called and returns with the PI lock held (dropped while asleep).
+// Returns 0 once the owner handed the lock to us, FUTEX_EOWNERDEAD if the
+// owner exited first (the caller should look at the lock again).
+int pi_block_on(process_t *owner, futex_key_t *key) {
+    process_t *me = current_process;
+
+    me->futex_key = *key;
+    me->futex_result = 0;
+    me->pi_owner = owner;
+    me->pi_next = owner->pi_waiters;
+    owner->pi_waiters = me;
+    pi_update(owner); // Boost the owner (and whoever it waits for)
+
+    while (me->pi_owner) {
+        irq_lock_sleep(&pi_graph_lock);
+    }
+    return me->futex_result;
+}
+
+static inline int pi_key_match(futex_key_t *a, futex_key_t *b) {
+    return a->base == b->base && a->offset == b->offset;
+}
+
+// The current task releases the PI lock 'key': hand it to the waiter with the
+// highest effective priority (oldest first among equals) and move the other
+// waiters of that lock over to the new owner. Drops our own boost.
+// Returns the new owner (already woken) or NULL if nobody waits.
+// *more = 1 if other waiters remain on the lock.
+process_t *pi_handoff(futex_key_t *key, int *more) {
+    process_t *me = current_process;
+    process_t *best = 0;
+
+    // Newest waiters are at the head: '>=' keeps the oldest of equal priority
+    for (process_t *w = me->pi_waiters; w; w = w->pi_next) {
+        if (pi_key_match(&w->futex_key, key) && (!best || w->eff_prio >= best->eff_prio)) {
+            best = w;
+        }
+    }
+
+    *more = 0;
+    if (!best) return 0;
+
+    // Unlink every waiter of this lock: 'best' gets it, the rest wait on 'best'
+    process_t **link = &me->pi_waiters;
+    while (*link) {
+        process_t *w = *link;
+        if (!pi_key_match(&w->futex_key, key)) {
+            link = &w->pi_next;
+            continue;
+        }
+        *link = w->pi_next;
+        if (w != best) {
+            w->pi_owner = best;
+            w->pi_next = best->pi_waiters;
+            best->pi_waiters = w;
+            *more = 1;
+        }
+    }
+
+    best->pi_next = 0;
+    best->futex_result = 0;
+    best->pi_owner = 0;
+
+    pi_update(me);
+    pi_update(best);
+    sched_wake(best);
+    return best;
+}
+
+// sys_exit: wake everything blocked on PI locks 'p' still holds. They find
+// the lock owned by a dead task and take it over.
+void pi_owner_exit(process_t *p) {
+    pi_lock();
+    p->exiting = 1; // find_task() no longer returns p
+    while (p->pi_waiters) {
+        process_t *w = p->pi_waiters;
+        p->pi_waiters = w->pi_next;
+        w->pi_next = 0;
+        w->futex_result = FUTEX_EOWNERDEAD;
+        w->pi_owner = 0;
+        sched_wake(w);
+    }
+    pi_unlock();
+}
+
 // --- Mutex Implementation ---
 
 void mutex_init(mutex_t *mutex) {
-    sem_init(&mutex->sem, 1); // Binary Semaphore (starts at 1)
     mutex->owner = 0;
 }
 
 void mutex_lock(mutex_t *mutex) {
-    sem_wait(&mutex->sem);
-    mutex->owner = current_process;
+    // Kernel PI key: the mutex address (bit 1 keeps it apart from user keys)
+    futex_key_t key = { (uint32_t)mutex | 2, 0 };
+
+    pi_lock();
+    while (mutex->owner != current_process) {
+        if (!mutex->owner) {
+            mutex->owner = current_process;
+            break;
+        }
+        process_t *owner = mutex->owner;
+        if (pi_block_on(owner, &key) == 0) break; // Unlock handed it to us
+
+        // The owner exited holding it: treat the mutex as free
+        if (mutex->owner == owner) mutex->owner = 0;
+    }
+    pi_unlock();
 }
 
 void mutex_unlock(mutex_t *mutex) {
@@ -106,7 +242,11 @@ void mutex_unlock(mutex_t *mutex) {
     if (mutex->owner != current_process) {
         return; 
     }
-    
-    mutex->owner = 0;
-    sem_signal(&mutex->sem);
+
+    futex_key_t key = { (uint32_t)mutex | 2, 0 };
+    int more;
+
+    pi_lock();
+    mutex->owner = pi_handoff(&key, &more); // NULL if nobody waits
+    pi_unlock();
 }
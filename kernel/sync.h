@@ -2,18 +2,22 @@
 #define SYNC_H
 
 #include <stdint.h>
+#include "spinlock.h"
 #include "process.h"
 
-// 1. IRQ Lock (Interrupt Disable Lock)
-// On a single-core system, 'locking' = disabling interrupts (cli/sti).
-// NOT a spinlock — does not busy-wait. Named accurately.
+// 1. IRQ Lock (Interrupt-Safe Spinlock)
+// Disables interrupts on this CPU (so an interrupt handler can't deadlock on it)
+// AND spins until no other CPU holds it.
+// irq_unlock() restores the interrupt state saved by irq_lock(), so locks nest.
 typedef struct {
-    uint32_t locked; // 0=Unlocked, 1=Locked
+    volatile uint32_t locked; // 0=Unlocked, 1=Locked
+    uint32_t flags;           // Holder's EFLAGS before irq_lock() (IF bit restored on unlock)
 } irq_lock_t;
 
 void irq_lock_init(irq_lock_t *lock);
 void irq_lock(irq_lock_t *lock);
 void irq_unlock(irq_lock_t *lock);
+void irq_lock_sleep(irq_lock_t *lock); // Release, block, re-acquire (no lost wakeup)
 
 // 2. Semaphore (Blocking Wait)
 typedef struct {
@@ -27,10 +31,25 @@ void sem_init(semaphore_t *sem, int value);
 void sem_wait(semaphore_t *sem);   // P() or down()
 void sem_signal(semaphore_t *sem); // V() or up()
 
-// 3. Mutex (Binary Semaphore)
+// 3. Priority Inheritance
+// A task blocked on a PI lock sits on the owner's pi_waiters list, and every
+// owner runs at the highest effective priority of the tasks (transitively)
+// waiting for it. Used by the kernel mutex_t and by PI futexes (futex.c).
+// One global lock protects this wait-for graph; PI paths are all slow paths.
+#define PI_CHAIN_MAX 8 // Boost propagation depth (also bounds lock cycles)
+
+void pi_lock();
+void pi_unlock();
+void pi_update(process_t *p);                          // Recompute p's eff_prio and propagate
+int pi_block_on(process_t *owner, futex_key_t *key);  // Sleep until the lock is handed to us
+process_t *pi_handoff(futex_key_t *key, int *more);   // Give our lock 'key' to its best waiter
+void pi_owner_exit(process_t *p);                      // Release waiters of a dying owner
+
+// 4. Mutex (Priority Inheritance)
+// Ownership is handed directly to the most important waiter on unlock, and
+// the owner is boosted while more important tasks wait.
 typedef struct {
-    semaphore_t sem;
-    process_t *owner; // Debugging info
+    process_t *volatile owner; // NULL = Unlocked
 } mutex_t;
 
 void mutex_init(mutex_t *mutex);
@@ -0,0 +1,123 @@
+#include "vdso.h"
+#include "pmm.h"
+#include "sysenter.h"
+#include "../cpu/gdt.h"
+
+extern void print_string(char *str);
+extern void print_hex(uint32_t n);
+extern void memset(void *dest, int val, int len);
+
+// Defined in drivers/timer.c
+extern uint32_t tick;
+extern uint32_t timer_hz;
+
+// Physical frame backing the shared page, and its kernel (P2V) alias.
+static uint32_t vdso_frame = 0;
+static vdso_data_t *vdso = 0;
+
+static inline uint64_t rdtsc() {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+// CPUID.1:EDX bit 4 = Time Stamp Counter
+static int cpu_has_tsc() {
+    uint32_t eax = 1, ebx, ecx, edx;
+    __asm__ volatile("cpuid" : "+a"(eax), "=b"(ebx), "=c"(ecx), "=d"(edx));
+    return (edx >> 4) & 1;
+}
+
+// Allocate and fill the shared page (call after pmm_init, before any process exists)
+void vdso_init() {
+    vdso_frame = pmm_alloc_block();
+    if (!vdso_frame) {
+        print_string("VDSO: Error: Out of Memory!\n");
+        return;
+    }
+    // The frame keeps this initial reference forever. Every process mapping adds one
+    // more (pmm_inc_ref), and vmm_free_directory() only drops the process's own share.
+
+    vdso = (vdso_data_t*)P2V(vdso_frame);
+    memset(vdso, 0, PAGE_SIZE);
+
+    vdso->version = VDSO_VERSION;
+    vdso->tick_hz = timer_hz;
+    if (cpu_has_tsc()) {
+        vdso->features |= VDSO_FEAT_TSC;
+    }
+    if (sysenter_enabled) {
+        vdso->features |= VDSO_FEAT_SYSENTER;
+    }
+    vdso->ncpus = 1; // Raised by smp_init() once the APs are up
+    vdso->magic = VDSO_MAGIC;
+
+    print_string("VDSO: Shared page at 0x");
+    print_hex(VDSO_USER_ADDR);
+    print_string(" (Frame 0x");
+    print_hex(vdso_frame);
+    print_string(")\n");
+}
+
+// Map the shared page Read-Only into a user address space.
+// Safe to call more than once: an existing mapping is left alone.
+// Returns 1 on success, 0 on failure.
+int vdso_map(page_directory *dir) {
+    if (!vdso_frame) return 0;
+    if (vmm_is_mapped(dir, VDSO_USER_ADDR)) return 1;
+
+    // Present | User, but NOT Writable -> a stray user write faults instead of
+    // corrupting the page. vmm_clone_directory() shares it as-is (no COW bit).
+    if (!vmm_map_page_in_dir(dir, VDSO_USER_ADDR, vdso_frame, I86_PTE_PRESENT | I86_PTE_USER)) {
+        return 0;
+    }
+    pmm_inc_ref(vdso_frame);
+    return 1;
+}
+
+// Called from the timer interrupt on every tick.
+void vdso_update_clock() {
+    if (!vdso) return;
+
+    // Seqlock write side: make seq odd, update, make it even again.
+    vdso->seq++;
+    __asm__ volatile("" ::: "memory");
+
+    vdso->ticks = tick;
+
+    if (vdso->features & VDSO_FEAT_TSC) {
+        uint64_t now = rdtsc();
+        uint64_t last = ((uint64_t)vdso->tsc_hi << 32) | vdso->tsc_lo;
+
+        if (last != 0) {
+            // One tick is far below 2^32 cycles, so 32-bit math is enough here.
+            uint32_t delta = (uint32_t)(now - last);
+
+            // Calibrate against the PIT: first sample seeds the value,
+            // later samples are smoothed (new = old * 7/8 + delta / 8).
+            if (vdso->tsc_per_tick == 0) {
+                vdso->tsc_per_tick = delta;
+            } else {
+                vdso->tsc_per_tick = vdso->tsc_per_tick - (vdso->tsc_per_tick >> 3) + (delta >> 3);
+            }
+        }
+
+        vdso->tsc_lo = (uint32_t)now;
+        vdso->tsc_hi = (uint32_t)(now >> 32);
+    }
+
+    __asm__ volatile("" ::: "memory");
+    vdso->seq++;
+}
+
+// Called by the scheduler whenever a new process gets the CPU.
+// Each CPU owns its own slot, so no locking is needed.
+void vdso_set_current(uint32_t pid) {
+    if (!vdso) return;
+    vdso->pid[cpu_id()] = pid;
+}
+
+void vdso_set_ncpus(uint32_t n) {
+    if (!vdso) return;
+    vdso->ncpus = n;
+}
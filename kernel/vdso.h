@@ -0,0 +1,53 @@
+#ifndef VDSO_H
+#define VDSO_H
+
+#include <stdint.h>
+#include "../mm/vmm.h"
+
+// ---------------------------------------------------------
+// vDSO-style Shared Info Page
+// ---------------------------------------------------------
+// One physical frame, written only by the kernel, mapped Read-Only + User
+// at the same virtual address in every process. User programs read the
+// clock and their own PID from it without trapping into the kernel.
+//
+// NOTE: programs/lib.h carries a copy of this layout (vdso_data_t).
+//       Keep both definitions in sync!
+
+// Last user page, just below the 3GB kernel boundary (PDE 767)
+#define VDSO_USER_ADDR   0xBFFFF000
+
+#define VDSO_MAGIC       0x6F736476 // "vdso"
+#define VDSO_VERSION     2
+#define VDSO_MAX_CPUS    8  // Must match MAX_CPUS (cpu/gdt.h)
+
+// Feature bits (vdso_data_t.features)
+#define VDSO_FEAT_TSC      0x1 // tsc_* fields are valid (CPU has RDTSC)
+#define VDSO_FEAT_SYSENTER 0x2 // Kernel accepts SYSENTER (see cpu/sysenter.c)
+
+typedef struct {
+    uint32_t magic;                 // VDSO_MAGIC once the page is initialized
+    uint32_t version;               // VDSO_VERSION
+    uint32_t features;              // VDSO_FEAT_* bits
+    uint32_t tick_hz;               // Timer frequency (PIT ticks per second)
+
+    // Seqlock: odd while the kernel is updating the clock fields below.
+    // Readers retry until they see the same even value before and after.
+    volatile uint32_t seq;
+    volatile uint32_t ticks;        // Timer ticks since boot
+    volatile uint32_t tsc_lo;       // TSC value sampled at the last tick
+    volatile uint32_t tsc_hi;
+    volatile uint32_t tsc_per_tick; // Calibrated TSC cycles per tick (0 = not calibrated yet)
+
+    // Scheduler info (updated on every context switch)
+    volatile uint32_t ncpus;                // Number of CPUs online
+    volatile uint32_t pid[VDSO_MAX_CPUS];   // PID currently running on each CPU
+} vdso_data_t;
+
+void vdso_init();
+int vdso_map(page_directory *dir);
+void vdso_update_clock();
+void vdso_set_current(uint32_t pid);
+void vdso_set_ncpus(uint32_t n);
+
+#endif
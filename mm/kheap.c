@@ -1,6 +1,7 @@
 #include "kheap.h"
 #include "pmm.h" // For null definition if needed, or just 0
 #include "vmm.h" // If we need to map pages dynamically (done statically for now)
+#include "../kernel/spinlock.h"
 
 extern uint32_t _kernel_end;
 extern void print_string(char* str);
@@ -12,6 +13,8 @@ static uint32_t heap_start = 0;
 static uint32_t heap_end = 0;
 // Head of the free list
 static header_t *free_list = 0;
+// Protects the free list (kmalloc/kfree run on every CPU)
+static volatile uint32_t kheap_lock = 0;
 
 void kheap_init() {
     // 1. Determine Heap Location dynamically
@@ -39,8 +42,7 @@ void kheap_init() {
     print_string(" (Size: 1MB)\n");
 }
 
-void *kmalloc(uint32_t size) {
-    if (size == 0) return 0;
+static void *kmalloc_locked(uint32_t size) {
 
     // Align size to 4 bytes boundary
     // e.g., size 3 -> 4, size 5 -> 8
@@ -96,9 +98,7 @@ void *kmalloc(uint32_t size) {
     return 0;
 }
 
-void kfree(void *ptr) {
-    if (!ptr) return;
-
+static void kfree_locked(void *ptr) {
     // Get header from data pointer
     header_t *block = (header_t*)((uint32_t)ptr - sizeof(header_t));
 
@@ -136,3 +136,24 @@ void kfree(void *ptr) {
         }
     }
 }
+
+void *kmalloc(uint32_t size) {
+    if (size == 0) return 0;
+
+    uint32_t flags = irq_save();
+    spin_lock(&kheap_lock);
+    void *ptr = kmalloc_locked(size);
+    spin_unlock(&kheap_lock);
+    irq_restore(flags);
+    return ptr;
+}
+
+void kfree(void *ptr) {
+    if (!ptr) return;
+
+    uint32_t flags = irq_save();
+    spin_lock(&kheap_lock);
+    kfree_locked(ptr);
+    spin_unlock(&kheap_lock);
+    irq_restore(flags);
+}
@@ -1,4 +1,5 @@
 #include "pmm.h"
+#include "../kernel/spinlock.h"
 
 // External function from kernel.c (or define in a header common to both)
 extern void print_string(char* str);
@@ -18,6 +19,9 @@ static uint32_t used_memory_blocks = 0;
 #define MAX_BLOCKS (BITMAP_SIZE * 8)
 static uint8_t memory_refcounts[MAX_BLOCKS]; // 256KB for 1GB RAM
 
+// Protects the bitmap, refcounts and counters (all CPUs allocate frames)
+static volatile uint32_t pmm_lock = 0;
+
 // Helper: Set bit (Mark Used)
 void mmap_set(uint32_t bit) {
     memory_bitmap[bit / 8] |= (1 << (bit % 8));
@@ -216,9 +220,14 @@ void pmm_init(uint32_t kernel_end) {
 }
 
 uint32_t pmm_alloc_block() {
+    uint32_t flags = irq_save();
+    spin_lock(&pmm_lock);
+
     int frame = mmap_first_free();
     
     if (frame == -1) {
+        spin_unlock(&pmm_lock);
+        irq_restore(flags);
         print_string("Error: Out of Memory!\n");
         return 0; // Return NULL
     }
@@ -226,13 +235,66 @@ uint32_t pmm_alloc_block() {
     mmap_set(frame);
     memory_refcounts[frame] = 1; // Initialize Refcount
     used_memory_blocks++;
+
+    spin_unlock(&pmm_lock);
+    irq_restore(flags);
     
     uint32_t addr = frame * PMM_BLOCK_SIZE;
     return addr;
 }
 
+// Allocate 'count' physically contiguous blocks, the first one aligned to
+// 'align' blocks (a power of two, 1 = any). For devices that DMA into a range
+// without an IOMMU. Free with pmm_free_blocks(). Returns 0 if no run is free.
+uint32_t pmm_alloc_blocks(uint32_t count, uint32_t align) {
+    if (count == 0 || align == 0) return 0;
+
+    uint32_t flags = irq_save();
+    spin_lock(&pmm_lock);
+
+    uint32_t limit = total_memory_blocks < MAX_BLOCKS ? total_memory_blocks : MAX_BLOCKS;
+    uint32_t start = 0;
+    while (start + count <= limit) {
+        // First used block in [start, start + count), if any
+        uint32_t i = 0;
+        while (i < count && !mmap_test(start + i)) i++;
+        if (i == count) break;
+
+        // Restart past it, at the next aligned block
+        start = (start + i + align) & ~(align - 1);
+    }
+
+    if (start + count > limit) {
+        spin_unlock(&pmm_lock);
+        irq_restore(flags);
+        print_string("Error: No contiguous run of ");
+        print_dec(count);
+        print_string(" blocks!\n");
+        return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++) {
+        mmap_set(start + i);
+        memory_refcounts[start + i] = 1;
+    }
+    used_memory_blocks += count;
+
+    spin_unlock(&pmm_lock);
+    irq_restore(flags);
+
+    return start * PMM_BLOCK_SIZE;
+}
+
+void pmm_free_blocks(uint32_t addr, uint32_t count) {
+    for (uint32_t i = 0; i < count; i++) {
+        pmm_free_block(addr + i * PMM_BLOCK_SIZE);
+    }
+}
+
 void pmm_free_block(uint32_t addr) {
     uint32_t frame = addr / PMM_BLOCK_SIZE;
+    uint32_t flags = irq_save();
+    spin_lock(&pmm_lock);
     
     if (memory_refcounts[frame] > 0) {
         memory_refcounts[frame]--;
@@ -243,13 +305,20 @@ void pmm_free_block(uint32_t addr) {
         mmap_unset(frame);
         used_memory_blocks--;
     }
+
+    spin_unlock(&pmm_lock);
+    irq_restore(flags);
 }
 
 // Reference Counting API
 void pmm_inc_ref(uint32_t addr) {
     uint32_t frame = addr / PMM_BLOCK_SIZE;
     if (frame < MAX_BLOCKS) {
+        uint32_t flags = irq_save();
+        spin_lock(&pmm_lock);
         memory_refcounts[frame]++;
+        spin_unlock(&pmm_lock);
+        irq_restore(flags);
     }
 }
 
@@ -261,6 +330,11 @@ uint8_t pmm_get_ref(uint32_t addr) {
     return 0;
 }
 
+// Blocks currently free (a snapshot: other CPUs keep allocating)
+uint32_t pmm_free_count() {
+    return total_memory_blocks - used_memory_blocks;
+}
+
 void pmm_print_stats() {
     print_string("PMM Stats: Used: ");
     print_dec(used_memory_blocks);
@@ -276,6 +350,9 @@ void pmm_deinit_region(uint32_t start_addr, uint32_t size) {
 
     if (size % PMM_BLOCK_SIZE) blocks++;
 
+    uint32_t flags = irq_save();
+    spin_lock(&pmm_lock);
+
     for (; blocks > 0; blocks--) {
         if (!mmap_test(align)) {
              mmap_set(align);
@@ -284,4 +361,7 @@ void pmm_deinit_region(uint32_t start_addr, uint32_t size) {
         }
         align++;
     }
+
+    spin_unlock(&pmm_lock);
+    irq_restore(flags);
 }
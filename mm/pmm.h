@@ -20,6 +20,10 @@ void pmm_init(uint32_t kernel_end);
 uint32_t pmm_alloc_block();
 void pmm_free_block(uint32_t addr);
 
+// Physically contiguous runs (DMA buffers). align = alignment in blocks (power of two)
+uint32_t pmm_alloc_blocks(uint32_t count, uint32_t align);
+void pmm_free_blocks(uint32_t addr, uint32_t count);
+
 // Reserve a specific memory region (Mark as used)
 void pmm_deinit_region(uint32_t start_addr, uint32_t size);
 
@@ -27,6 +31,9 @@ void pmm_deinit_region(uint32_t start_addr, uint32_t size);
 void pmm_inc_ref(uint32_t addr);
 uint8_t pmm_get_ref(uint32_t addr);
 
+// Free blocks right now (for sizing caches)
+uint32_t pmm_free_count();
+
 // Debug function to print memory stats
 void pmm_print_stats();
 
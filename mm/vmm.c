@@ -1,6 +1,7 @@
 #include "vmm.h"
 #include "pmm.h"
 #include "../kernel/sync.h"
+#include "../kernel/vdso.h"
 
 // Global lock to protect page directory reference counting
 irq_lock_t pd_ref_lock;
@@ -96,6 +97,46 @@ int vmm_is_mapped(page_directory* dir, uint32_t virt) {
     
     return (table->m_entries[pt_index] & I86_PTE_PRESENT);
 }
+
+pt_entry vmm_get_pte(page_directory* dir, uint32_t virt) {
+    uint32_t pd_index = virt >> 22;
+    uint32_t pt_index = (virt >> 12) & 0x03FF;
+
+    if (!(dir->m_entries[pd_index] & I86_PTE_PRESENT)) return 0;
+
+    page_table* table = (page_table*)P2V(dir->m_entries[pd_index] & I86_PTE_FRAME);
+    return table->m_entries[pt_index];
+}
+
+uint32_t vmm_virt_to_phys(uint32_t virt) {
+    uint32_t cr3;
+    __asm__ volatile("mov %%cr3, %0" : "=r"(cr3));
+
+    pt_entry pte = vmm_get_pte((page_directory*)P2V(cr3), virt);
+    if (!(pte & I86_PTE_PRESENT)) return 0;
+    return (pte & I86_PTE_FRAME) | (virt & (PAGE_SIZE - 1));
+}
+
+// Check if [virt, virt + len) lies below the kernel and every page in it is mapped
+// with the User bit. Used to validate pointers passed in by user programs.
+int vmm_is_user_range(page_directory* dir, uint32_t virt, uint32_t len) {
+    uint32_t end = virt + len;
+    if (end < virt || end > KERNEL_VIRT_BASE) return 0; // Overflow or kernel space
+
+    for (uint32_t page = virt & I86_PTE_FRAME; page < end; page += PAGE_SIZE) {
+        uint32_t pd_index = page >> 22;
+        uint32_t pt_index = (page >> 12) & 0x03FF;
+
+        if (!(dir->m_entries[pd_index] & I86_PTE_PRESENT)) return 0;
+
+        page_table* table = (page_table*)P2V(dir->m_entries[pd_index] & I86_PTE_FRAME);
+        pt_entry pte = table->m_entries[pt_index];
+        if (!(pte & I86_PTE_PRESENT) || !(pte & I86_PTE_USER)) return 0;
+
+        if (page + PAGE_SIZE < page) break; // Last page of the address space
+    }
+    return 1;
+}
 void vmm_init() {
     irq_lock_init(&pd_ref_lock);
 
@@ -200,8 +241,8 @@ uint32_t vmm_clone_directory(page_directory* src) {
                 uint32_t frame_phys = src_table->m_entries[j] & I86_PTE_FRAME;
                 uint32_t pte_flags = src_table->m_entries[j] & 0x0FFF;
 
-                // Check if Writable
-                if (pte_flags & I86_PTE_WRITABLE) {
+                // Check if Writable (Shared memory stays writable in both)
+                if ((pte_flags & I86_PTE_WRITABLE) && !(pte_flags & I86_PTE_SHARED)) {
                     // Mark Read-Only and set COW bit
                     pte_flags &= ~I86_PTE_WRITABLE;
                     pte_flags |= I86_PTE_COW;
@@ -230,6 +271,13 @@ uint32_t vmm_clone_directory(page_directory* src) {
     if (V2P((uint32_t)src) == current_cr3) {
         __asm__ volatile("mov %0, %%cr3" :: "r"(current_cr3));
     }
+    // Threads of 'src' running on other CPUs may still cache the Writable entries
+    tlb_shootdown(V2P((uint32_t)src));
+
+    // 3. Shared vDSO Page
+    // Normally inherited from 'src' by the loop above (Read-Only pages are shared
+    // without COW). Map it explicitly for clones of directories that lack it (PID 0).
+    vdso_map(dir);
 
     return dir_phys; // Return Physical Address
 }
@@ -16,6 +16,7 @@
 #define I86_PTE_PAT           0x80  // Page Attribute Table
 #define I86_PTE_GLOBAL        0x100 // Global Page (ignored in 4KB)
 #define I86_PTE_COW           0x200 // Available for OS (Bit 9) - Copy On Write
+#define I86_PTE_SHARED        0x400 // Available for OS (Bit 10) - Shared memory (fork never COWs it)
 #define I86_PTE_FRAME         0xFFFFF000 // Frame address mask (Top 20 bits)
 
 // Paging Structure Sizes
@@ -90,9 +91,20 @@ int vmm_map_page_in_dir(page_directory* dir, uint32_t virt, uint32_t phys, uint3
 // Check if a virtual address is mapped in the directory
 int vmm_is_mapped(page_directory* dir, uint32_t virt);
 
+// Get the Page Table Entry for a virtual address (0 if no Page Table)
+pt_entry vmm_get_pte(page_directory* dir, uint32_t virt);
+
+// Check if [virt, virt + len) is mapped User Space memory (for syscall pointer arguments)
+int vmm_is_user_range(page_directory* dir, uint32_t virt, uint32_t len);
+
+// Physical address behind a mapped virtual address of the current address
+// space (kernel or user), for handing buffers to DMA engines. 0 if unmapped.
+uint32_t vmm_virt_to_phys(uint32_t virt);
+
 // --- Address Translation Helpers ---
 
 #define KERNEL_VIRT_BASE 0xC0000000
+#define KERNEL_DIRECT_MAP_SIZE 0x08000000 // Physical 0-128MB at KERNEL_VIRT_BASE (vmm_init)
 
 // Convert Physical Address to Virtual Address (Simple addition)
 static inline uint32_t P2V(uint32_t phys) {
@@ -2,6 +2,57 @@
 
 int global_var = 100;
 
+// Shared memory test: parent and child map the same object at DIFFERENT
+// addresses and bump one counter under a mutex that lives inside it.
+// The mutex only works if both processes' futex calls meet in the kernel.
+#define SHM_KEY         1
+#define SHM_PARENT_ADDR ((void *)0x01000000)
+#define SHM_CHILD_ADDR  ((void *)0x01100000)
+#define SHM_ITERATIONS  10000
+
+typedef struct {
+    user_mutex_t lock;
+    int counter;
+} shared_t;
+
+void shm_worker(shared_t *s) {
+    for (int i = 0; i < SHM_ITERATIONS; i++) {
+        mutex_lock(&s->lock);
+        s->counter++;
+        mutex_unlock(&s->lock);
+    }
+}
+
+void shm_test() {
+    print("\nShared Memory Test Starting...\n");
+    shared_t *s = (shared_t *)shm_map(SHM_KEY, SHM_PARENT_ADDR, 4096);
+    if (!s) {
+        print("SHM TEST FAILED: shm_map\n");
+        return;
+    }
+    mutex_init_shared(&s->lock);
+    s->counter = 0;
+
+    int pid = fork();
+    if (pid == 0) {
+        shared_t *c = (shared_t *)shm_map(SHM_KEY, SHM_CHILD_ADDR, 0);
+        if (!c) exit(1);
+        shm_worker(c);
+        exit(0);
+    }
+
+    shm_worker(s);
+    wait(0);
+
+    print("Parent: shared counter = "); print_dec(s->counter);
+    print(" (Should be "); print_dec(2 * SHM_ITERATIONS); print(")\n");
+    if (s->counter == 2 * SHM_ITERATIONS) {
+        print("SHM TEST PASSED: Cross-process mutex over shared memory.\n");
+    } else {
+        print("SHM TEST FAILED: Lost updates.\n");
+    }
+}
+
 void main() {
     print("COW Fork Test Starting...\n");
     print("Parent: global_var = "); print_dec(global_var); print("\n");
@@ -29,6 +80,8 @@ void main() {
         } else {
             print("COW TEST FAILED: Parent's memory was corrupted.\n");
         }
+
+        shm_test();
         
         exit(0);
     }
@@ -0,0 +1,111 @@
+#include "lib.h"
+
+// SimpleFS write path test: create, append, truncate (grow and shrink),
+// fsync, read back, unlink. Two files appended to in turns get a new extent
+// per block, more than fit in the inode, so the overflow block is used too.
+
+#define FS_TEST_FILE "fs_test.txt"
+#define FS_FRAG_A    "fs_frag_a.txt"
+#define FS_FRAG_B    "fs_frag_b.txt"
+#define FS_BLOCK     512
+#define FS_FRAG_ROUNDS 40 // Extents per fragmented file (the inode holds 26)
+
+static char data[FS_FRAG_ROUNDS * FS_BLOCK];
+static char back[FS_FRAG_ROUNDS * FS_BLOCK + 1];
+static int failures = 0;
+
+static void check(int ok, char *what) {
+    if (!ok) {
+        print("FS TEST FAILED: ");
+        print(what);
+        print("\n");
+        failures++;
+    }
+}
+
+// Byte 'i' of every file written here (seed tells the files apart)
+static char pattern(int seed, int i) {
+    return 'a' + (seed + i) % 26;
+}
+
+static void fill(int seed, int from, int len) {
+    for (int i = 0; i < len; i++) data[i] = pattern(seed, from + i);
+}
+
+// 'name' must be exactly 'size' bytes: the pattern up to 'written', zeros after
+static int verify(char *name, int seed, int written, int size) {
+    if (readfile(name, 0, back, size + 1) != size) return 0;
+    for (int i = 0; i < size; i++) {
+        char want = i < written ? pattern(seed, i) : 0;
+        if (back[i] != want) return 0;
+    }
+    return 1;
+}
+
+void main() {
+    print("SimpleFS Write Test Starting...\n");
+
+    // 1. Create, then append across the first block boundary
+    check(creat(FS_TEST_FILE) == 0, "creat");
+    check(readfile(FS_TEST_FILE, 0, back, 16) == 0, "new file is empty");
+    fill(1, 0, 300);
+    check(append(FS_TEST_FILE, data, 300) == 300, "append 300");
+    fill(1, 300, 400);
+    check(append(FS_TEST_FILE, data, 400) == 400, "append 400 (crosses a block)");
+    check(verify(FS_TEST_FILE, 1, 700, 700), "read back 700 bytes");
+    check(readfile(FS_TEST_FILE, 500, back, 100) == 100 && back[0] == pattern(1, 500),
+          "read at an offset");
+
+    // 2. Truncate: grow with zeros, then shrink into the first block
+    check(truncate(FS_TEST_FILE, 1500) == 0, "truncate to grow");
+    check(verify(FS_TEST_FILE, 1, 700, 1500), "grown file reads zeros");
+    check(truncate(FS_TEST_FILE, 100) == 0, "truncate to shrink");
+    check(verify(FS_TEST_FILE, 1, 100, 100), "shrunk file");
+
+    // 3. Flush, then read it again the way the shell's cat does
+    check(fsync() == 0, "fsync");
+    print("cat "); print(FS_TEST_FILE); print(": ");
+    check(cat(FS_TEST_FILE) == 100, "cat");
+    print("\n");
+
+    // 4. Fragment two files: each block lands behind the other file's last
+    // one, so every append starts a new extent and the overflow block fills
+    check(creat(FS_FRAG_A) == 0 && creat(FS_FRAG_B) == 0, "creat fragmented files");
+    for (int r = 0; r < FS_FRAG_ROUNDS; r++) {
+        fill(2, r * FS_BLOCK, FS_BLOCK);
+        check(append(FS_FRAG_A, data, FS_BLOCK) == FS_BLOCK, "append to A");
+        fill(3, r * FS_BLOCK, FS_BLOCK);
+        check(append(FS_FRAG_B, data, FS_BLOCK) == FS_BLOCK, "append to B");
+    }
+    check(verify(FS_FRAG_A, 2, FS_FRAG_ROUNDS * FS_BLOCK, FS_FRAG_ROUNDS * FS_BLOCK), "read back A");
+    check(verify(FS_FRAG_B, 3, FS_FRAG_ROUNDS * FS_BLOCK, FS_FRAG_ROUNDS * FS_BLOCK), "read back B");
+
+    // 5. Shrink A back under the inode's extents (drops its overflow block),
+    // grow it again (new blocks from the allocator, zero filled)
+    check(truncate(FS_FRAG_A, 10 * FS_BLOCK + 7) == 0, "shrink A");
+    check(verify(FS_FRAG_A, 2, 10 * FS_BLOCK + 7, 10 * FS_BLOCK + 7), "shrunk A");
+    check(truncate(FS_FRAG_A, 30 * FS_BLOCK) == 0, "grow A");
+    check(verify(FS_FRAG_A, 2, 10 * FS_BLOCK + 7, 30 * FS_BLOCK), "regrown A");
+    check(verify(FS_FRAG_B, 3, FS_FRAG_ROUNDS * FS_BLOCK, FS_FRAG_ROUNDS * FS_BLOCK), "B untouched");
+    check(fsync() == 0, "fsync after fragmenting");
+
+    // 6. Unlink everything: the names are gone, the blocks can be reused
+    check(unlink(FS_TEST_FILE) == 0, "unlink");
+    check(unlink(FS_FRAG_A) == 0 && unlink(FS_FRAG_B) == 0, "unlink fragmented files");
+    check(readfile(FS_TEST_FILE, 0, back, 16) == -1, "unlinked file is gone");
+    check(unlink(FS_TEST_FILE) == -1, "second unlink fails");
+
+    // 7. One big append into the freed space
+    fill(4, 0, sizeof(data));
+    check(append(FS_TEST_FILE, data, sizeof(data)) == sizeof(data), "append into freed blocks");
+    check(verify(FS_TEST_FILE, 4, sizeof(data), sizeof(data)), "read back after reuse");
+    check(unlink(FS_TEST_FILE) == 0, "final unlink");
+    check(fsync() == 0, "final fsync");
+
+    if (failures == 0) {
+        print("FS TEST PASSED: create, append, truncate, fsync, read back, unlink.\n");
+    } else {
+        print("FS TEST FAILED: "); print_dec(failures); print(" checks.\n");
+    }
+    exit(failures ? 1 : 0);
+}
@@ -0,0 +1,82 @@
+// green_demo.c
+// Green threads demo: 1000 coroutines on a handful of kernel threads.
+//
+// Each worker coroutine bumps a shared counter and yields, ROUNDS times.
+// A collector coroutine awaits (green_join) every worker, then sets an event
+// that a reporter coroutine is awaiting. 1000 kernel threads would need 1000
+// PCBs and kernel stacks; here a coroutine costs a green_t and 1KB of stack.
+
+#include "lib.h"
+
+#define NUM_WORKERS  1000
+#define ROUNDS       10
+#define WORKER_STACK 1024
+
+green_t workers[NUM_WORKERS];
+char worker_stacks[NUM_WORKERS][WORKER_STACK] __attribute__((aligned(16)));
+
+green_t collector, reporter;
+char collector_stack[4096] __attribute__((aligned(16)));
+char reporter_stack[4096] __attribute__((aligned(16)));
+
+green_event_t all_done;
+volatile int counter = 0;
+
+void worker(void *arg)
+{
+    for (int i = 0; i < ROUNDS; i++) {
+        __sync_fetch_and_add(&counter, 1);
+        green_yield();
+    }
+}
+
+void collect(void *arg)
+{
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        green_join(&workers[i]);
+    }
+    green_event_set(&all_done);
+}
+
+void report(void *arg)
+{
+    green_event_wait(&all_done);
+
+    print("All ");
+    print_dec(NUM_WORKERS);
+    print(" workers joined. Counter: ");
+    print_dec(counter);
+    print(" (expected ");
+    print_dec(NUM_WORKERS * ROUNDS);
+    print(")\n");
+}
+
+int main()
+{
+    print("=== Green Threads: ");
+    print_dec(NUM_WORKERS);
+    print(" coroutines x ");
+    print_dec(ROUNDS);
+    print(" yields ===\n");
+
+    green_event_init(&all_done);
+    green_spawn(&reporter, report, 0, reporter_stack, sizeof(reporter_stack));
+    green_spawn(&collector, collect, 0, collector_stack, sizeof(collector_stack));
+    for (int i = 0; i < NUM_WORKERS; i++) {
+        green_spawn(&workers[i], worker, 0, worker_stacks[i], WORKER_STACK);
+    }
+
+    unsigned int start_ms = uptime_ms();
+    green_run(0); // One carrier per CPU
+    unsigned int elapsed_ms = uptime_ms() - start_ms;
+
+    print("Carriers: ");
+    print_dec(getncpus() < GREEN_MAX_CARRIERS ? getncpus() : GREEN_MAX_CARRIERS);
+    print(", switches: ");
+    print_dec(green_switches());
+    print(", time: ");
+    print_dec(elapsed_ms);
+    print(" ms\n");
+
+    exit(counter == NUM_WORKERS * ROUNDS ? 0 : 1);
+}
@@ -8,6 +8,9 @@
 void main() {
     print("Hello from User Space! (Ring 3)\n");
     print("This is a real C program loaded from disk.\n");
+    // Both values come from the vDSO page (no syscall)
+    print("PID: "); print_dec(getpid());
+    print(", Uptime: "); print_dec(uptime_ms()); print(" ms\n");
     //while(1);
     // We must call exit(), otherwise execution falls off data (crash)
     exit(0);
@@ -2,17 +2,60 @@
 // lib.c - Minimal C Library for User Programs
 #include "lib.h"
 
-// System Call Wrapper
-int syscall(int eax, int ebx, int ecx, int edx) {
+// System Call Entry: INT 0x80 (Always available)
+// EAX = Number, EBX/ECX/EDX/ESI/EDI = Arguments
+static int syscall_int80(int eax, int ebx, int ecx, int edx, int esi, int edi) {
     int ret;
     __asm__ volatile (
         "int $0x80"
         : "=a" (ret)
-        : "a" (eax), "b" (ebx), "c" (ecx), "d" (edx)
+        : "a" (eax), "b" (ebx), "c" (ecx), "d" (edx), "S" (esi), "D" (edi)
+        : "memory"
+    );
+    return ret;
+}
+
+// System Call Entry: SYSENTER (Fast Path, no interrupt frame)
+// Same registers as INT 0x80, plus:
+//   EBP = our ESP, pointing at [Return EIP, Saved EBP]
+// SYSEXIT returns with ESP = EBP + 4 and clobbers ECX/EDX (user ESP/EIP).
+static int syscall_sysenter(int eax, int ebx, int ecx, int edx, int esi, int edi) {
+    int ret;
+    __asm__ volatile (
+        "push %%ebp\n"       // EBP is the frame pointer: save it by hand
+        "push $1f\n"         // Return address for SYSEXIT
+        "mov %%esp, %%ebp\n" // Tell the kernel where our stack is
+        "sysenter\n"
+        "1:\n"
+        "pop %%ebp\n"
+        : "=a" (ret), "+c" (ecx), "+d" (edx)
+        : "0" (eax), "b" (ebx), "S" (esi), "D" (edi)
+        : "memory", "cc"
     );
     return ret;
 }
 
+static int syscall_probe(int eax, int ebx, int ecx, int edx, int esi, int edi);
+
+// Chosen once per program, on the first syscall
+static int (*syscall_entry)(int, int, int, int, int, int) = syscall_probe;
+
+// First syscall: ask the vDSO page whether the kernel set up SYSENTER
+static int syscall_probe(int eax, int ebx, int ecx, int edx, int esi, int edi) {
+    vdso_data_t *v = (vdso_data_t *)VDSO_USER_ADDR;
+    if (v->magic == VDSO_MAGIC && (v->features & VDSO_FEAT_SYSENTER)) {
+        syscall_entry = syscall_sysenter;
+    } else {
+        syscall_entry = syscall_int80;
+    }
+    return syscall_entry(eax, ebx, ecx, edx, esi, edi);
+}
+
+// System Call Wrapper
+int syscall(int eax, int ebx, int ecx, int edx) {
+    return syscall_entry(eax, ebx, ecx, edx, 0, 0);
+}
+
 // 1. I/O Functions
 char getchar() {
     char c;
@@ -46,50 +89,52 @@ void print(char *str) {
     //while(1);
 }
 
-void print_dec(int n) {
-    if (n == 0) {
-        putchar('0');
-        return;
-    }
+// Convert n to a decimal string. Returns the length (without the NUL).
+int format_dec(char *buf, int n) {
+    char tmp[12];
+    int i = 0, len = 0;
+    unsigned int u = n;
 
     if (n < 0) {
-        putchar('-');
-        n = -n;
+        buf[len++] = '-';
+        u = 0u - (unsigned int)n;
     }
 
-    char buffer[12];
-    int i = 0;
-    while (n > 0) {
-        buffer[i++] = (n % 10) + '0';
-        n /= 10;
-    }
+    do {
+        tmp[i++] = (u % 10) + '0';
+        u /= 10;
+    } while (u > 0);
 
-    // Reverse print
+    // Reverse into the output
     while (i > 0) {
-        putchar(buffer[--i]);
+        buf[len++] = tmp[--i];
     }
+    buf[len] = '\0';
+    return len;
+}
+
+// Format into a local buffer first: ONE write syscall per number, not one per digit
+void print_dec(int n) {
+    char buffer[12];
+    int len = format_dec(buffer, n);
+    syscall(1, 1, (int)buffer, len);
 }
 
 void print_hex(int n) {
-    putchar('0');
-    putchar('x');
-    if (n == 0) {
-        putchar('0');
-        return;
-    }
+    char buffer[11] = {'0', 'x'};
+    unsigned int u = n;
+    int len = 2;
 
-    char buffer[10];
-    int i = 0;
-    while (n > 0) {
-        int rem = n % 16;
-        if (rem < 10) buffer[i++] = rem + '0';
-        else buffer[i++] = (rem - 10) + 'A';
-        n /= 16;
-    }
+    // Count the digits (at least one)
+    int digits = 1;
+    while (digits < 8 && (u >> (digits * 4)) != 0) digits++;
 
-    while (i > 0) {
-        putchar(buffer[--i]);
+    for (int d = digits - 1; d >= 0; d--) {
+        int rem = (u >> (d * 4)) & 0xF;
+        if (rem < 10) buffer[len++] = rem + '0';
+        else buffer[len++] = (rem - 10) + 'A';
     }
+    syscall(1, 1, (int)buffer, len);
 }
 
 // 2. String Functions
@@ -124,28 +169,290 @@ void ls() {
     syscall(13, 0, 0, 0); // SYS_LS: kernel calls fs_list_files()
 }
 
+void sysstat(int reset) {
+    syscall(14, reset, 0, 0); // SYS_SYSSTAT: per-syscall counters + latency histograms
+}
+
+// 3-1. vDSO Functions (No Syscall)
+// The kernel keeps a Read-Only page at VDSO_USER_ADDR up to date:
+// the timer interrupt publishes ticks + a TSC sample, the scheduler publishes the PID.
+
+static vdso_data_t *vdso_page() {
+    vdso_data_t *v = (vdso_data_t *)VDSO_USER_ADDR;
+    if (v->magic != VDSO_MAGIC) return 0;
+    return v;
+}
+
+unsigned int uptime_ms() {
+    vdso_data_t *v = vdso_page();
+    if (!v || v->tick_hz == 0) return 0;
+
+    unsigned int seq, ticks, tsc_lo, tsc_per_tick;
+    unsigned int ms_per_tick = 1000 / v->tick_hz;
+
+    // Seqlock read side: retry if the timer interrupt updated the page meanwhile
+    do {
+        seq = v->seq;
+        __asm__ volatile("" ::: "memory");
+        ticks = v->ticks;
+        tsc_lo = v->tsc_lo;
+        tsc_per_tick = v->tsc_per_tick;
+        __asm__ volatile("" ::: "memory");
+    } while ((seq & 1) || seq != v->seq);
+
+    unsigned int ms = ticks * ms_per_tick;
+
+    // Interpolate inside the current tick with the TSC
+    if ((v->features & VDSO_FEAT_TSC) && tsc_per_tick) {
+        unsigned int now_lo, now_hi;
+        __asm__ volatile("rdtsc" : "=a"(now_lo), "=d"(now_hi));
+        unsigned int delta = now_lo - tsc_lo;
+        if (delta > tsc_per_tick) delta = tsc_per_tick; // Tick is late, don't run ahead
+        ms += (delta * ms_per_tick) / tsc_per_tick;
+    }
+    return ms;
+}
+
+// The kernel puts the CPU number in the limit of GDT selector 0x33 (DPL 3),
+// so LSL reads it from Ring 3 without a trap (same trick as Linux's vgetcpu).
+int getcpu() {
+    unsigned int cpu = 0;
+    __asm__ volatile("lsl %1, %0" : "=r"(cpu) : "r"(0x33), "0"(0));
+    return cpu;
+}
+
+int getncpus() {
+    vdso_data_t *v = vdso_page();
+    if (!v || v->ncpus == 0) return 1;
+    return v->ncpus;
+}
+
+unsigned long long rdtsc() {
+    vdso_data_t *v = vdso_page();
+    if (!v || !(v->features & VDSO_FEAT_TSC)) return 0;
+    unsigned int lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((unsigned long long)hi << 32) | lo;
+}
+
+// Uses the kernel's TSC calibration (cycles per timer tick)
+unsigned int tsc_to_us(unsigned long long cycles) {
+    vdso_data_t *v = vdso_page();
+    if (!v || v->tick_hz == 0 || v->tsc_per_tick == 0) return 0;
+
+    unsigned int per_us = v->tsc_per_tick / (1000000 / v->tick_hz);
+    if (per_us == 0) return 0;
+
+    // 64/32 division without libgcc: the quotient must fit in 32 bits
+    unsigned int hi = (unsigned int)(cycles >> 32), lo = (unsigned int)cycles;
+    if (hi >= per_us) return 0xFFFFFFFF;
+    unsigned int q, r;
+    __asm__("divl %4" : "=a"(q), "=d"(r) : "a"(lo), "d"(hi), "rm"(per_us));
+    return q;
+}
+
+int getpid() {
+    vdso_data_t *v = vdso_page();
+    if (!v) return -1;
+    // Threads never migrate, so our CPU's slot still holds our PID
+    // even if we were preempted between these two reads.
+    return v->pid[getcpu() & (VDSO_MAX_CPUS - 1)];
+}
+
+int spawn(char *filename) {
+    return syscall(17, (int)filename, 0, 0); // SYS_SPAWN: fork + exec in one step
+}
+
+// Shared memory: every process that maps the same key sees the same frames,
+// and futexes (sem_wait, a mutex from mutex_init_shared, ...) inside it work
+// across processes.
+void *shm_map(int key, void *addr, unsigned int size) {
+    int ret = syscall(19, key, (int)addr, size);
+    if (ret == -1) return 0;
+    return (void *)ret;
+}
+
+int setprio(int tid, int prio) {
+    return syscall(20, tid, prio, 0); // SYS_SETPRIO
+}
+
+// Files (SimpleFS)
+int creat(char *filename) {
+    return syscall(22, (int)filename, 0, 0); // SYS_CREAT
+}
+
+int append(char *filename, void *buf, unsigned int len) {
+    return syscall(23, (int)filename, (int)buf, len); // SYS_APPEND
+}
+
+int truncate(char *filename, unsigned int size) {
+    return syscall(24, (int)filename, size, 0); // SYS_TRUNCATE
+}
+
+int unlink(char *filename) {
+    return syscall(25, (int)filename, 0, 0); // SYS_UNLINK
+}
+
+int fsync() {
+    return syscall(26, 0, 0, 0); // SYS_FSYNC
+}
+
+int readfile(char *filename, unsigned int offset, void *buf, unsigned int len) {
+    return syscall_entry(27, (int)filename, offset, (int)buf, len, 0); // SYS_READFILE
+}
+
+int cat(char *filename) {
+    char buf[256];
+    unsigned int offset = 0;
+    int n;
+    while ((n = readfile(filename, offset, buf, sizeof(buf))) > 0) {
+        syscall(1, 1, (int)buf, n);
+        offset += n;
+    }
+    return n < 0 ? -1 : (int)offset;
+}
+
+// 3-2. Batched Syscall Ring
+// All SQEs queued since the last submit are executed by ONE ring_enter trap,
+// so N small operations cost 1 kernel entry instead of N.
+
+int ring_setup(syscall_ring_t *ring) {
+    return syscall(15, (int)ring, 0, 0); // SYS_RING_SETUP
+}
+
+ring_sqe_t *ring_get_sqe(syscall_ring_t *ring) {
+    unsigned int tail = ring->sq_tail;
+    if (tail - ring->sq_head >= RING_ENTRIES) return 0; // SQ full: submit first
+
+    ring_sqe_t *sqe = &ring->sqes[tail & (RING_ENTRIES - 1)];
+    sqe->op = RING_OP_NOP;
+    sqe->fd = 0;
+    sqe->addr = 0;
+    sqe->len = 0;
+    sqe->user_data = 0;
+
+    // The kernel only looks at the SQ inside ring_submit(),
+    // so the entry can be published now and filled in afterwards.
+    ring->sq_tail = tail + 1;
+    return sqe;
+}
+
+int ring_submit(syscall_ring_t *ring) {
+    unsigned int pending = ring->sq_tail - ring->sq_head;
+    if (pending == 0) return 0;
+    return syscall(16, pending, 0, 0); // SYS_RING_ENTER
+}
+
+ring_cqe_t *ring_peek_cqe(syscall_ring_t *ring) {
+    if (ring->cq_head == ring->cq_tail) return 0;
+    return &ring->cqes[ring->cq_head & (RING_ENTRIES - 1)];
+}
+
+void ring_cqe_seen(syscall_ring_t *ring) {
+    ring->cq_head = ring->cq_head + 1;
+}
+
+void ring_flush(syscall_ring_t *ring) {
+    // Loop: the kernel stops early when the CQ is full
+    while (ring->sq_tail != ring->sq_head) {
+        ring->cq_head = ring->cq_tail; // Discard completions to make room
+        if (ring_submit(ring) <= 0) break;
+    }
+    ring->cq_head = ring->cq_tail;
+}
+
+void ring_prep_write(ring_sqe_t *sqe, int fd, char *buf, int len) {
+    sqe->op = RING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = (unsigned int)buf;
+    sqe->len = len;
+}
+
+void ring_prep_read(ring_sqe_t *sqe, int fd, char *buf, int len) {
+    sqe->op = RING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = (unsigned int)buf;
+    sqe->len = len;
+}
+
+void ring_prep_futex_wake(ring_sqe_t *sqe, volatile int *addr, int n) {
+    sqe->op = RING_OP_FUTEX_WAKE;
+    sqe->addr = (unsigned int)addr;
+    sqe->len = n;
+}
+
+void ring_prep_spawn(ring_sqe_t *sqe, char *filename) {
+    sqe->op = RING_OP_SPAWN;
+    sqe->addr = (unsigned int)filename;
+}
+
+void ring_print(syscall_ring_t *ring, char *str) {
+    ring_sqe_t *sqe = ring_get_sqe(ring);
+    if (!sqe) {
+        ring_flush(ring);
+        sqe = ring_get_sqe(ring);
+    }
+    ring_prep_write(sqe, 1, str, strlen(str));
+}
+
 // 4. Thread Functions
+// First code of every thread_create thread: install its TLS block, run func
+static void thread_start(void (*func)(void*), void *arg, tls_block_t *tls) {
+    tls_init(tls);
+    func(arg);
+    exit(0);
+}
+
 // thread_create: Create a new thread
 // func: Function to run
 // arg: Argument to pass to func
-// stack: Stack pointer for the new thread
+// stack: Stack pointer for the new thread (its TLS block is carved from the top)
 int thread_create(void (*func)(void*), void *arg, void *stack) {
-    int *user_stack = (int *)stack;
+    tls_block_t *tls = (tls_block_t *)(((unsigned int)stack - sizeof(tls_block_t)) & ~15u);
+    int *user_stack = (int *)tls;
     
-    // Setup initial stack frame for the thread (cdecl calling convention)
-    *(--user_stack) = 0;               // dummy argument (for exit)
-    *(--user_stack) = (int)arg;        // Argument for func
-    *(--user_stack) = (int)exit;       // Return address (thread will call exit() when func returns)
+    // Setup initial stack frame for thread_start (cdecl calling convention)
+    *(--user_stack) = (int)tls;        // Arguments for thread_start
+    *(--user_stack) = (int)arg;
+    *(--user_stack) = (int)func;
+    *(--user_stack) = 0;               // Return address (thread_start never returns)
     
     // 1. Call clone system call
     // Syscall 10: CLONE
     // Arg 1 (EBX): Initialized Stack Pointer
     // Arg 2 (ECX): Thread Entry Point
-    int ret = syscall(10, (int)user_stack, (int)func, 0);
+    int ret = syscall(10, (int)user_stack, (int)thread_start, 0);
     
     return ret;
 }
 
+// 4-1. Thread-Local Storage
+
+int set_thread_area(void *base, unsigned int size) {
+    return syscall(21, (int)base, size, 0); // SYS_SET_THREAD_AREA (also loads %gs)
+}
+
+void tls_init(tls_block_t *block) {
+    block->self = block;
+    block->tid = getpid();
+    for (int i = 0; i < TLS_SLOTS; i++) block->slots[i] = 0;
+    set_thread_area(block, sizeof(tls_block_t));
+}
+
+static tls_block_t tls_main_block;
+static volatile int tls_next_key = 0;
+
+// Only the main thread gets here: every other thread installs its block in thread_start
+void tls_init_main() {
+    tls_init(&tls_main_block);
+}
+
+int tls_key_create() {
+    int key = __sync_fetch_and_add(&tls_next_key, 1);
+    if (key >= TLS_SLOTS) return -1;
+    return key;
+}
+
 // 5. Synchronization Primitives
 void spin_lock(volatile int *lock) {
     // Atomic 'xchg' instruction: Writes 1 to lock and returns the previous value.
@@ -162,30 +469,123 @@ void spin_unlock(volatile int *lock) {
     __sync_lock_release(lock);
 }
 
-// 6. Hybrid Mutex (Futex-style)
+// 5-1. Futex
+// EBX = addr, ECX = op, EDX = val, ESI = val2, EDI = addr2, EBP = val3
+
+int futex_wait(volatile int *addr, int val, unsigned int timeout_ms) {
+    return syscall_entry(18, (int)addr, FUTEX_WAIT, val, timeout_ms, 0);
+}
+
+int futex_wake(volatile int *addr, int n) {
+    return syscall_entry(18, (int)addr, FUTEX_WAKE, n, 0, 0);
+}
+
+int futex_requeue(volatile int *addr, int nr_wake, int nr_requeue, volatile int *addr2) {
+    return syscall_entry(18, (int)addr, FUTEX_REQUEUE, nr_wake, nr_requeue, (int)addr2);
+}
+
+// The 6th argument travels in EBP, which SYSENTER needs for the user stack:
+// always use INT 0x80 here. EAX and EBP are loaded from a small array because
+// every other general purpose register already carries an argument.
+int futex_cmp_requeue(volatile int *addr, int nr_wake, int nr_requeue, volatile int *addr2, int val) {
+    int args[2] = { 18, val };
+    int ret;
+    __asm__ volatile (
+        "push %%ebp\n"
+        "mov 4(%%eax), %%ebp\n"
+        "mov (%%eax), %%eax\n"
+        "int $0x80\n"
+        "pop %%ebp\n"
+        : "=a" (ret)
+        : "a" (args), "b" ((int)addr), "c" (FUTEX_CMP_REQUEUE), "d" (nr_wake),
+          "S" (nr_requeue), "D" ((int)addr2)
+        : "memory"
+    );
+    return ret;
+}
+
+// 6. Adaptive Hybrid Mutex (Futex-style)
 // Uses a 3-state lock value for efficiency:
 //   0 = Unlocked
 //   1 = Locked (no waiters)
 //   2 = Contended (locked + waiters sleeping in kernel)
+// A failed CAS usually means a short critical section is running on another
+// CPU: spinning a little is far cheaper than futex_wait + a context switch.
+// How long to spin is learned per lock from past acquires (like glibc's
+// PTHREAD_MUTEX_ADAPTIVE_NP): spinning that paid off raises the estimate,
+// spinning that ended in a sleep lowers it.
 
 void mutex_init(user_mutex_t *m) {
     m->lock = 0;
+    m->spin_limit = 0;
+    m->futex_flags = FUTEX_PRIVATE_FLAG; // Only our threads: the kernel skips the shared-page lookup
+    m->stats.fast = 0;
+    m->stats.spun = 0;
+    m->stats.slept = 0;
+    m->stats.sleeps = 0;
+    m->stats.spins = 0;
+    m->stats.wait_cycles = 0;
+}
+
+void mutex_init_shared(user_mutex_t *m) {
+    mutex_init(m);
+    m->futex_flags = 0; // Keyed by the physical page: meets the other processes' waiters
 }
 
 void mutex_lock(user_mutex_t *m) {
     // Fast Path: Try to atomically swap 0 -> 1.
     // If successful (old value was 0), we have the lock with zero syscall cost.
     int old = __sync_val_compare_and_swap(&m->lock, 0, 1);
-    if (old == 0) return; // Acquired immediately!
+    if (old == 0) {
+        m->stats.fast++; // We own the lock: plain increments are safe
+        return;
+    }
 
-    // Slow Path: Lock was already held.
-    // Mark as Contended (2) so the unlocker knows to call futex_wake.
-    // Then ask the kernel to sleep us until the address changes.
-    while (__sync_lock_test_and_set(&m->lock, 2) != 0) {
-        // syscall 11 = sys_futex_wait(addr, val)
-        // "Sleep me if m->lock is still 2 (contended)"
-        syscall(11, (int)&m->lock, 2, 0);
+    unsigned long long start = rdtsc();
+
+    // 1. Spin: The owner can only release it meanwhile if it runs on another CPU
+    int max_spin = 0;
+    if (getncpus() > 1) {
+        max_spin = (m->spin_limit >> 4) * 2 + 10;
+        if (max_spin > MUTEX_SPIN_MAX) max_spin = MUTEX_SPIN_MAX;
+    }
+
+    int spins = 0;
+    int acquired = 0;
+    while (spins < max_spin) {
+        spins++;
+        // Read before the CAS: spinning on a plain load keeps the cache line shared
+        if (m->lock == 0 && __sync_val_compare_and_swap(&m->lock, 0, 1) == 0) {
+            acquired = 1;
+            break;
+        }
+        __asm__ volatile("pause");
     }
+
+    // 2. Sleep: Mark as Contended (2) so the unlocker knows to call futex_wake.
+    //    Then ask the kernel to sleep us until the address changes.
+    int sleeps = 0;
+    if (!acquired) {
+        while (__sync_lock_test_and_set(&m->lock, 2) != 0) {
+            // "Sleep me if m->lock is still 2 (contended)"
+            syscall_entry(18, (int)&m->lock, FUTEX_WAIT | m->futex_flags, 2, 0, 0);
+            sleeps++;
+        }
+    }
+
+    // 3. We own the lock now: tune the spin estimate (EMA, weight 1/8) and
+    //    record the wait. spin_limit is x16 so small steps don't truncate to 0.
+    if (acquired) {
+        m->spin_limit += (spins * 16 - m->spin_limit) / 8;
+        m->stats.spun++;
+    } else {
+        m->spin_limit -= m->spin_limit / 8;
+        if (sleeps) m->stats.slept++;
+        else m->stats.spun++; // Got it right after the spin phase
+    }
+    m->stats.sleeps += sleeps;
+    m->stats.spins += spins;
+    m->stats.wait_cycles += rdtsc() - start;
 }
 
 void mutex_unlock(user_mutex_t *m) {
@@ -194,12 +594,52 @@ void mutex_unlock(user_mutex_t *m) {
 
     // If old was 2 (Contended), there are waiters in the kernel — wake one.
     if (old == 2) {
-        // syscall 12 = sys_futex_wake(addr)
-        syscall(12, (int)&m->lock, 0, 0);
+        syscall_entry(18, (int)&m->lock, FUTEX_WAKE | m->futex_flags, 1, 0, 0);
     }
     // If old was 1 (Locked, no waiters), just returning is enough — no wake needed.
 }
 
+// Read the counters while no thread uses the lock (e.g. after joining the workers)
+void mutex_print_stats(char *name, user_mutex_t *m) {
+    mutex_stats_t *st = &m->stats;
+    print(name);
+    print(": fast=");
+    print_dec(st->fast);
+    print(" spun=");
+    print_dec(st->spun);
+    print(" slept=");
+    print_dec(st->slept);
+    print(" (futex waits=");
+    print_dec(st->sleeps);
+    print(") spins=");
+    print_dec(st->spins);
+    print(" wait=");
+    print_dec(tsc_to_us(st->wait_cycles));
+    print("us spin_limit=");
+    print_dec(m->spin_limit >> 4);
+    print("\n");
+}
+
+// 6-1. Priority Inheritance Mutex
+// The lock word holds the owner's TID, so the kernel knows whom to boost.
+// Uncontended lock/unlock never enter the kernel. Once a waiter has set
+// FUTEX_WAITERS, the owner's unlock CAS fails and the kernel hands the lock
+// (and the word) straight to the most important waiter.
+
+void pi_mutex_init(user_pi_mutex_t *m) {
+    m->lock = 0;
+}
+
+int pi_mutex_lock(user_pi_mutex_t *m) {
+    if (__sync_bool_compare_and_swap(&m->lock, 0, getpid())) return 0;
+    return syscall_entry(18, (int)&m->lock, FUTEX_LOCK_PI, 0, 0, 0);
+}
+
+int pi_mutex_unlock(user_pi_mutex_t *m) {
+    if (__sync_bool_compare_and_swap(&m->lock, getpid(), 0)) return 0;
+    return syscall_entry(18, (int)&m->lock, FUTEX_UNLOCK_PI, 0, 0, 0);
+}
+
 // 7. Hybrid Semaphore (Futex-style)
 // The `count` field works as a token counter:
 //   count > 0 : Resources available — sem_wait can proceed without syscall
@@ -242,3 +682,813 @@ void sem_post(user_sem_t *s) {
     }
     // If result >= 0, no one was waiting — no syscall needed.
 }
+
+// 8. Condition Variable (Futex-style)
+// Waiters sleep on 'seq'. A signal that happens between our unlock and our
+// futex_wait changes seq, so futex_wait returns at once (no lost wakeup).
+// Spurious returns are possible: callers re-check their predicate in a loop.
+
+void cond_init(user_cond_t *c) {
+    c->seq = 0;
+    c->mutex = 0;
+}
+
+// Take a mutex that may have requeued waiters: always leave it Contended (2),
+// so our unlock passes the wakeup on to the next requeued waiter.
+static void mutex_lock_contended(user_mutex_t *m) {
+    while (__sync_lock_test_and_set(&m->lock, 2) != 0) {
+        futex_wait(&m->lock, 2, 0);
+    }
+}
+
+void cond_wait(user_cond_t *c, user_mutex_t *m) {
+    int seq = c->seq;
+    c->mutex = m; // Broadcast requeues onto this mutex
+
+    mutex_unlock(m);
+    futex_wait(&c->seq, seq, 0);
+    mutex_lock_contended(m);
+}
+
+void cond_signal(user_cond_t *c) {
+    __sync_fetch_and_add(&c->seq, 1);
+    futex_wake(&c->seq, 1);
+}
+
+void cond_broadcast(user_cond_t *c) {
+    int seq = __sync_add_and_fetch(&c->seq, 1);
+    user_mutex_t *m = c->mutex;
+
+    // Wake one, move everybody else to the mutex word. If seq moved on
+    // meanwhile (another signal), fall back to waking everyone.
+    if (!m || futex_cmp_requeue(&c->seq, 1, 0x7FFFFFFF, &m->lock, seq) < 0) {
+        futex_wake(&c->seq, 0x7FFFFFFF);
+    }
+}
+
+// 9. Reader-Writer Lock
+// All state lives under one mutex; readers and writers sleep on their own
+// condition variables.
+
+void rwlock_init(user_rwlock_t *rw) {
+    mutex_init(&rw->lock);
+    cond_init(&rw->readers_cv);
+    cond_init(&rw->writers_cv);
+    rw->readers = 0;
+    rw->writer = 0;
+    rw->writers_waiting = 0;
+    rw->batch = 0;
+}
+
+void rwlock_read_lock(user_rwlock_t *rw) {
+    mutex_lock(&rw->lock);
+    // Readers are preferred: a waiting writer only stops them once a full
+    // batch has gone in ahead of it.
+    while (rw->writer || (rw->writers_waiting && rw->batch >= RWLOCK_READ_BATCH)) {
+        cond_wait(&rw->readers_cv, &rw->lock);
+    }
+    rw->readers++;
+    if (rw->writers_waiting) rw->batch++;
+    mutex_unlock(&rw->lock);
+}
+
+void rwlock_read_unlock(user_rwlock_t *rw) {
+    mutex_lock(&rw->lock);
+    rw->readers--;
+    if (rw->readers == 0 && rw->writers_waiting) {
+        cond_signal(&rw->writers_cv);
+    }
+    mutex_unlock(&rw->lock);
+}
+
+void rwlock_write_lock(user_rwlock_t *rw) {
+    mutex_lock(&rw->lock);
+    rw->writers_waiting++;
+    while (rw->writer || rw->readers) {
+        cond_wait(&rw->writers_cv, &rw->lock);
+    }
+    rw->writers_waiting--;
+    rw->writer = 1;
+    rw->batch = 0; // The next waiting writer starts a fresh reader batch
+    mutex_unlock(&rw->lock);
+}
+
+void rwlock_write_unlock(user_rwlock_t *rw) {
+    mutex_lock(&rw->lock);
+    rw->writer = 0;
+    // Readers first; a waiting writer gets in once they drain (or hit the batch limit)
+    cond_broadcast(&rw->readers_cv);
+    if (rw->writers_waiting) {
+        cond_signal(&rw->writers_cv);
+    }
+    mutex_unlock(&rw->lock);
+}
+
+// 10. Barrier
+
+void barrier_init(user_barrier_t *b, int count) {
+    mutex_init(&b->lock);
+    cond_init(&b->cv);
+    b->count = count;
+    b->waiting = 0;
+    b->generation = 0;
+}
+
+int barrier_wait(user_barrier_t *b) {
+    mutex_lock(&b->lock);
+    int gen = b->generation;
+
+    // Last one in: start the next round and release everybody
+    if (++b->waiting == b->count) {
+        b->waiting = 0;
+        b->generation++;
+        cond_broadcast(&b->cv);
+        mutex_unlock(&b->lock);
+        return BARRIER_SERIAL_THREAD;
+    }
+
+    // The generation check filters out spurious wakeups
+    while (gen == b->generation) {
+        cond_wait(&b->cv, &b->lock);
+    }
+    mutex_unlock(&b->lock);
+    return 0;
+}
+
+// 11. Lock-Free Bounded Queues
+// Blocking uses an event count (queue_event_t). A sleeper registers in
+// 'waiters' (locked add = full barrier), samples 'seq', re-checks the queue and
+// only then calls futex_wait(seq). The other side publishes its slot, issues a
+// full barrier and notifies if it sees a waiter. Either the sleeper sees the
+// new state or the notifier sees the sleeper, so no wakeup is lost.
+
+#define QUEUE_SPIN 100 // Retries before a blocking push/pop sleeps
+
+static void queue_event_notify(queue_event_t *e) {
+    __sync_synchronize();
+    if (e->waiters) {
+        __sync_fetch_and_add(&e->seq, 1);
+        futex_wake(&e->seq, 1);
+    }
+}
+
+static int queue_event_prepare(queue_event_t *e) {
+    __sync_fetch_and_add(&e->waiters, 1);
+    return e->seq;
+}
+
+static void queue_event_wait(queue_event_t *e, int seq) {
+    futex_wait(&e->seq, seq, 0);
+    __sync_fetch_and_sub(&e->waiters, 1);
+}
+
+static void queue_event_cancel(queue_event_t *e) {
+    __sync_fetch_and_sub(&e->waiters, 1);
+}
+
+// --- SPSC ---
+
+void spsc_init(spsc_queue_t *q) {
+    q->head = 0;
+    q->cached_tail = 0;
+    q->tail = 0;
+    q->cached_head = 0;
+    q->not_empty.seq = 0;
+    q->not_empty.waiters = 0;
+    q->not_full.seq = 0;
+    q->not_full.waiters = 0;
+}
+
+int spsc_try_push(spsc_queue_t *q, int item) {
+    unsigned int tail = q->tail;
+    if (tail - q->cached_head == QUEUE_SIZE) {
+        q->cached_head = q->head; // Looks full: refresh our copy
+        if (tail - q->cached_head == QUEUE_SIZE) return 0;
+    }
+    q->slots[tail & (QUEUE_SIZE - 1)] = item;
+    // x86 keeps stores in order: the slot is visible before the new tail
+    __asm__ volatile("" ::: "memory");
+    q->tail = tail + 1;
+    return 1;
+}
+
+int spsc_try_pop(spsc_queue_t *q, int *item) {
+    unsigned int head = q->head;
+    if (head == q->cached_tail) {
+        q->cached_tail = q->tail; // Looks empty: refresh our copy
+        if (head == q->cached_tail) return 0;
+    }
+    *item = q->slots[head & (QUEUE_SIZE - 1)];
+    __asm__ volatile("" ::: "memory");
+    q->head = head + 1;
+    return 1;
+}
+
+void spsc_push(spsc_queue_t *q, int item) {
+    for (int i = 0; !spsc_try_push(q, item); i++) {
+        if (i < QUEUE_SPIN) {
+            __asm__ volatile("pause");
+            continue;
+        }
+        int seq = queue_event_prepare(&q->not_full);
+        if (spsc_try_push(q, item)) {
+            queue_event_cancel(&q->not_full);
+            break;
+        }
+        queue_event_wait(&q->not_full, seq);
+    }
+    queue_event_notify(&q->not_empty);
+}
+
+int spsc_pop(spsc_queue_t *q) {
+    int item;
+    for (int i = 0; !spsc_try_pop(q, &item); i++) {
+        if (i < QUEUE_SPIN) {
+            __asm__ volatile("pause");
+            continue;
+        }
+        int seq = queue_event_prepare(&q->not_empty);
+        if (spsc_try_pop(q, &item)) {
+            queue_event_cancel(&q->not_empty);
+            break;
+        }
+        queue_event_wait(&q->not_empty, seq);
+    }
+    queue_event_notify(&q->not_full);
+    return item;
+}
+
+// --- MPMC ---
+
+void mpmc_init(mpmc_queue_t *q) {
+    for (unsigned int i = 0; i < QUEUE_SIZE; i++) {
+        q->cells[i].seq = i;
+    }
+    q->enqueue_pos = 0;
+    q->dequeue_pos = 0;
+    q->not_empty.seq = 0;
+    q->not_empty.waiters = 0;
+    q->not_full.seq = 0;
+    q->not_full.waiters = 0;
+}
+
+int mpmc_try_push(mpmc_queue_t *q, int item) {
+    unsigned int pos = q->enqueue_pos;
+    mpmc_cell_t *cell;
+    for (;;) {
+        cell = &q->cells[pos & (QUEUE_SIZE - 1)];
+        int diff = (int)(cell->seq - pos);
+        if (diff == 0) {
+            // Slot is free for this position: claim the position
+            if (__sync_bool_compare_and_swap(&q->enqueue_pos, pos, pos + 1)) break;
+            pos = q->enqueue_pos;
+        } else if (diff < 0) {
+            return 0; // Slot still holds the item from one lap ago: full
+        } else {
+            pos = q->enqueue_pos; // Another producer took it, try again
+        }
+    }
+    cell->item = item;
+    __asm__ volatile("" ::: "memory");
+    cell->seq = pos + 1; // Publish
+    return 1;
+}
+
+int mpmc_try_pop(mpmc_queue_t *q, int *item) {
+    unsigned int pos = q->dequeue_pos;
+    mpmc_cell_t *cell;
+    for (;;) {
+        cell = &q->cells[pos & (QUEUE_SIZE - 1)];
+        int diff = (int)(cell->seq - (pos + 1));
+        if (diff == 0) {
+            if (__sync_bool_compare_and_swap(&q->dequeue_pos, pos, pos + 1)) break;
+            pos = q->dequeue_pos;
+        } else if (diff < 0) {
+            return 0; // Not published yet: empty
+        } else {
+            pos = q->dequeue_pos;
+        }
+    }
+    *item = cell->item;
+    __asm__ volatile("" ::: "memory");
+    cell->seq = pos + QUEUE_SIZE; // Free for the push one lap later
+    return 1;
+}
+
+void mpmc_push(mpmc_queue_t *q, int item) {
+    for (int i = 0; !mpmc_try_push(q, item); i++) {
+        if (i < QUEUE_SPIN) {
+            __asm__ volatile("pause");
+            continue;
+        }
+        int seq = queue_event_prepare(&q->not_full);
+        if (mpmc_try_push(q, item)) {
+            queue_event_cancel(&q->not_full);
+            break;
+        }
+        queue_event_wait(&q->not_full, seq);
+    }
+    queue_event_notify(&q->not_empty);
+}
+
+int mpmc_pop(mpmc_queue_t *q) {
+    int item;
+    for (int i = 0; !mpmc_try_pop(q, &item); i++) {
+        if (i < QUEUE_SPIN) {
+            __asm__ volatile("pause");
+            continue;
+        }
+        int seq = queue_event_prepare(&q->not_empty);
+        if (mpmc_try_pop(q, &item)) {
+            queue_event_cancel(&q->not_empty);
+            break;
+        }
+        queue_event_wait(&q->not_empty, seq);
+    }
+    queue_event_notify(&q->not_full);
+    return item;
+}
+
+// 12. Work-Stealing Thread Pool
+
+// --- Chase-Lev Deque (bounded) ---
+// Only the owner touches 'bottom'; owner and thieves race on 'top' with CAS.
+// A thief copies the task before its CAS and only keeps it if the CAS wins.
+// push refuses to fill the last slot the owner could see as free, so a slot
+// is never rewritten while a thief may still be copying it.
+
+static int deque_push(pool_deque_t *d, pool_task_t *t) {
+    int b = d->bottom;
+    if (b - d->top >= POOL_DEQUE_SIZE) return 0; // Full: caller runs it inline
+    d->tasks[b & (POOL_DEQUE_SIZE - 1)] = *t;
+    __asm__ volatile("" ::: "memory"); // Task stored before it becomes visible
+    d->bottom = b + 1;
+    return 1;
+}
+
+static int deque_pop(pool_deque_t *d, pool_task_t *t) {
+    int b = d->bottom - 1;
+    d->bottom = b;
+    __sync_synchronize(); // Our 'bottom' store must be visible before we read 'top'
+    int top = d->top;
+
+    if (top > b) { // Empty
+        d->bottom = b + 1;
+        return 0;
+    }
+    *t = d->tasks[b & (POOL_DEQUE_SIZE - 1)];
+    if (top < b) return 1; // More than one left: no thief can reach this one
+
+    // Last task: race the thieves for it
+    int won = __sync_bool_compare_and_swap(&d->top, top, top + 1);
+    d->bottom = b + 1;
+    return won;
+}
+
+static int deque_steal(pool_deque_t *d, pool_task_t *t) {
+    int top = d->top;
+    __asm__ volatile("" ::: "memory"); // x86 keeps loads in order
+    int b = d->bottom;
+    if (top >= b) return 0;
+
+    *t = d->tasks[top & (POOL_DEQUE_SIZE - 1)];
+    return __sync_bool_compare_and_swap(&d->top, top, top + 1);
+}
+
+// --- Scheduling ---
+
+static int pool_tls_key = -1; // TLS slot: the pool_worker_t this thread is
+
+static pool_worker_t *pool_self(pool_t *pool) {
+    pool_worker_t *w = (pool_worker_t *)tls_get(pool_tls_key);
+    if (w && w->pool == pool) return w;
+    return &pool->workers[0];
+}
+
+static void pool_push(pool_t *pool, pool_worker_t *w, pool_task_t *t) {
+    if (!deque_push(&w->deque, t)) {
+        // Deque full: no room to share it, just run it here later
+        pool_task_t copy = *t;
+        copy.grain = 0;
+        copy.body(copy.arg, copy.begin, copy.end);
+        w->executed++;
+        __sync_fetch_and_sub(copy.pending, 1); // Never the last: our own chunk is still pending
+        return;
+    }
+    queue_event_notify(&pool->work);
+}
+
+// Run one chunk: keep splitting off the right half for others to steal
+// (lazy binary splitting), then run what's left and retire it.
+static void pool_run(pool_t *pool, pool_worker_t *w, pool_task_t *t) {
+    while (t->grain > 0 && t->end - t->begin > t->grain) {
+        pool_task_t right = *t;
+        right.begin = t->begin + (t->end - t->begin) / 2;
+        t->end = right.begin;
+        __sync_fetch_and_add(t->pending, 1);
+        pool_push(pool, w, &right);
+    }
+
+    t->body(t->arg, t->begin, t->end);
+    w->executed++;
+
+    if (__sync_sub_and_fetch(t->pending, 1) == 0) {
+        futex_wake(t->pending, 0x7FFFFFFF); // The parallel_for caller may sleep on it
+    }
+}
+
+// Find work: our own deque first (newest, cache-warm), then steal the oldest
+// task of other workers starting at a random victim.
+static int pool_find(pool_t *pool, pool_worker_t *w, pool_task_t *t) {
+    if (deque_pop(&w->deque, t)) return 1;
+
+    int n = pool->nworkers;
+    w->rand ^= w->rand << 13;
+    w->rand ^= w->rand >> 17;
+    w->rand ^= w->rand << 5;
+    int start = w->rand % n;
+    for (int i = 0; i < n; i++) {
+        pool_worker_t *victim = &pool->workers[(start + i) % n];
+        if (victim == w) continue;
+        if (deque_steal(&victim->deque, t)) {
+            w->steals++;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void pool_worker_main(void *arg) {
+    pool_worker_t *w = (pool_worker_t *)arg;
+    pool_t *pool = w->pool;
+    pool_task_t t;
+
+    w->tid = getpid();
+    tls_set(pool_tls_key, w);
+
+    while (!pool->shutdown) {
+        int found = 0;
+        for (int i = 0; i < QUEUE_SPIN && !found; i++) {
+            found = pool_find(pool, w, &t);
+            if (!found) __asm__ volatile("pause");
+        }
+        if (!found) {
+            // Park. Check once more after registering, so a push that
+            // happened meanwhile either shows up here or wakes us.
+            int seq = queue_event_prepare(&pool->work);
+            if (pool->shutdown || !(found = pool_find(pool, w, &t))) {
+                if (!pool->shutdown) {
+                    queue_event_wait(&pool->work, seq);
+                } else {
+                    queue_event_cancel(&pool->work);
+                }
+                continue;
+            }
+            queue_event_cancel(&pool->work);
+        }
+        pool_run(pool, w, &t);
+    }
+}
+
+void pool_init(pool_t *pool, int nworkers) {
+    if (nworkers <= 0) nworkers = getncpus();
+    if (nworkers > POOL_MAX_WORKERS) nworkers = POOL_MAX_WORKERS;
+
+    pool->nworkers = nworkers;
+    pool->shutdown = 0;
+    pool->work.seq = 0;
+    pool->work.waiters = 0;
+
+    for (int i = 0; i < nworkers; i++) {
+        pool_worker_t *w = &pool->workers[i];
+        w->deque.top = 0;
+        w->deque.bottom = 0;
+        w->pool = pool;
+        w->tid = 0;
+        w->rand = 2463534242u + i * 0x9E3779B9; // Any non-zero seed
+        w->executed = 0;
+        w->steals = 0;
+    }
+
+    // Worker 0 is us; the others get a thread each
+    if (pool_tls_key < 0) pool_tls_key = tls_key_create();
+    pool->workers[0].tid = getpid();
+    tls_set(pool_tls_key, &pool->workers[0]);
+    for (int i = 1; i < nworkers; i++) {
+        pool_worker_t *w = &pool->workers[i];
+        thread_create(pool_worker_main, w, w->stack + POOL_STACK_SIZE);
+    }
+}
+
+void pool_shutdown(pool_t *pool) {
+    pool->shutdown = 1;
+    __sync_fetch_and_add(&pool->work.seq, 1);
+    futex_wake(&pool->work.seq, 0x7FFFFFFF);
+
+    int status;
+    for (int i = 1; i < pool->nworkers; i++) {
+        wait(&status);
+    }
+}
+
+void parallel_for(pool_t *pool, int begin, int end, int grain,
+                  void (*body)(void *arg, int begin, int end), void *arg) {
+    if (begin >= end) return;
+    if (grain < 1) grain = 1;
+
+    volatile int pending = 1;
+    pool_worker_t *w = pool_self(pool);
+    pool_task_t t = { body, arg, begin, end, grain, &pending };
+
+    // Start on it ourselves; the split-off halves get stolen by the others
+    pool_run(pool, w, &t);
+
+    // Help until every chunk is done. With nothing left to steal, the
+    // remaining chunks are running elsewhere: sleep until the last one ends.
+    while (pending) {
+        if (pool_find(pool, w, &t)) {
+            pool_run(pool, w, &t);
+            continue;
+        }
+        int left = pending;
+        if (left) futex_wait(&pending, left, 1); // 1 ms cap: new work may show up to help with
+    }
+}
+
+void pool_print_stats(pool_t *pool) {
+    for (int i = 0; i < pool->nworkers; i++) {
+        print("  worker ");
+        print_dec(i);
+        print(": chunks=");
+        print_dec(pool->workers[i].executed);
+        print(" steals=");
+        print_dec(pool->workers[i].steals);
+        print("\n");
+    }
+}
+
+// 13. Green Threads
+// green_switch(&save_esp, new_esp): push the callee-saved registers, save ESP,
+// load the other stack and pop its registers. Everything else is caller-saved
+// in the cdecl ABI, so this is a complete switch between two C functions.
+__asm__(
+    ".text\n"
+    ".globl green_switch\n"
+    "green_switch:\n"
+    "    push %ebp\n"
+    "    push %ebx\n"
+    "    push %esi\n"
+    "    push %edi\n"
+    "    mov 20(%esp), %eax\n"    // save_esp
+    "    mov %esp, (%eax)\n"
+    "    mov 24(%esp), %esp\n"    // new_esp
+    "    pop %edi\n"
+    "    pop %esi\n"
+    "    pop %ebx\n"
+    "    pop %ebp\n"
+    "    ret\n"
+);
+void green_switch(unsigned int *save_esp, unsigned int new_esp);
+
+// A kernel thread running coroutines. Coroutines always switch back to their
+// carrier's scheduler loop, never directly to each other: the loop finishes
+// what a coroutine could not do on its own stack (requeue, unlock, retire).
+typedef struct {
+    volatile int tid;
+    unsigned int sched_esp;     // Scheduler loop context
+    green_t *current;
+    volatile int *release;      // Lock to drop once 'current' is switched out
+    unsigned int switches;
+    char stack[GREEN_CARRIER_STACK] __attribute__((aligned(16)));
+} green_carrier_t;
+
+static green_carrier_t green_carriers[GREEN_MAX_CARRIERS];
+static int green_ncarriers = 0;
+
+static volatile int green_rq_lock = 0;
+static green_t *green_rq_head = 0;
+static green_t *green_rq_tail = 0;
+static volatile int green_live = 0;  // Spawned and not yet retired
+static queue_event_t green_work;     // Idle carriers park here
+
+static int green_tls_key = -1; // TLS slot: the carrier this kernel thread is
+
+// Coroutines move between carriers: always ask the thread we run on right now
+static green_carrier_t *green_carrier() {
+    green_carrier_t *c = (green_carrier_t *)tls_get(green_tls_key);
+    return c ? c : &green_carriers[0];
+}
+
+static void green_rq_push(green_t *g) {
+    g->state = GREEN_READY;
+    g->next = 0;
+    spin_lock(&green_rq_lock);
+    if (green_rq_tail) green_rq_tail->next = g;
+    else green_rq_head = g;
+    green_rq_tail = g;
+    spin_unlock(&green_rq_lock);
+    queue_event_notify(&green_work);
+}
+
+static green_t *green_rq_pop() {
+    if (!green_rq_head) return 0; // Racy peek: saves the lock when idle
+    spin_lock(&green_rq_lock);
+    green_t *g = green_rq_head;
+    if (g) {
+        green_rq_head = g->next;
+        if (!green_rq_head) green_rq_tail = 0;
+    }
+    spin_unlock(&green_rq_lock);
+    return g;
+}
+
+// First code a new coroutine runs (its stack was prepared by green_spawn)
+static void green_start() {
+    green_t *g = green_carrier()->current;
+    g->func(g->arg);
+    green_exit();
+}
+
+void green_spawn(green_t *g, void (*func)(void *arg), void *arg, void *stack, int stack_size) {
+    unsigned int *sp = (unsigned int *)(((unsigned int)stack + stack_size) & ~15u);
+    *--sp = 0;                        // Return address of green_start (never used)
+    *--sp = (unsigned int)green_start; // green_switch's 'ret' lands here
+    *--sp = 0;                        // EBP
+    *--sp = 0;                        // EBX
+    *--sp = 0;                        // ESI
+    *--sp = 0;                        // EDI
+
+    g->esp = (unsigned int)sp;
+    g->func = func;
+    g->arg = arg;
+    g->lock = 0;
+    g->joiners = 0;
+    __sync_fetch_and_add(&green_live, 1);
+    green_rq_push(g);
+}
+
+// Switch from the running coroutine back to its carrier's scheduler
+static void green_to_scheduler(green_carrier_t *c, green_t *g) {
+    green_switch(&g->esp, c->sched_esp);
+}
+
+green_t *green_self() {
+    return green_carrier()->current;
+}
+
+void green_yield() {
+    green_carrier_t *c = green_carrier();
+    green_t *g = c->current;
+    g->state = GREEN_READY; // Requeued by the scheduler once we're off this stack
+    green_to_scheduler(c, g);
+}
+
+// Block the running coroutine. 'lock' is held by the caller (it protects the
+// wait list we are on) and dropped only after our registers are saved, so a
+// waker can't resume us on another carrier while we still use this stack.
+static void green_block(volatile int *lock) {
+    green_carrier_t *c = green_carrier();
+    green_t *g = c->current;
+    g->state = GREEN_BLOCKED;
+    c->release = lock;
+    green_to_scheduler(c, g);
+}
+
+// Make every coroutine on a wait list runnable (list lock held)
+static void green_wake_list(green_t *g) {
+    while (g) {
+        green_t *next = g->next;
+        green_rq_push(g);
+        g = next;
+    }
+}
+
+void green_exit() {
+    green_carrier_t *c = green_carrier();
+    green_t *g = c->current;
+    g->state = GREEN_EXITING;
+    green_to_scheduler(c, g);
+    // Not reached: the scheduler retires us
+}
+
+void green_join(green_t *g) {
+    spin_lock(&g->lock);
+    if (g->state == GREEN_DONE) {
+        spin_unlock(&g->lock);
+        return;
+    }
+    green_t *me = green_carrier()->current;
+    me->next = g->joiners;
+    g->joiners = me;
+    green_block(&g->lock);
+}
+
+void green_event_init(green_event_t *e) {
+    e->lock = 0;
+    e->set = 0;
+    e->waiters = 0;
+}
+
+void green_event_wait(green_event_t *e) {
+    spin_lock(&e->lock);
+    if (e->set) {
+        spin_unlock(&e->lock);
+        return;
+    }
+    green_t *me = green_carrier()->current;
+    me->next = e->waiters;
+    e->waiters = me;
+    green_block(&e->lock);
+}
+
+void green_event_set(green_event_t *e) {
+    spin_lock(&e->lock);
+    e->set = 1;
+    green_t *list = e->waiters;
+    e->waiters = 0;
+    green_wake_list(list);
+    spin_unlock(&e->lock);
+}
+
+// The coroutine returned: wake its joiners, and the parked carriers if it was the last
+static void green_retire(green_t *g) {
+    spin_lock(&g->lock);
+    g->state = GREEN_DONE;
+    green_t *list = g->joiners;
+    g->joiners = 0;
+    green_wake_list(list);
+    spin_unlock(&g->lock);
+
+    if (__sync_sub_and_fetch(&green_live, 1) == 0) {
+        __sync_fetch_and_add(&green_work.seq, 1);
+        futex_wake(&green_work.seq, 0x7FFFFFFF);
+    }
+}
+
+static void green_carrier_main(void *arg) {
+    green_carrier_t *c = (green_carrier_t *)arg;
+    c->tid = getpid();
+    tls_set(green_tls_key, c);
+
+    while (green_live > 0) {
+        green_t *g = green_rq_pop();
+        if (!g) {
+            int seq = queue_event_prepare(&green_work);
+            if (green_live > 0 && !green_rq_head) {
+                queue_event_wait(&green_work, seq);
+            } else {
+                queue_event_cancel(&green_work);
+            }
+            continue;
+        }
+
+        c->current = g;
+        g->state = GREEN_RUNNING;
+        c->switches++;
+        green_switch(&c->sched_esp, g->esp);
+
+        // Back on the scheduler stack: 'g' is fully switched out
+        c->current = 0;
+        if (g->state == GREEN_READY) {
+            green_rq_push(g);
+        } else if (g->state == GREEN_EXITING) {
+            green_retire(g);
+        }
+        if (c->release) {
+            spin_unlock(c->release);
+            c->release = 0;
+        }
+    }
+}
+
+void green_run(int ncarriers) {
+    if (ncarriers <= 0) ncarriers = getncpus();
+    if (ncarriers > GREEN_MAX_CARRIERS) ncarriers = GREEN_MAX_CARRIERS;
+
+    for (int i = 0; i < ncarriers; i++) {
+        green_carriers[i].tid = 0;
+        green_carriers[i].current = 0;
+        green_carriers[i].release = 0;
+        green_carriers[i].switches = 0;
+    }
+    if (green_tls_key < 0) green_tls_key = tls_key_create();
+    green_ncarriers = ncarriers;
+
+    for (int i = 1; i < ncarriers; i++) {
+        thread_create(green_carrier_main, &green_carriers[i], green_carriers[i].stack + GREEN_CARRIER_STACK);
+    }
+    green_carrier_main(&green_carriers[0]);
+
+    int status;
+    for (int i = 1; i < ncarriers; i++) {
+        wait(&status);
+    }
+}
+
+unsigned int green_switches() {
+    unsigned int total = 0;
+    for (int i = 0; i < green_ncarriers; i++) {
+        total += green_carriers[i].switches;
+    }
+    return total;
+}
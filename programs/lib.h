@@ -6,6 +6,7 @@ char getchar();
 void putchar(char c);
 void print(char *str);
 void print_dec(int n);
+int format_dec(char *buf, int n);    // Write n as decimal into buf (NUL-terminated), return length
 void print_hex(int n);
 int strcmp(char *s1, char *s2);
 int strlen(char *s);
@@ -14,18 +15,161 @@ int exec(char *filename);
 int fork();
 int wait(int *status);
 void ls();                           // List files (syscall 13)
-int thread_create(void (*func)(void*), void *arg, void *stack);
+void sysstat(int reset);             // Print (0) or reset (1) kernel syscall statistics (syscall 14)
+int spawn(char *filename);           // New process running filename (syscall 17)
+void *shm_map(int key, void *addr, unsigned int size); // Map shared object 'key' at addr (syscall 19), NULL on error
+int setprio(int tid, int prio);      // Set base priority of tid (0 = self; else one of our threads), -1 = query. Returns old, -1 if refused (syscall 20)
+                                     // Lowering always works; raising only up to PRIO_DEFAULT (self) or our own priority (other threads)
+
+// Files (SimpleFS: flat, addressed by name). Writes are buffered by the
+// kernel and reach the disk within a few seconds, or at fsync().
+int creat(char *filename);                       // Create empty (or empty an existing file) (syscall 22)
+int append(char *filename, void *buf, unsigned int len); // Write at the end, creating the file. Returns bytes written (syscall 23)
+int truncate(char *filename, unsigned int size); // Shrink, or grow with zeros (syscall 24)
+int unlink(char *filename);                      // Delete (syscall 25)
+int fsync();                                     // Flush all buffered writes to disk (syscall 26)
+int readfile(char *filename, unsigned int offset, void *buf, unsigned int len); // Read at offset. Returns bytes read, 0 at end of file, -1 (syscall 27)
+int cat(char *filename);                         // Print a file. Returns its size, or -1
+// Scheduling priorities — mirror of kernel/process.h (higher runs first)
+#define PRIO_MIN      1
+#define PRIO_DEFAULT  10
+#define PRIO_MAX      31
+
+int thread_create(void (*func)(void*), void *arg, void *stack); // Reserves a tls_block_t at the stack top
 void spin_lock(volatile int *lock);
 void spin_unlock(volatile int *lock);
 
-// Hybrid Mutex (Fast Path: user-space atomic, Slow Path: kernel futex)
+// Thread-Local Storage (syscall 21: set_thread_area)
+// Every thread from thread_create gets a tls_block_t at the top of its stack,
+// installed as its %gs segment; the kernel swaps the segment on every task
+// switch. %gs:0 holds the block's own address (like the i386 TCB pointer).
+// The first TLS access from the main thread sets up its block lazily.
+#define TLS_SEL   0x3B // GDT entry 7, RPL 3 (kernel: GDT_TLS_SEL)
+#define TLS_SLOTS 8    // Keys available through tls_key_create()
+
+typedef struct tls_block {
+    struct tls_block *self;  // %gs:0
+    int tid;
+    void *slots[TLS_SLOTS];  // Per-thread values, indexed by key
+} tls_block_t;
+
+int set_thread_area(void *base, unsigned int size); // Returns the selector, -1 on error
+void tls_init(tls_block_t *block);  // Install 'block' as the calling thread's TLS
+int tls_key_create();               // New slot index (process wide), -1 if none left
+void tls_init_main();               // Called lazily by the accessors below
+
+static inline int tls_ready() {
+    unsigned int sel;
+    __asm__ volatile("mov %%gs, %0" : "=r"(sel));
+    return (sel & 0xFFFF) == TLS_SEL;
+}
+
+static inline tls_block_t *tls_self() {
+    if (!tls_ready()) tls_init_main();
+    tls_block_t *self;
+    __asm__ volatile("mov %%gs:0, %0" : "=r"(self));
+    return self;
+}
+
+// One %gs-relative load/store: no lock, no lookup by TID
+static inline void *tls_get(int key) {
+    if (!tls_ready()) tls_init_main();
+    void *val;
+    __asm__ volatile("mov %%gs:(%1), %0" : "=r"(val) : "r"(8 + key * 4));
+    return val;
+}
+
+static inline void tls_set(int key, void *val) {
+    if (!tls_ready()) tls_init_main();
+    __asm__ volatile("mov %0, %%gs:(%1)" :: "r"(val), "r"(8 + key * 4) : "memory");
+}
+
+// vDSO Shared Page (Read-Only, mapped by the kernel in every process)
+// Mirror of vdso_data_t in kernel/vdso.h — keep both in sync!
+#define VDSO_USER_ADDR 0xBFFFF000
+#define VDSO_MAGIC     0x6F736476
+#define VDSO_FEAT_TSC  0x1
+#define VDSO_FEAT_SYSENTER 0x2
+#define VDSO_MAX_CPUS  8
+
+typedef struct {
+    unsigned int magic;
+    unsigned int version;
+    unsigned int features;
+    unsigned int tick_hz;
+    volatile unsigned int seq;          // Seqlock (odd = kernel is updating)
+    volatile unsigned int ticks;
+    volatile unsigned int tsc_lo;
+    volatile unsigned int tsc_hi;
+    volatile unsigned int tsc_per_tick;
+    volatile unsigned int ncpus;
+    volatile unsigned int pid[VDSO_MAX_CPUS]; // Indexed by CPU number
+} vdso_data_t;
+
+unsigned int uptime_ms();            // Milliseconds since boot (no syscall)
+int getpid();                        // Current PID/TID (no syscall)
+int getcpu();                        // CPU this thread is running on (no syscall)
+int getncpus();                      // Number of CPUs online (no syscall)
+unsigned long long rdtsc();          // Time Stamp Counter (0 without a TSC)
+unsigned int tsc_to_us(unsigned long long cycles); // TSC cycles -> microseconds (vDSO calibration)
+
+// Futex (syscall 18) — mirror of kernel/futex.h
+#define FUTEX_WAIT        0
+#define FUTEX_WAKE        1
+#define FUTEX_REQUEUE     2
+#define FUTEX_CMP_REQUEUE 3
+#define FUTEX_LOCK_PI     4
+#define FUTEX_UNLOCK_PI   5
+#define FUTEX_PRIVATE_FLAG 128 // OR into op: word is never shared with another process
+#define FUTEX_EAGAIN     -1  // Value did not match
+#define FUTEX_ETIMEDOUT  -2  // Timeout expired
+#define FUTEX_EINVAL     -3  // Bad address or operation
+#define FUTEX_EDEADLK    -4  // LOCK_PI: we already own it
+#define FUTEX_EPERM      -5  // UNLOCK_PI: we don't own it
+#define FUTEX_WAITERS    0x80000000 // PI word: tasks wait in the kernel
+
+int futex_wait(volatile int *addr, int val, unsigned int timeout_ms); // Sleep while *addr == val (0 = no timeout)
+int futex_wake(volatile int *addr, int n);                           // Wake up to n waiters, returns count
+int futex_requeue(volatile int *addr, int nr_wake, int nr_requeue, volatile int *addr2);
+int futex_cmp_requeue(volatile int *addr, int nr_wake, int nr_requeue, volatile int *addr2, int val);
+
+// Adaptive Hybrid Mutex
+// Fast Path: user-space atomic. Contended: spin for a while (self-tuned per
+// lock, only with more than one CPU), then sleep in the kernel (futex).
+#define MUTEX_SPIN_MAX 1000 // Upper bound on spin iterations per contended acquire
+
+// Contention counters, updated by the owner while it holds the lock
+typedef struct {
+    unsigned int fast;              // Acquired by the first CAS
+    unsigned int spun;              // Contended, acquired without sleeping
+    unsigned int slept;             // Contended, acquired after sleeping
+    unsigned int sleeps;            // futex_wait calls (one acquire may sleep several times)
+    unsigned int spins;             // Spin iterations (all contended acquires)
+    unsigned long long wait_cycles; // TSC cycles spent in contended acquires
+} mutex_stats_t;
+
 typedef struct {
     volatile int lock; // 0=Unlocked, 1=Locked, 2=Contended (waiters exist)
+    int spin_limit;    // Running estimate of useful spin iterations, x16 (fixed point)
+    int futex_flags;   // FUTEX_PRIVATE_FLAG, or 0 for a mutex in shared memory
+    mutex_stats_t stats;
 } user_mutex_t;
 
-void mutex_init(user_mutex_t *m);
+void mutex_init(user_mutex_t *m);  // Also clears the statistics
+void mutex_init_shared(user_mutex_t *m); // For a mutex inside shm_map memory (used by several processes)
 void mutex_lock(user_mutex_t *m);
 void mutex_unlock(user_mutex_t *m);
+void mutex_print_stats(char *name, user_mutex_t *m);
+
+// Priority Inheritance Mutex (lock word = owner TID, slow path: FUTEX_LOCK_PI)
+// While a more important thread waits, the owner runs at its priority.
+typedef struct {
+    volatile int lock; // 0=Unlocked, else owner TID (| FUTEX_WAITERS)
+} user_pi_mutex_t;
+
+void pi_mutex_init(user_pi_mutex_t *m);
+int pi_mutex_lock(user_pi_mutex_t *m);   // 0 or FUTEX_EDEADLK
+int pi_mutex_unlock(user_pi_mutex_t *m); // 0 or FUTEX_EPERM
 
 // Hybrid Semaphore
 typedef struct {
@@ -36,4 +180,241 @@ void sem_init(user_sem_t *s, int value);
 void sem_wait(user_sem_t *s);
 void sem_post(user_sem_t *s);
 
+// Condition Variable (futex on a sequence counter)
+// cond_broadcast wakes one waiter and requeues the rest onto the mutex, so
+// they are released one at a time by mutex_unlock instead of all at once.
+typedef struct {
+    volatile int seq;          // Bumped by every signal/broadcast
+    user_mutex_t *volatile mutex; // Mutex the waiters use (requeue target)
+} user_cond_t;
+
+void cond_init(user_cond_t *c);
+void cond_wait(user_cond_t *c, user_mutex_t *m); // m must be held; re-acquired on return
+void cond_signal(user_cond_t *c);
+void cond_broadcast(user_cond_t *c);
+
+// Reader-Writer Lock (reader preferring, bounded)
+// Readers keep getting in while a writer waits, but only RWLOCK_READ_BATCH of
+// them: after that new readers queue behind the writer, so it can't starve.
+#define RWLOCK_READ_BATCH 16
+
+typedef struct {
+    user_mutex_t lock;      // Protects the fields below
+    user_cond_t readers_cv; // Readers waiting for the writer / the batch limit
+    user_cond_t writers_cv; // Writers waiting for the lock to drain
+    int readers;            // Active readers
+    int writer;             // 1 while a writer holds the lock
+    int writers_waiting;
+    int batch;              // Readers admitted since a writer started waiting
+} user_rwlock_t;
+
+void rwlock_init(user_rwlock_t *rw);
+void rwlock_read_lock(user_rwlock_t *rw);
+void rwlock_read_unlock(user_rwlock_t *rw);
+void rwlock_write_lock(user_rwlock_t *rw);
+void rwlock_write_unlock(user_rwlock_t *rw);
+
+// Barrier: blocks until 'count' threads have arrived, then releases them all
+#define BARRIER_SERIAL_THREAD 1 // Returned to exactly one thread per round
+
+typedef struct {
+    user_mutex_t lock;
+    user_cond_t cv;
+    int count;              // Threads per round
+    int waiting;            // Arrived in the current round
+    int generation;         // Rounds completed (waiters sleep until it changes)
+} user_barrier_t;
+
+void barrier_init(user_barrier_t *b, int count);
+int barrier_wait(user_barrier_t *b); // BARRIER_SERIAL_THREAD or 0
+
+// Lock-Free Bounded Queues (items are ints)
+// push/pop never take a lock; the blocking variants fall back to a futex only
+// while the queue is full (producers) or empty (consumers).
+#define QUEUE_SIZE 64 // Slots per queue (power of two)
+
+// Sleep/wake point used by the blocking queue operations
+typedef struct {
+    volatile int seq;      // Bumped by every notify that found waiters
+    volatile int waiters;  // Threads between prepare and wake up
+} queue_event_t;
+
+// Single Producer, Single Consumer. Each side keeps a private copy of the
+// other side's index and only re-reads the shared one when the copy says
+// full/empty, so the index cache lines rarely bounce between CPUs.
+typedef struct {
+    volatile unsigned int head __attribute__((aligned(64))); // Next slot to pop (consumer)
+    unsigned int cached_tail;    // Consumer's copy of tail
+    volatile unsigned int tail __attribute__((aligned(64))); // Next slot to push (producer)
+    unsigned int cached_head;    // Producer's copy of head
+    queue_event_t not_empty __attribute__((aligned(64)));
+    queue_event_t not_full;
+    int slots[QUEUE_SIZE] __attribute__((aligned(64)));
+} spsc_queue_t;
+
+void spsc_init(spsc_queue_t *q);
+int spsc_try_push(spsc_queue_t *q, int item); // 1 = pushed, 0 = full
+int spsc_try_pop(spsc_queue_t *q, int *item); // 1 = popped, 0 = empty
+void spsc_push(spsc_queue_t *q, int item);    // Sleeps while full
+int spsc_pop(spsc_queue_t *q);                // Sleeps while empty
+
+// Multi Producer, Multi Consumer (bounded queue with per-slot sequence
+// numbers, after Dmitry Vyukov): one CAS per operation on the position.
+typedef struct {
+    volatile unsigned int seq; // pos: free for the push at pos, pos+1: holds that item
+    int item;
+} mpmc_cell_t;
+
+typedef struct {
+    volatile unsigned int enqueue_pos __attribute__((aligned(64)));
+    volatile unsigned int dequeue_pos __attribute__((aligned(64)));
+    queue_event_t not_empty __attribute__((aligned(64)));
+    queue_event_t not_full;
+    mpmc_cell_t cells[QUEUE_SIZE] __attribute__((aligned(64)));
+} mpmc_queue_t;
+
+void mpmc_init(mpmc_queue_t *q);
+int mpmc_try_push(mpmc_queue_t *q, int item);
+int mpmc_try_pop(mpmc_queue_t *q, int *item);
+void mpmc_push(mpmc_queue_t *q, int item);
+int mpmc_pop(mpmc_queue_t *q);
+
+// Work-Stealing Thread Pool
+// Every worker owns a Chase-Lev deque: it pushes and pops work at the bottom,
+// idle workers steal from the top of a random victim. The thread that called
+// pool_init is worker 0 and helps while it waits in parallel_for. Workers
+// with nothing to steal sleep on a futex until new work is pushed.
+#define POOL_MAX_WORKERS 8
+#define POOL_DEQUE_SIZE  128  // Tasks per deque (power of two)
+#define POOL_STACK_SIZE  8192
+
+// One chunk of a parallel_for: body(arg, begin, end), split while larger than grain
+typedef struct {
+    void (*body)(void *arg, int begin, int end);
+    void *arg;
+    int begin, end;
+    int grain;
+    volatile int *pending;  // Chunks of this parallel_for still to run
+} pool_task_t;
+
+typedef struct {
+    volatile int top;       // Thieves take from here (CAS)
+    volatile int bottom;    // Owner pushes/pops here
+    pool_task_t tasks[POOL_DEQUE_SIZE];
+} pool_deque_t;
+
+struct pool;
+
+typedef struct {
+    pool_deque_t deque __attribute__((aligned(64)));
+    struct pool *pool;
+    int tid;                // Thread ID (0 until the thread is running)
+    unsigned int rand;      // Victim selection (xorshift)
+    unsigned int executed;  // Chunks run by this worker
+    unsigned int steals;    // Chunks stolen from other workers
+    char stack[POOL_STACK_SIZE] __attribute__((aligned(16)));
+} pool_worker_t;
+
+typedef struct pool {
+    int nworkers;           // Including worker 0 (the creating thread)
+    volatile int shutdown;
+    queue_event_t work;     // Idle workers park here
+    pool_worker_t workers[POOL_MAX_WORKERS];
+} pool_t;
+
+void pool_init(pool_t *pool, int nworkers); // nworkers <= 0: one per CPU
+void pool_shutdown(pool_t *pool);           // Stops and reaps the worker threads
+void pool_print_stats(pool_t *pool);
+// Run body over [begin, end) in chunks of at most 'grain' iterations and wait
+// for all of them. Callable from worker 0 or from inside another body.
+void parallel_for(pool_t *pool, int begin, int end, int grain,
+                  void (*body)(void *arg, int begin, int end), void *arg);
+
+// Green Threads (cooperative user-space coroutines, M:N)
+// A coroutine switch saves the callee-saved registers and ESP and jumps to
+// another stack: no trap, no kernel PCB. green_run() multiplexes all spawned
+// coroutines onto a few kernel threads ("carriers") sharing one run queue.
+// Coroutines run until they yield, block (join/event) or return.
+#define GREEN_MAX_CARRIERS 4
+#define GREEN_CARRIER_STACK 8192
+
+#define GREEN_READY    0
+#define GREEN_RUNNING  1
+#define GREEN_BLOCKED  2
+#define GREEN_EXITING  3 // Returned, the carrier still has to retire it
+#define GREEN_DONE     4 // Retired: green_t and stack may be reused
+
+typedef struct green {
+    unsigned int esp;        // Saved stack pointer while switched out
+    volatile int state;      // GREEN_*
+    void (*func)(void *arg);
+    void *arg;
+    struct green *next;      // Run queue / wait list link
+    volatile int lock;       // Protects state changes to DONE and 'joiners'
+    struct green *joiners;   // Coroutines waiting in green_join
+} green_t;
+
+// One-shot event a coroutine can await (green_event_wait) until set
+typedef struct {
+    volatile int lock;
+    volatile int set;
+    green_t *waiters;
+} green_event_t;
+
+// Create a coroutine on a caller-provided stack (runnable once green_run starts)
+void green_spawn(green_t *g, void (*func)(void *arg), void *arg, void *stack, int stack_size);
+void green_run(int ncarriers);      // Run until every coroutine has finished
+void green_yield();                 // Let other coroutines run
+void green_join(green_t *g);        // Await coroutine g (from a coroutine)
+void green_exit();                  // End the calling coroutine (same as returning)
+green_t *green_self();
+void green_event_init(green_event_t *e);
+void green_event_wait(green_event_t *e); // Await until set (returns at once if it is)
+void green_event_set(green_event_t *e);  // Wake every waiter
+unsigned int green_switches();       // Coroutine switches so far (all carriers)
+
+// Batched Syscall Ring (io_uring-style)
+// Mirror of kernel/ring.h — keep both in sync!
+// Queue many operations, then hand them to the kernel with ONE trap.
+#define RING_ENTRIES       32
+#define RING_OP_NOP        0
+#define RING_OP_WRITE      1
+#define RING_OP_READ       2
+#define RING_OP_FUTEX_WAKE 3
+#define RING_OP_SPAWN      4
+
+typedef struct {
+    unsigned int op;
+    int fd;
+    unsigned int addr;
+    unsigned int len;
+    unsigned int user_data;
+} ring_sqe_t;
+
+typedef struct {
+    unsigned int user_data;
+    int res;
+} ring_cqe_t;
+
+typedef struct {
+    volatile unsigned int sq_head;   // Kernel consumes here
+    volatile unsigned int sq_tail;   // We produce here
+    volatile unsigned int cq_head;   // We consume here
+    volatile unsigned int cq_tail;   // Kernel produces here
+    ring_sqe_t sqes[RING_ENTRIES];
+    ring_cqe_t cqes[RING_ENTRIES];
+} syscall_ring_t;
+
+int ring_setup(syscall_ring_t *ring);             // Register ring for the calling thread (syscall 15)
+ring_sqe_t *ring_get_sqe(syscall_ring_t *ring);   // Claim the next SQE (NULL if SQ is full)
+int ring_submit(syscall_ring_t *ring);            // Process all queued SQEs (syscall 16)
+ring_cqe_t *ring_peek_cqe(syscall_ring_t *ring);  // Oldest unread completion (NULL if none)
+void ring_cqe_seen(syscall_ring_t *ring);         // Release the CQE returned by ring_peek_cqe
+void ring_flush(syscall_ring_t *ring);            // Submit and discard all completions
+void ring_prep_write(ring_sqe_t *sqe, int fd, char *buf, int len);
+void ring_prep_read(ring_sqe_t *sqe, int fd, char *buf, int len);
+void ring_prep_futex_wake(ring_sqe_t *sqe, volatile int *addr, int n); // Wake up to n waiters
+void ring_prep_spawn(ring_sqe_t *sqe, char *filename);
+void ring_print(syscall_ring_t *ring, char *str); // Queue a stdout write (buffer must live until flush)
+
 #endif
@@ -0,0 +1,92 @@
+#include "lib.h"
+
+// Priority Inheritance Demo
+// A low-priority owner holds a PI mutex, CPU hogs of medium priority keep
+// every CPU busy, and the high-priority main thread wants the lock.
+// Without PI the owner never runs again until the hogs stop (priority
+// inversion). With PI it inherits main's priority, finishes its critical
+// section and hands the lock over while the hogs are still spinning.
+
+#define PRIO_OWNER 2
+#define PRIO_HOG   5
+#define PRIO_MAIN  PRIO_DEFAULT
+#define HOG_MS     3000      // Hogs give up after this long (ends the demo without PI)
+#define OWNER_WORK 20000000  // Critical section length (loop iterations)
+
+user_pi_mutex_t lock;
+volatile int owner_ready = 0; // Futex word: the owner holds the lock
+volatile int hogs_stop = 0;
+volatile int hogs_running = 0;
+unsigned int hog_deadline;
+
+char owner_stack[4096];
+char hog_stacks[VDSO_MAX_CPUS][4096];
+
+void owner(void *arg)
+{
+    setprio(0, PRIO_OWNER); // Lowering ourselves is always allowed
+
+    pi_mutex_lock(&lock);
+    owner_ready = 1;
+    futex_wake(&owner_ready, 1);
+
+    // Critical section: only gets CPU time over the hogs if it is boosted
+    for (volatile int i = 0; i < OWNER_WORK; i++);
+
+    pi_mutex_unlock(&lock);
+}
+
+void hog(void *arg)
+{
+    setprio(0, PRIO_HOG);
+    __sync_fetch_and_add(&hogs_running, 1);
+    while (!hogs_stop && uptime_ms() < hog_deadline) {
+        __asm__ volatile("pause");
+    }
+    __sync_fetch_and_sub(&hogs_running, 1);
+}
+
+int main()
+{
+    int ncpus = getncpus();
+    if (ncpus > VDSO_MAX_CPUS) ncpus = VDSO_MAX_CPUS;
+    pi_mutex_init(&lock);
+
+    print("PI Demo: owner prio "); print_dec(PRIO_OWNER);
+    print(", "); print_dec(ncpus); print(" hog(s) prio "); print_dec(PRIO_HOG);
+    print(", waiter (main) prio "); print_dec(PRIO_MAIN); print("\n");
+
+    // Raising ourselves above PRIO_DEFAULT is refused
+    if (setprio(0, PRIO_MAX) != -1) print("PI DEMO FAILED: setprio raised us to PRIO_MAX\n");
+
+    // 1. The owner takes the lock before any hog exists
+    thread_create(owner, 0, owner_stack + 4096);
+    while (!owner_ready) futex_wait(&owner_ready, 0, 0);
+
+    // 2. One hog per CPU: the owner's CPU has one too
+    hog_deadline = uptime_ms() + HOG_MS;
+    for (int i = 0; i < ncpus; i++) {
+        thread_create(hog, 0, hog_stacks[i] + 4096);
+    }
+    while (hogs_running < ncpus && uptime_ms() < hog_deadline) {
+        futex_wait(&hogs_running, hogs_running, 1);
+    }
+
+    // 3. Block on the lock: the kernel boosts the owner to our priority
+    unsigned int start = uptime_ms();
+    pi_mutex_lock(&lock);
+    unsigned int waited = uptime_ms() - start;
+    int inverted = hogs_running == 0; // Only got it once the hogs gave up
+    pi_mutex_unlock(&lock);
+
+    hogs_stop = 1;
+    for (int i = 0; i < ncpus + 1; i++) wait(0);
+
+    print("Main waited "); print_dec(waited); print(" ms for the lock.\n");
+    if (inverted) {
+        print("PI DEMO FAILED: owner starved until the hogs stopped (no boost).\n");
+    } else {
+        print("PI DEMO PASSED: owner was boosted past the hogs.\n");
+    }
+    exit(0);
+}
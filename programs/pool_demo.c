@@ -0,0 +1,106 @@
+// pool_demo.c
+// Work-stealing thread pool demo: a 128x128 integer matrix multiply.
+//
+// The product is computed twice with parallel_for over the rows of C:
+//   1. A pool with 1 worker (just this thread) -> serial baseline
+//   2. A pool with one worker per CPU          -> rows are split and stolen
+// Both results must match; the run times show how the work scales.
+
+#include "lib.h"
+
+#define N     128
+#define GRAIN 4   // Rows per chunk: 32 chunks to spread over the workers
+
+int A[N][N];
+int B[N][N];
+int C[N][N];
+
+pool_t pool;
+
+// parallel_for body: rows [begin, end) of C = A * B
+void matmul_rows(void *arg, int begin, int end)
+{
+    for (int i = begin; i < end; i++) {
+        for (int j = 0; j < N; j++) {
+            int sum = 0;
+            for (int k = 0; k < N; k++) {
+                sum += A[i][k] * B[k][j];
+            }
+            C[i][j] = sum;
+        }
+    }
+}
+
+unsigned int checksum()
+{
+    unsigned int sum = 0;
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            sum = sum * 31 + C[i][j];
+        }
+    }
+    return sum;
+}
+
+// Multiply with a pool of 'nworkers' threads, return the time in ms
+unsigned int run(int nworkers, unsigned int *sum)
+{
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            C[i][j] = 0;
+        }
+    }
+
+    pool_init(&pool, nworkers);
+
+    unsigned int start_ms = uptime_ms();
+    parallel_for(&pool, 0, N, GRAIN, matmul_rows, 0);
+    unsigned int elapsed_ms = uptime_ms() - start_ms;
+
+    *sum = checksum();
+
+    print("Workers: ");
+    print_dec(pool.nworkers);
+    print(" -> ");
+    print_dec(elapsed_ms);
+    print(" ms\n");
+    pool_print_stats(&pool);
+
+    pool_shutdown(&pool);
+    return elapsed_ms;
+}
+
+int main()
+{
+    print("=== Work-Stealing Pool: ");
+    print_dec(N);
+    print("x");
+    print_dec(N);
+    print(" matrix multiply ===\n");
+
+    for (int i = 0; i < N; i++) {
+        for (int j = 0; j < N; j++) {
+            A[i][j] = (i + j) % 7;
+            B[i][j] = (i * j) % 5;
+        }
+    }
+
+    unsigned int serial_sum, parallel_sum;
+    unsigned int serial_ms = run(1, &serial_sum);
+    unsigned int parallel_ms = run(0, &parallel_sum);
+
+    if (serial_sum != parallel_sum) {
+        print("RESULT MISMATCH!\n");
+        exit(1);
+    }
+
+    // Speedup with one decimal, in integer math
+    if (parallel_ms == 0) parallel_ms = 1;
+    unsigned int speedup10 = serial_ms * 10 / parallel_ms;
+    print("Results match. Speedup: ");
+    print_dec(speedup10 / 10);
+    print(".");
+    print_dec(speedup10 % 10);
+    print("x\n");
+    exit(0);
+}
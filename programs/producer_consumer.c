@@ -11,6 +11,13 @@
 // With 2 producers competing for empty slots and 4 consumers competing for
 // items, semaphore contention is maximized — showing FIFO fairness and mutex
 // necessity clearly.
+//
+// Each thread logs through its own batched syscall ring: the 5 pieces of a
+// log line are queued and written with a single ring_enter trap.
+//
+// Afterwards a silent throughput run moves BENCH_ITEMS items from one
+// producer to one consumer three ways: the semaphore + mutex buffer above,
+// the lock-free SPSC queue and the lock-free MPMC queue (lib.c).
 
 #include "lib.h"
 
@@ -32,10 +39,104 @@ user_mutex_t buf_lock;  // Protects head/tail indices
 char p1_stack[4096], p2_stack[4096];
 char c1_stack[4096], c2_stack[4096], c3_stack[4096], c4_stack[4096];
 
+// --- Per-Thread Syscall Rings (a ring belongs to the thread that registered it) ---
+syscall_ring_t producer_rings[2];
+syscall_ring_t consumer_rings[4];
+
+// --- Throughput Benchmark ---
+#define BENCH_ITEMS 20000
+
+volatile int bench_buf[QUEUE_SIZE];
+volatile int bench_head = 0, bench_tail = 0;
+spsc_queue_t bench_spsc;
+mpmc_queue_t bench_mpmc;
+volatile int bench_sum = 0; // Consumer's checksum: 1 + 2 + ... + BENCH_ITEMS
+
+void sem_bench_producer(void *arg)
+{
+    for (int i = 1; i <= BENCH_ITEMS; i++) {
+        sem_wait(&empty_sem);
+        mutex_lock(&buf_lock);
+        bench_buf[bench_tail] = i;
+        bench_tail = (bench_tail + 1) % QUEUE_SIZE;
+        mutex_unlock(&buf_lock);
+        sem_post(&full_sem);
+    }
+}
+
+void sem_bench_consumer(void *arg)
+{
+    int sum = 0;
+    for (int i = 0; i < BENCH_ITEMS; i++) {
+        sem_wait(&full_sem);
+        mutex_lock(&buf_lock);
+        sum += bench_buf[bench_head];
+        bench_head = (bench_head + 1) % QUEUE_SIZE;
+        mutex_unlock(&buf_lock);
+        sem_post(&empty_sem);
+    }
+    bench_sum = sum;
+}
+
+void spsc_bench_producer(void *arg)
+{
+    for (int i = 1; i <= BENCH_ITEMS; i++) spsc_push(&bench_spsc, i);
+}
+
+void spsc_bench_consumer(void *arg)
+{
+    int sum = 0;
+    for (int i = 0; i < BENCH_ITEMS; i++) sum += spsc_pop(&bench_spsc);
+    bench_sum = sum;
+}
+
+void mpmc_bench_producer(void *arg)
+{
+    for (int i = 1; i <= BENCH_ITEMS; i++) mpmc_push(&bench_mpmc, i);
+}
+
+void mpmc_bench_consumer(void *arg)
+{
+    int sum = 0;
+    for (int i = 0; i < BENCH_ITEMS; i++) sum += mpmc_pop(&bench_mpmc);
+    bench_sum = sum;
+}
+
+// Run one producer/consumer pair to completion and report items per ms
+void run_bench(char *name, void (*prod)(void *), void (*cons)(void *))
+{
+    int status;
+    bench_sum = 0;
+
+    unsigned int start_ms = uptime_ms();
+    thread_create(prod, 0, p1_stack + 4096); // Demo threads are gone: reuse stacks
+    thread_create(cons, 0, c1_stack + 4096);
+    wait(&status);
+    wait(&status);
+    unsigned int elapsed_ms = uptime_ms() - start_ms;
+
+    print(name);
+    print(": ");
+    print_dec(elapsed_ms);
+    print(" ms, ");
+    print_dec(BENCH_ITEMS / (elapsed_ms ? elapsed_ms : 1));
+    print(" items/ms");
+    if (bench_sum != BENCH_ITEMS / 2 * (BENCH_ITEMS + 1)) {
+        print(" CHECKSUM MISMATCH!");
+    }
+    print("\n");
+}
+
 // --- Producer Thread ---
 void producer(void *arg)
 {
     int id = *(int *)arg;
+    syscall_ring_t *ring = &producer_rings[id - 1];
+    ring_setup(ring);
+
+    char id_str[12];
+    format_dec(id_str, id);
+
     for (int i = 0; i < PRODUCE_COUNT; i++) {
         int item = id * 100 + i; // e.g. Producer 1 -> 100~109, Producer 2 -> 200~209
 
@@ -46,25 +147,36 @@ void producer(void *arg)
         mutex_lock(&buf_lock);
         buffer[buf_tail] = item;
         buf_tail = (buf_tail + 1) % BUFFER_SIZE;
-        print("[P");
-        print_dec(id);
-        print("] Produced: ");
-        print_dec(item);
-        print("\n");
+
+        char item_str[12];
+        format_dec(item_str, item);
+        ring_print(ring, "[P");
+        ring_print(ring, id_str);
+        ring_print(ring, "] Produced: ");
+        ring_print(ring, item_str);
+        ring_print(ring, "\n");
+        ring_flush(ring); // 1 trap for the whole line
         mutex_unlock(&buf_lock);
 
         // 3. Signal that one more item is available
         sem_post(&full_sem);
     }
-    print("[P");
-    print_dec(id);
-    print("] Done.\n");
+    ring_print(ring, "[P");
+    ring_print(ring, id_str);
+    ring_print(ring, "] Done.\n");
+    ring_flush(ring);
 }
 
 // --- Consumer Thread ---
 void consumer(void *arg)
 {
     int id = *(int *)arg;
+    syscall_ring_t *ring = &consumer_rings[id - 1];
+    ring_setup(ring);
+
+    char id_str[12];
+    format_dec(id_str, id);
+
     for (int i = 0; i < CONSUME_COUNT; i++) {
         // 1. Wait until an item is available (blocks if buffer is empty)
         sem_wait(&full_sem);
@@ -73,19 +185,24 @@ void consumer(void *arg)
         mutex_lock(&buf_lock);
         int item = buffer[buf_head];
         buf_head = (buf_head + 1) % BUFFER_SIZE;
-        print("  [C");
-        print_dec(id);
-        print("] Consumed: ");
-        print_dec(item);
-        print("\n");
+
+        char item_str[12];
+        format_dec(item_str, item);
+        ring_print(ring, "  [C");
+        ring_print(ring, id_str);
+        ring_print(ring, "] Consumed: ");
+        ring_print(ring, item_str);
+        ring_print(ring, "\n");
+        ring_flush(ring); // 1 trap for the whole line
         mutex_unlock(&buf_lock);
 
         // 3. Signal that one slot is now free
         sem_post(&empty_sem);
     }
-    print("  [C");
-    print_dec(id);
-    print("] Done.\n");
+    ring_print(ring, "  [C");
+    ring_print(ring, id_str);
+    ring_print(ring, "] Done.\n");
+    ring_flush(ring);
 }
 
 int main()
@@ -99,6 +216,8 @@ int main()
     print("Buffer: 5 | Producers: 2x10 | Consumers: 4x5 | Total: 20 items\n");
     print("-----------------------------------------\n");
 
+    unsigned int start_ms = uptime_ms();
+
     // Thread IDs
     int p1 = 1, p2 = 2;
     int c1 = 1, c2 = 2, c3 = 3, c4 = 4;
@@ -122,5 +241,27 @@ int main()
 
     print("-----------------------------------------\n");
     print("=== All threads finished. 20/20 items ===\n");
+
+    // Benchmark: run time and how contended the buffer lock was
+    print("Elapsed: ");
+    print_dec(uptime_ms() - start_ms);
+    print(" ms\n");
+    mutex_print_stats("buf_lock", &buf_lock);
+
+    // Throughput: same item count, 1 producer -> 1 consumer, QUEUE_SIZE slots each
+    print("=== Throughput (");
+    print_dec(BENCH_ITEMS);
+    print(" items, 1P / 1C) ===\n");
+
+    sem_init(&empty_sem, QUEUE_SIZE);
+    sem_init(&full_sem, 0);
+    mutex_init(&buf_lock);
+    run_bench("semaphore+mutex", sem_bench_producer, sem_bench_consumer);
+
+    spsc_init(&bench_spsc);
+    run_bench("lock-free SPSC ", spsc_bench_producer, spsc_bench_consumer);
+
+    mpmc_init(&bench_mpmc);
+    run_bench("lock-free MPMC ", mpmc_bench_producer, mpmc_bench_consumer);
     exit(0);
 }
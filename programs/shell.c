@@ -41,12 +41,23 @@ void main() {
         if (index == 0) continue;
 
         if (strcmp(buffer, "help") == 0) {
-            print("Commands: help, ls, exec <file>, exit\n");
+            print("Commands: help, ls, cat <file>, exec <file>, sysstat [reset], exit\n");
         } else if (strcmp(buffer, "exit") == 0) {
             print("Bye!\n");
             exit(0);
         } else if (strcmp(buffer, "ls") == 0) {
             ls();
+        } else if (strcmp(buffer, "sysstat") == 0) {
+            sysstat(0);
+        } else if (strcmp(buffer, "sysstat reset") == 0) {
+            sysstat(1);
+            print("Syscall statistics cleared.\n");
+        } else if (buffer[0] == 'c' && buffer[1] == 'a' && buffer[2] == 't' && buffer[3] == ' ') {
+            if (cat(buffer + 4) < 0) {
+                print("File not found: ");
+                print(buffer + 4);
+            }
+            print("\n");
         } else {
             // Check for 'exec '
             if (buffer[0] == 'e' && buffer[1] == 'x' && buffer[2] == 'e' && buffer[3] == 'c' && buffer[4] == ' ') {
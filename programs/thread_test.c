@@ -13,8 +13,14 @@ void worker(void *arg)
     print_dec(id);
     print(" starting...\n");
 
+    // Per-thread floating point accumulator: stays correct only if the kernel
+    // preserves each thread's FPU/SSE registers across context switches.
+    double fsum = 0.0;
+
     for (int i = 0; i < 10000; i++)
     {
+        fsum += 0.5 * id;
+
         // 1. Acquire Lock
         mutex_lock(&counter_lock);
         
@@ -34,6 +40,12 @@ void worker(void *arg)
         mutex_unlock(&counter_lock);
     }
 
+    // 10000 * 0.5 * id is exact in binary floating point
+    if (fsum != 5000.0 * id) {
+        print("Thread ");
+        print_dec(id);
+        print(": FPU STATE CORRUPTED!\n");
+    }
 
     print("Thread ");
     print_dec(id);
@@ -47,11 +59,168 @@ char stack1[4096];
 char stack2[4096];
 char stack3[4096];
 
+// ---------------------------------------------------------
+// Condition variable, reader-writer lock and barrier checks
+// ---------------------------------------------------------
+#define SYNC_THREADS   4
+#define RW_WRITES      200     // Writer iterations
+#define RW_READ_MAX    200000  // Reader iterations before giving up on the writer
+#define BARRIER_ROUNDS 50
+
+char sync_stacks[SYNC_THREADS][4096];
+int sync_ids[SYNC_THREADS];
+volatile int sync_errors = 0;
+
+void sync_start(void (*func)(void *))
+{
+    for (int i = 0; i < SYNC_THREADS; i++) {
+        sync_ids[i] = i;
+        thread_create(func, &sync_ids[i], sync_stacks[i] + 4096);
+    }
+}
+
+void sync_join(int n)
+{
+    int status;
+    for (int i = 0; i < n; i++) wait(&status);
+}
+
+void sync_report(char *what)
+{
+    print(sync_errors ? "SYNC TEST FAILED: " : "SYNC TEST PASSED: ");
+    print(what);
+    print("\n");
+    sync_errors = 0;
+}
+
+// 1. Broadcast: every waiter sleeps on go_cv, one broadcast must release all
+// of them (one woken, the rest requeued onto cv_lock and handed it in turn)
+user_mutex_t cv_lock;
+user_cond_t go_cv, arrived_cv;
+int cv_arrived = 0, cv_go = 0, cv_woken = 0;
+
+void cv_waiter(void *arg)
+{
+    mutex_lock(&cv_lock);
+    cv_arrived++;
+    cond_signal(&arrived_cv);
+    while (!cv_go) cond_wait(&go_cv, &cv_lock);
+    cv_woken++;
+    mutex_unlock(&cv_lock);
+}
+
+void cond_test()
+{
+    mutex_init(&cv_lock);
+    cond_init(&go_cv);
+    cond_init(&arrived_cv);
+    sync_start(cv_waiter);
+
+    mutex_lock(&cv_lock);
+    while (cv_arrived < SYNC_THREADS) cond_wait(&arrived_cv, &cv_lock);
+    cv_go = 1;
+    cond_broadcast(&go_cv);
+    mutex_unlock(&cv_lock);
+
+    sync_join(SYNC_THREADS);
+    if (cv_woken != SYNC_THREADS) sync_errors++;
+    sync_report("cond_broadcast woke every waiter");
+}
+
+// 2. Reader-writer lock: readers hammer it without pause while one writer
+// updates a pair of values. Readers must never see a half-written pair, the
+// writer must never overlap a reader, and the reader batch limit must let
+// the writer finish before the readers give up.
+user_rwlock_t rw;
+volatile int rw_a = 0, rw_b = 0;
+volatile int rw_active = 0, rw_max_active = 0;
+volatile int rw_writer_done = 0, rw_starved = 0;
+
+void rw_reader(void *arg)
+{
+    int i = 0;
+    while (!rw_writer_done) {
+        if (++i > RW_READ_MAX) {
+            rw_starved = 1;
+            break;
+        }
+        rwlock_read_lock(&rw);
+        int active = __sync_add_and_fetch(&rw_active, 1);
+        if (active > rw_max_active) rw_max_active = active; // Statistic only
+        if (rw_a != rw_b) __sync_fetch_and_add(&sync_errors, 1);
+        __sync_fetch_and_sub(&rw_active, 1);
+        rwlock_read_unlock(&rw);
+    }
+}
+
+void rw_writer(void *arg)
+{
+    for (int i = 1; i <= RW_WRITES; i++) {
+        rwlock_write_lock(&rw);
+        if (rw_active != 0) __sync_fetch_and_add(&sync_errors, 1);
+        rw_a = i;
+        for (volatile int j = 0; j < 100; j++);
+        rw_b = i;
+        rwlock_write_unlock(&rw);
+    }
+    rw_writer_done = 1;
+}
+
+void rwlock_test()
+{
+    rwlock_init(&rw);
+    for (int i = 0; i < SYNC_THREADS; i++) {
+        sync_ids[i] = i;
+        thread_create(i == 0 ? rw_writer : rw_reader, &sync_ids[i], sync_stacks[i] + 4096);
+    }
+    sync_join(SYNC_THREADS);
+
+    if (rw_starved || rw_b != RW_WRITES) sync_errors++;
+    print("rwlock: max concurrent readers = ");
+    print_dec(rw_max_active);
+    print(rw_starved ? ", writer STARVED\n" : ", writer finished\n");
+    sync_report("rwlock readers/writer exclusion");
+}
+
+// 3. Barrier: each round every thread publishes the round number, and after
+// the barrier all of them must see everybody's number. A second barrier keeps
+// fast threads from starting the next round early.
+user_barrier_t barrier;
+volatile int barrier_slots[SYNC_THREADS];
+volatile int barrier_serial = 0;
+
+void barrier_worker(void *arg)
+{
+    int id = *(int *)arg;
+    for (int round = 1; round <= BARRIER_ROUNDS; round++) {
+        barrier_slots[id] = round;
+        if (barrier_wait(&barrier) == BARRIER_SERIAL_THREAD) __sync_fetch_and_add(&barrier_serial, 1);
+        for (int i = 0; i < SYNC_THREADS; i++) {
+            if (barrier_slots[i] != round) __sync_fetch_and_add(&sync_errors, 1);
+        }
+        if (barrier_wait(&barrier) == BARRIER_SERIAL_THREAD) __sync_fetch_and_add(&barrier_serial, 1);
+    }
+}
+
+void barrier_test()
+{
+    barrier_init(&barrier, SYNC_THREADS);
+    sync_start(barrier_worker);
+    sync_join(SYNC_THREADS);
+
+    // Exactly one serial thread per round, two barriers per loop
+    if (barrier_serial != 2 * BARRIER_ROUNDS) sync_errors++;
+    sync_report("barrier rounds");
+}
+
 int main()
 {   
     mutex_init(&counter_lock);
     print("Thread Test: 3 Threads incrementing counter 10000 times.\n");
 
+    // Benchmark: total run time plus the lock's contention counters
+    unsigned int start_ms = uptime_ms();
+
     int id1 = 1, id2 = 2, id3 = 3;
 
     // Create Threads
@@ -80,7 +249,14 @@ int main()
     wait(&status);
     wait(&status);
 
-    print("All threads finished.\n");
+    unsigned int elapsed_ms = uptime_ms() - start_ms;
+
+    print("All threads finished in ");
+    print_dec(elapsed_ms);
+    print(" ms (");
+    print_dec(getncpus());
+    print(" CPUs).\n");
+    mutex_print_stats("counter_lock", &counter_lock);
     print("Final Counter Value: ");
     print_dec(counter);
     print("\n");
@@ -94,5 +270,9 @@ int main()
     {
         print("Success? (Or just lucky)\n");
     }
+
+    cond_test();
+    rwlock_test();
+    barrier_test();
     exit(0);
 }
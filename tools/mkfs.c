@@ -88,8 +88,11 @@ int main(int argc, char *argv[])
     sb.total_blocks = DISK_SIZE / PROJ_BLOCK_SIZE;
     sb.inode_bitmap_block = sb_block_idx + 1; // Sector 18
     sb.inode_table_block = sb_block_idx + 2;  // Sector 19
-    sb.data_block_start = sb_block_idx + 10;  // Sector 27
-    sb.num_inodes = (sb.data_block_start - sb.inode_table_block) * (PROJ_BLOCK_SIZE / sizeof(sfs_inode));
+    sb.block_bitmap_block = sb_block_idx + 10; // Sector 27
+    sb.block_bitmap_blocks = (sb.total_blocks + PROJ_BLOCK_SIZE * 8 - 1) / (PROJ_BLOCK_SIZE * 8);
+    sb.data_block_start = sb.block_bitmap_block + sb.block_bitmap_blocks;
+    sb.num_inodes = (sb.block_bitmap_block - sb.inode_table_block) * (PROJ_BLOCK_SIZE / sizeof(sfs_inode));
+    sb.version = SIMPLEFS_VERSION;
     fseek(disk_fp, sb_block_idx * PROJ_BLOCK_SIZE, SEEK_SET);
     fwrite(&sb, 1, sizeof(sb), disk_fp);
 
@@ -122,18 +125,12 @@ int main(int argc, char *argv[])
         kernel_inode.size = kernel_size;
 
         // Calculate and Assign Data Blocks
-        // Assuming kernel fits in contiguous blocks starting at data_block_start
+        // The kernel is stored in contiguous blocks starting at data_block_start,
+        // i.e. ONE extent however big it is. The loader relies on that: it
+        // only reads extents[0].start and the size.
         uint32_t needed_blocks = (kernel_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
-        if (needed_blocks > 64)
-        {
-            printf("WARNING: Kernel too big (%d blocks) for direct blocks! Only first 64 blocks will be indexed.\n", needed_blocks);
-            needed_blocks = 64; // Truncate for now as per simple design
-        }
-
-        for (uint32_t i = 0; i < needed_blocks; i++)
-        {
-            kernel_inode.blocks[i] = next_free_block + i;
-        }
+        kernel_inode.extents[0].start = next_free_block;
+        kernel_inode.extents[0].length = needed_blocks;
 
         // Write Inode to Inode Table (Sector 19)
         // Position: Start of Sector 19 (first inode)
@@ -176,10 +173,9 @@ int main(int argc, char *argv[])
         
         uint32_t needed_blocks = (prog_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
         
-        for (uint32_t i = 0; i < needed_blocks; i++)
-        {
-            prog_inode.blocks[i] = next_free_block + i;
-        }
+        // Contiguous: a single extent
+        prog_inode.extents[0].start = next_free_block;
+        prog_inode.extents[0].length = needed_blocks;
 
         // Write Inode to Inode Table (Sector 19)
         // Index 1 (Second inode)
@@ -222,10 +218,9 @@ int main(int argc, char *argv[])
         
         uint32_t needed_blocks = (shell_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
         
-        for (uint32_t i = 0; i < needed_blocks; i++)
-        {
-            shell_inode.blocks[i] = next_free_block + i;
-        }
+        // Contiguous: a single extent
+        shell_inode.extents[0].start = next_free_block;
+        shell_inode.extents[0].length = needed_blocks;
 
         // Write Inode to Inode Table (Sector 19)
         // Index 2 (Third inode)
@@ -265,9 +260,9 @@ int main(int argc, char *argv[])
         
         uint32_t needed_blocks = (cow_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
         
-        for (uint32_t i = 0; i < needed_blocks; i++) {
-            cow_inode.blocks[i] = next_free_block + i;
-        }
+        // Contiguous: a single extent
+        cow_inode.extents[0].start = next_free_block;
+        cow_inode.extents[0].length = needed_blocks;
 
         // Write Inode to Inode Table (Sector 19)
         // Index 3 (Fourth inode)
@@ -307,9 +302,9 @@ int main(int argc, char *argv[])
         
         uint32_t needed_blocks = (thread_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
         
-        for (uint32_t i = 0; i < needed_blocks; i++) {
-            thread_inode.blocks[i] = next_free_block + i;
-        }
+        // Contiguous: a single extent
+        thread_inode.extents[0].start = next_free_block;
+        thread_inode.extents[0].length = needed_blocks;
 
         // Write Inode to Inode Table (Sector 19)
         // Index 4 (Fifth inode)
@@ -349,9 +344,9 @@ int main(int argc, char *argv[])
 
         uint32_t needed_blocks = (pc_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
 
-        for (uint32_t i = 0; i < needed_blocks; i++) {
-            pc_inode.blocks[i] = next_free_block + i;
-        }
+        // Contiguous: a single extent
+        pc_inode.extents[0].start = next_free_block;
+        pc_inode.extents[0].length = needed_blocks;
 
         // Index 5 (Sixth inode)
         fseek(disk_fp, sb.inode_table_block * PROJ_BLOCK_SIZE + 5 * sizeof(sfs_inode), SEEK_SET);
@@ -370,16 +365,193 @@ int main(int argc, char *argv[])
         fclose(pc_fp);
     }
 
+    // Write pool_demo.elf Program Inode
+    printf("Writing pool_demo.elf Inode...\n");
+    FILE *pool_fp = fopen("programs/pool_demo.elf", "rb");
+    if (!pool_fp) {
+        printf("WARNING: programs/pool_demo.elf not found. Skipping.\n");
+    } else {
+        fseek(pool_fp, 0, SEEK_END);
+        uint32_t pool_size = ftell(pool_fp);
+        fseek(pool_fp, 0, SEEK_SET);
+
+        printf("pool_demo.elf size: %d bytes\n", pool_size);
+
+        sfs_inode pool_inode;
+        memset(&pool_inode, 0, sizeof(pool_inode));
+        pool_inode.used = 1;
+        strcpy(pool_inode.filename, "pool_demo.elf");
+        pool_inode.size = pool_size;
+
+        uint32_t needed_blocks = (pool_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
+
+        // Contiguous: a single extent
+        pool_inode.extents[0].start = next_free_block;
+        pool_inode.extents[0].length = needed_blocks;
+
+        // Index 6 (Seventh inode)
+        fseek(disk_fp, sb.inode_table_block * PROJ_BLOCK_SIZE + 6 * sizeof(sfs_inode), SEEK_SET);
+        fwrite(&pool_inode, 1, sizeof(pool_inode), disk_fp);
+
+        // Write Data
+        printf("Writing pool_demo.elf Data...\n");
+        uint8_t *pool_data = (uint8_t *)malloc(pool_size);
+        fread(pool_data, 1, pool_size, pool_fp);
+
+        fseek(disk_fp, next_free_block * PROJ_BLOCK_SIZE, SEEK_SET);
+        fwrite(pool_data, 1, pool_size, disk_fp);
+
+        free(pool_data);
+        next_free_block += needed_blocks;
+        fclose(pool_fp);
+    }
+
+    // Write green_demo.elf Program Inode
+    printf("Writing green_demo.elf Inode...\n");
+    FILE *green_fp = fopen("programs/green_demo.elf", "rb");
+    if (!green_fp) {
+        printf("WARNING: programs/green_demo.elf not found. Skipping.\n");
+    } else {
+        fseek(green_fp, 0, SEEK_END);
+        uint32_t green_size = ftell(green_fp);
+        fseek(green_fp, 0, SEEK_SET);
+
+        printf("green_demo.elf size: %d bytes\n", green_size);
+
+        sfs_inode green_inode;
+        memset(&green_inode, 0, sizeof(green_inode));
+        green_inode.used = 1;
+        strcpy(green_inode.filename, "green_demo.elf");
+        green_inode.size = green_size;
+
+        uint32_t needed_blocks = (green_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
+
+        // Contiguous: a single extent
+        green_inode.extents[0].start = next_free_block;
+        green_inode.extents[0].length = needed_blocks;
+
+        // Index 7 (Eighth inode)
+        fseek(disk_fp, sb.inode_table_block * PROJ_BLOCK_SIZE + 7 * sizeof(sfs_inode), SEEK_SET);
+        fwrite(&green_inode, 1, sizeof(green_inode), disk_fp);
+
+        // Write Data
+        printf("Writing green_demo.elf Data...\n");
+        uint8_t *green_data = (uint8_t *)malloc(green_size);
+        fread(green_data, 1, green_size, green_fp);
+
+        fseek(disk_fp, next_free_block * PROJ_BLOCK_SIZE, SEEK_SET);
+        fwrite(green_data, 1, green_size, disk_fp);
+
+        free(green_data);
+        next_free_block += needed_blocks;
+        fclose(green_fp);
+    }
+
+    // Write fs_test.elf Program Inode
+    printf("Writing fs_test.elf Inode...\n");
+    FILE *fst_fp = fopen("programs/fs_test.elf", "rb");
+    if (!fst_fp) {
+        printf("WARNING: programs/fs_test.elf not found. Skipping.\n");
+    } else {
+        fseek(fst_fp, 0, SEEK_END);
+        uint32_t fst_size = ftell(fst_fp);
+        fseek(fst_fp, 0, SEEK_SET);
+
+        printf("fs_test.elf size: %d bytes\n", fst_size);
+
+        sfs_inode fst_inode;
+        memset(&fst_inode, 0, sizeof(fst_inode));
+        fst_inode.used = 1;
+        strcpy(fst_inode.filename, "fs_test.elf");
+        fst_inode.size = fst_size;
+
+        uint32_t needed_blocks = (fst_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
+
+        // Contiguous: a single extent
+        fst_inode.extents[0].start = next_free_block;
+        fst_inode.extents[0].length = needed_blocks;
+
+        // Index 8 (Ninth inode)
+        fseek(disk_fp, sb.inode_table_block * PROJ_BLOCK_SIZE + 8 * sizeof(sfs_inode), SEEK_SET);
+        fwrite(&fst_inode, 1, sizeof(fst_inode), disk_fp);
+
+        // Write Data
+        printf("Writing fs_test.elf Data...\n");
+        uint8_t *fst_data = (uint8_t *)malloc(fst_size);
+        fread(fst_data, 1, fst_size, fst_fp);
+
+        fseek(disk_fp, next_free_block * PROJ_BLOCK_SIZE, SEEK_SET);
+        fwrite(fst_data, 1, fst_size, disk_fp);
+
+        free(fst_data);
+        next_free_block += needed_blocks;
+        fclose(fst_fp);
+    }
+
+    // Write pi_demo.elf Program Inode
+    printf("Writing pi_demo.elf Inode...\n");
+    FILE *pi_fp = fopen("programs/pi_demo.elf", "rb");
+    if (!pi_fp) {
+        printf("WARNING: programs/pi_demo.elf not found. Skipping.\n");
+    } else {
+        fseek(pi_fp, 0, SEEK_END);
+        uint32_t pi_size = ftell(pi_fp);
+        fseek(pi_fp, 0, SEEK_SET);
+
+        printf("pi_demo.elf size: %d bytes\n", pi_size);
+
+        sfs_inode pi_inode;
+        memset(&pi_inode, 0, sizeof(pi_inode));
+        pi_inode.used = 1;
+        strcpy(pi_inode.filename, "pi_demo.elf");
+        pi_inode.size = pi_size;
+
+        uint32_t needed_blocks = (pi_size + PROJ_BLOCK_SIZE - 1) / PROJ_BLOCK_SIZE;
+
+        // Contiguous: a single extent
+        pi_inode.extents[0].start = next_free_block;
+        pi_inode.extents[0].length = needed_blocks;
+
+        // Index 9 (Tenth inode)
+        fseek(disk_fp, sb.inode_table_block * PROJ_BLOCK_SIZE + 9 * sizeof(sfs_inode), SEEK_SET);
+        fwrite(&pi_inode, 1, sizeof(pi_inode), disk_fp);
+
+        // Write Data
+        printf("Writing pi_demo.elf Data...\n");
+        uint8_t *pi_data = (uint8_t *)malloc(pi_size);
+        fread(pi_data, 1, pi_size, pi_fp);
+
+        fseek(disk_fp, next_free_block * PROJ_BLOCK_SIZE, SEEK_SET);
+        fwrite(pi_data, 1, pi_size, disk_fp);
+
+        free(pi_data);
+        next_free_block += needed_blocks;
+        fclose(pi_fp);
+    }
+
     printf("Updating Inode Bitmap...\n");
 
     // Move to sector 18 where the bitmap is
     fseek(disk_fp, sb.inode_bitmap_block * PROJ_BLOCK_SIZE, SEEK_SET);
 
     uint8_t bitmap[512] = {0};
-    bitmap[0] = 0x3F; // 0011 1111 -> 6 inodes used (kernel, hello, shell, fork_cow, thread_test, producer_consumer)
+    bitmap[0] = 0xFF; // 1111 1111 -> 8 inodes used (kernel, hello, shell, fork_cow, thread_test, producer_consumer, pool_demo, green_demo)
+    bitmap[1] = 0x03; // 0000 0011 -> inodes 8, 9 (fs_test, pi_demo)
 
     fwrite(bitmap, 1, 512, disk_fp);
 
+    // Block bitmap: the boot area, metadata and every file written above are
+    // one used range from block 0 to next_free_block
+    printf("Writing Block Bitmap (%d blocks used)...\n", next_free_block);
+    uint8_t *block_bitmap = (uint8_t *)calloc(sb.block_bitmap_blocks * PROJ_BLOCK_SIZE, 1);
+    for (uint32_t b = 0; b < next_free_block; b++)
+    {
+        block_bitmap[b / 8] |= 1 << (b % 8);
+    }
+    fseek(disk_fp, sb.block_bitmap_block * PROJ_BLOCK_SIZE, SEEK_SET);
+    fwrite(block_bitmap, 1, sb.block_bitmap_blocks * PROJ_BLOCK_SIZE, disk_fp);
+    free(block_bitmap);
+
     fclose(disk_fp);
     printf("Successfully created disk.img!\n");
     return 0;